@@ -0,0 +1,152 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file bench_marcmap.c
+    \brief Microbenchmark of MARC map normalization
+
+    Applies a MARC map (.mmap) to MARCXML records repeatedly and reports
+    records per second. Files hold a record or a collection of records.
+*/
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include <yaz/options.h>
+#include <yaz/log.h>
+#include <yaz/nmem.h>
+#include <yaz/timing.h>
+#include <yaz/xmalloc.h>
+
+#include "marcmap.h"
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: bench_marcmap [options] mmap marcxml..\n"
+            "    -n iterations           Times each record is mapped (1000)\n"
+            "    -v level                Set log level\n");
+    exit(1);
+}
+
+/* adds records of file as separate documents */
+static int add_records(const char *fname, xmlDoc ***docs, int *num)
+{
+    xmlDoc *doc = xmlParseFile(fname);
+    xmlNode *root, *n;
+    int no = 0;
+
+    if (!doc)
+        return -1;
+    root = xmlDocGetRootElement(doc);
+    for (n = root; n; n = (n == root) ? root->children : n->next)
+    {
+        if (n->type != XML_ELEMENT_NODE
+            || strcmp((const char *) n->name, "record"))
+            continue;
+        *docs = xrealloc(*docs, (*num + 1) * sizeof(**docs));
+        (*docs)[*num] = xmlNewDoc(BAD_CAST "1.0");
+        xmlDocSetRootElement((*docs)[*num], xmlDocCopyNode(n, (*docs)[*num], 1));
+        (*num)++;
+        no++;
+        if (n == root)
+            break;
+    }
+    xmlFreeDoc(doc);
+    return no;
+}
+
+int main(int argc, char **argv)
+{
+    int ret, i, j;
+    char *arg;
+    const char *map_fname = 0;
+    int iterations = 1000;
+    int num = 0;
+    xmlDoc **docs = 0;
+    struct marcmap *mm;
+    NMEM nmem = nmem_create();
+    yaz_timing_t timing;
+    double secs;
+
+    while ((ret = options("n:v:", argv, argc, &arg)) != -2)
+    {
+        switch (ret)
+        {
+        case 'n':
+            iterations = atoi(arg);
+            break;
+        case 'v':
+            yaz_log_init_level(yaz_log_mask_str(arg));
+            break;
+        case 0:
+            if (!map_fname)
+                map_fname = arg;
+            else if (add_records(arg, &docs, &num) < 0)
+            {
+                yaz_log(YLOG_FATAL, "cannot parse %s", arg);
+                exit(1);
+            }
+            break;
+        default:
+            usage();
+        }
+    }
+    if (!map_fname || num == 0 || iterations <= 0)
+        usage();
+    if (!(mm = marcmap_load(map_fname, nmem)))
+    {
+        yaz_log(YLOG_FATAL, "cannot load %s", map_fname);
+        exit(1);
+    }
+
+    timing = yaz_timing_create();
+    for (i = 0; i < iterations; i++)
+        for (j = 0; j < num; j++)
+            xmlFreeDoc(marcmap_apply(mm, docs[j]));
+    yaz_timing_stop(timing);
+    secs = yaz_timing_get_real(timing);
+
+    printf("%d records, %d iterations: %.3f s, %.0f records/s\n",
+           num, iterations, secs,
+           secs > 0.0 ? (double) num * iterations / secs : 0.0);
+
+    yaz_timing_destroy(&timing);
+    for (j = 0; j < num; j++)
+        xmlFreeDoc(docs[j]);
+    xfree(docs);
+    nmem_destroy(nmem);
+    return 0;
+}
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -0,0 +1,284 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file charset_cache.c
+    \brief Server-wide LRU cache of normalized strings
+
+    Facet values, mergekeys and sort keys are normalized through the
+    same ICU chains over and over (languages, formats, publishers ..).
+    This cache maps (chain, mode, input) to the normalized and display
+    forms. It is split into shards, each with its own mutex, hash table
+    and LRU list, so that threads rarely contend for the same lock.
+*/
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <assert.h>
+
+#include <yaz/xmalloc.h>
+#include <yaz/mutex.h>
+
+#include "ppmutex.h"
+#include "jenkins_hash.h"
+#include "lru_table.h"
+#include "charset_cache.h"
+
+#define CHARSET_CACHE_SHARDS 16
+/* longer strings are rarely repeated; don't waste the cache on them */
+#define CHARSET_CACHE_MAX_INPUT 256
+
+/* node key is input; node hash is hash / CHARSET_CACHE_SHARDS, as the
+   rest selects the shard */
+struct charset_cache_entry {
+    struct lru_node node;
+    const void *chain;
+    int mode;
+    char *input;
+    char *norm;
+    char *disp;
+};
+
+struct charset_cache_shard {
+    YAZ_MUTEX mutex;
+    lru_table_t lru;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+};
+
+static struct charset_cache_shard *shards = 0;
+static int max_per_shard = 0;
+
+void charset_cache_init(int max_entries)
+{
+    int i;
+
+    if (shards || max_entries <= 0)
+        return;
+    shards = xmalloc(CHARSET_CACHE_SHARDS * sizeof(*shards));
+    memset(shards, 0, CHARSET_CACHE_SHARDS * sizeof(*shards));
+    for (i = 0; i < CHARSET_CACHE_SHARDS; i++)
+    {
+        pazpar2_mutex_create(&shards[i].mutex, "charset_cache");
+        shards[i].lru = lru_table_create();
+    }
+    max_per_shard = (max_entries + CHARSET_CACHE_SHARDS - 1) /
+        CHARSET_CACHE_SHARDS;
+}
+
+void charset_cache_destroy(void)
+{
+    int i;
+
+    if (!shards)
+        return;
+    for (i = 0; i < CHARSET_CACHE_SHARDS; i++)
+    {
+        struct lru_node *n;
+        while ((n = lru_table_head(shards[i].lru)))
+        {
+            lru_table_remove(shards[i].lru, n);
+            xfree(n);
+        }
+        lru_table_destroy(shards[i].lru);
+        yaz_mutex_destroy(&shards[i].mutex);
+    }
+    xfree(shards);
+    shards = 0;
+    max_per_shard = 0;
+}
+
+static unsigned charset_cache_hash(const void *chain, int mode,
+                                   const char *input)
+{
+    unsigned h = jenkins_hash((const unsigned char *) input);
+    h ^= (unsigned) ((size_t) chain >> 4) * 2654435761U;
+    h += (unsigned) mode * 0x9e3779b9U;
+    return h;
+}
+
+static struct charset_cache_entry *shard_find(struct charset_cache_shard *sh,
+                                              unsigned h,
+                                              const void *chain, int mode,
+                                              const char *input)
+{
+    struct lru_node *n = lru_table_bucket(sh->lru, h / CHARSET_CACHE_SHARDS);
+    for (; n; n = n->hnext)
+    {
+        struct charset_cache_entry *e = (struct charset_cache_entry *) n;
+        if (n->hash == h / CHARSET_CACHE_SHARDS && e->chain == chain
+            && e->mode == mode && !strcmp(e->input, input))
+            return e;
+    }
+    return 0;
+}
+
+/** \brief looks up normalized form of input
+    \param chain charset chain (identity only)
+    \param mode caller specific variant (eg sort with/without articles)
+    \param input string to be normalized
+    \param norm_wr normalized result is appended here (if non-NULL)
+    \param disp_wr display result is appended here (if non-NULL)
+    \retval 1 hit
+    \retval 0 miss
+*/
+int charset_cache_lookup(const void *chain, int mode, const char *input,
+                         WRBUF norm_wr, WRBUF disp_wr)
+{
+    struct charset_cache_shard *sh;
+    struct charset_cache_entry *e;
+    unsigned h;
+
+    if (!shards || strlen(input) > CHARSET_CACHE_MAX_INPUT)
+        return 0;
+    h = charset_cache_hash(chain, mode, input);
+    sh = shards + h % CHARSET_CACHE_SHARDS;
+    yaz_mutex_enter(sh->mutex);
+    e = shard_find(sh, h, chain, mode, input);
+    if (e)
+    {
+        sh->hits++;
+        lru_table_touch(sh->lru, &e->node);
+        if (norm_wr)
+            wrbuf_puts(norm_wr, e->norm);
+        if (disp_wr)
+            wrbuf_puts(disp_wr, e->disp);
+    }
+    else
+        sh->misses++;
+    yaz_mutex_leave(sh->mutex);
+    return e ? 1 : 0;
+}
+
+void charset_cache_add(const void *chain, int mode, const char *input,
+                       const char *norm, const char *disp)
+{
+    struct charset_cache_shard *sh;
+    struct charset_cache_entry *e;
+    size_t l_input, l_norm, l_disp;
+    unsigned h;
+
+    if (!shards)
+        return;
+    l_input = strlen(input);
+    if (l_input > CHARSET_CACHE_MAX_INPUT)
+        return;
+    if (!norm)
+        norm = "";
+    if (!disp)
+        disp = "";
+    l_norm = strlen(norm);
+    l_disp = strlen(disp);
+
+    /* key and values are stored in one allocation */
+    e = xmalloc(sizeof(*e) + l_input + l_norm + l_disp + 3);
+    e->chain = chain;
+    e->mode = mode;
+    e->input = (char *) (e + 1);
+    memcpy(e->input, input, l_input + 1);
+    e->norm = e->input + l_input + 1;
+    memcpy(e->norm, norm, l_norm + 1);
+    e->disp = e->norm + l_norm + 1;
+    memcpy(e->disp, disp, l_disp + 1);
+    h = charset_cache_hash(chain, mode, input);
+    e->node.key = e->input;
+    e->node.hash = h / CHARSET_CACHE_SHARDS;
+
+    sh = shards + h % CHARSET_CACHE_SHARDS;
+    yaz_mutex_enter(sh->mutex);
+    if (shard_find(sh, h, chain, mode, input))
+    {   /* another thread got there first */
+        yaz_mutex_leave(sh->mutex);
+        xfree(e);
+        return;
+    }
+    lru_table_insert(sh->lru, &e->node);
+    while (lru_table_num(sh->lru) > max_per_shard)
+    {
+        struct lru_node *victim = lru_table_tail(sh->lru);
+        lru_table_remove(sh->lru, victim);
+        xfree(victim);
+        sh->evictions++;
+    }
+    yaz_mutex_leave(sh->mutex);
+}
+
+/** \brief removes all entries for chain. Must be called before the
+    chain is destroyed, since chains are identified by address */
+void charset_cache_purge(const void *chain)
+{
+    int i;
+
+    if (!shards)
+        return;
+    for (i = 0; i < CHARSET_CACHE_SHARDS; i++)
+    {
+        struct charset_cache_shard *sh = shards + i;
+        struct charset_cache_entry *e;
+
+        yaz_mutex_enter(sh->mutex);
+        e = (struct charset_cache_entry *) lru_table_head(sh->lru);
+        while (e)
+        {
+            struct charset_cache_entry *e_next =
+                (struct charset_cache_entry *) e->node.next;
+            if (e->chain == chain)
+            {
+                lru_table_remove(sh->lru, &e->node);
+                xfree(e);
+            }
+            e = e_next;
+        }
+        yaz_mutex_leave(sh->mutex);
+    }
+}
+
+void charset_cache_get_stat(struct charset_cache_stat *stat)
+{
+    int i;
+
+    memset(stat, 0, sizeof(*stat));
+    if (!shards)
+        return;
+    stat->max_entries = max_per_shard * CHARSET_CACHE_SHARDS;
+    for (i = 0; i < CHARSET_CACHE_SHARDS; i++)
+    {
+        struct charset_cache_shard *sh = shards + i;
+        yaz_mutex_enter(sh->mutex);
+        stat->entries += lru_table_num(sh->lru);
+        stat->hits += sh->hits;
+        stat->misses += sh->misses;
+        stat->evictions += sh->evictions;
+        yaz_mutex_leave(sh->mutex);
+    }
+}
+
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -0,0 +1,58 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file charset_cache.h
+    \brief Server-wide LRU cache of normalized strings
+*/
+
+#ifndef CHARSET_CACHE_H
+#define CHARSET_CACHE_H
+
+#include <yaz/wrbuf.h>
+
+struct charset_cache_stat {
+    int max_entries;
+    int entries;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+};
+
+void charset_cache_init(int max_entries);
+void charset_cache_destroy(void);
+
+int charset_cache_lookup(const void *chain, int mode, const char *input,
+                         WRBUF norm_wr, WRBUF disp_wr);
+void charset_cache_add(const void *chain, int mode, const char *input,
+                       const char *norm, const char *disp);
+void charset_cache_purge(const void *chain);
+void charset_cache_get_stat(struct charset_cache_stat *stat);
+
+#endif
+
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
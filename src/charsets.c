@@ -34,6 +34,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <string.h>
 
 #include "charsets.h"
+#include "charset_cache.h"
 #include "normalize7bit.h"
 
 typedef struct pp2_charset_s *pp2_charset_t;
@@ -257,22 +258,126 @@ pp2_charset_t pp2_charset_create_icu(struct icu_chain *icu_chn)
 
 void pp2_charset_destroy(pp2_charset_t pct)
 {
+    charset_cache_purge(pct);
 #if YAZ_HAVE_ICU
     icu_chain_destroy(pct->icu_chn);
 #endif
     xfree(pct);
 }
 
-pp2_charset_token_t pp2_charset_token_create(pp2_charset_fact_t pft,
-                                               const char *id)
+static pp2_charset_t pp2_charset_fact_lookup(pp2_charset_fact_t pft,
+                                             const char *id)
 {
     struct pp2_charset_entry *pce;
     for (pce = pft->list; pce; pce = pce->next)
         if (!strcmp(id, pce->name))
-            return pp2_charset_tokenize(pce->pct);
+            return pce->pct;
+    return 0;
+}
+
+pp2_charset_token_t pp2_charset_token_create(pp2_charset_fact_t pft,
+                                               const char *id)
+{
+    pp2_charset_t pct = pp2_charset_fact_lookup(pft, id);
+    if (pct)
+        return pp2_charset_tokenize(pct);
+    return 0;
+}
+
+/** \brief normalizes whole string through chain
+    \param pft charset factory
+    \param id chain ID
+    \param buf input
+    \param norm_wr non-empty normalized tokens separated by blank
+    \param display_wr display tokens separated by blank (may be NULL)
+    \retval 0 OK
+    \retval -1 no chain by that ID
+
+    Results are memoized in the server-wide charset cache.
+*/
+int pp2_charset_fact_normalize(pp2_charset_fact_t pft, const char *id,
+                               const char *buf,
+                               WRBUF norm_wr, WRBUF display_wr)
+{
+    pp2_charset_t pct = pp2_charset_fact_lookup(pft, id);
+    pp2_charset_token_t prt;
+    const char *norm_component;
+    WRBUF disp_wr;
+
+    if (!pct)
+        return -1;
+    wrbuf_rewind(norm_wr);
+    if (display_wr)
+        wrbuf_rewind(display_wr);
+    if (charset_cache_lookup(pct, 0, buf, norm_wr, display_wr))
+        return 0;
+
+    disp_wr = display_wr ? display_wr : wrbuf_alloc();
+    prt = pp2_charset_tokenize(pct);
+    pp2_charset_token_first(prt, buf, 0);
+    while ((norm_component = pp2_charset_token_next(prt)))
+    {
+        const char *display_component;
+        if (*norm_component)
+        {
+            if (wrbuf_len(norm_wr))
+                wrbuf_puts(norm_wr, " ");
+            wrbuf_puts(norm_wr, norm_component);
+        }
+        display_component = pp2_get_display(prt);
+        if (display_component)
+        {
+            if (wrbuf_len(disp_wr))
+                wrbuf_puts(disp_wr, " ");
+            wrbuf_puts(disp_wr, display_component);
+        }
+    }
+    pp2_charset_token_destroy(prt);
+    charset_cache_add(pct, 0, buf, wrbuf_cstr(norm_wr), wrbuf_cstr(disp_wr));
+    if (disp_wr != display_wr)
+        wrbuf_destroy(disp_wr);
     return 0;
 }
 
+/** \brief makes sort key from first token of string
+    \param pft charset factory
+    \param id chain ID
+    \param buf input
+    \param skip_article whether to skip leading article
+    \param sort_wr sort key
+    \retval 0 OK
+    \retval 1 no sort key could be made
+    \retval -1 no chain by that ID
+*/
+int pp2_charset_fact_sortkey(pp2_charset_fact_t pft, const char *id,
+                             const char *buf, int skip_article,
+                             WRBUF sort_wr)
+{
+    pp2_charset_t pct = pp2_charset_fact_lookup(pft, id);
+    pp2_charset_token_t prt;
+    const char *sort_str;
+    int mode = skip_article ? 2 : 1;
+    int r = 1;
+
+    if (!pct)
+        return -1;
+    wrbuf_rewind(sort_wr);
+    if (charset_cache_lookup(pct, mode, buf, sort_wr, 0))
+        return 0;
+    prt = pp2_charset_tokenize(pct);
+    pp2_charset_token_first(prt, buf, skip_article);
+    pp2_charset_token_next(prt);
+    sort_str = pp2_get_sort(prt);
+    if (sort_str)
+    {
+        wrbuf_puts(sort_wr, sort_str);
+        charset_cache_add(pct, mode, buf, sort_str, 0);
+        r = 0;
+    }
+    pp2_charset_token_destroy(prt);
+    return r;
+}
+
 pp2_charset_token_t pp2_charset_tokenize(pp2_charset_t pct)
 {
     pp2_charset_token_t prt = xmalloc(sizeof(*prt));
@@ -46,6 +46,13 @@ const char *pp2_charset_token_next(pp2_charset_token_t prt);
 const char *pp2_get_sort(pp2_charset_token_t prt);
 const char *pp2_get_display(pp2_charset_token_t prt);
 
+int pp2_charset_fact_normalize(pp2_charset_fact_t pft, const char *id,
+                               const char *buf,
+                               WRBUF norm_wr, WRBUF display_wr);
+int pp2_charset_fact_sortkey(pp2_charset_fact_t pft, const char *id,
+                             const char *buf, int skip_article,
+                             WRBUF sort_wr);
+
 #endif
 
 /*
@@ -58,6 +58,9 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <yaz/gettimeofday.h>
 
 #define USE_TIMING 0
+
+/* max number of records merged into session under one lock */
+#define CLIENT_INGEST_BATCH 100
 #if USE_TIMING
 #include <yaz/timing.h>
 #endif
@@ -70,6 +73,11 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "settings.h"
 #include "relevance.h"
 #include "incref.h"
+#include "jenkins_hash.h"
+#include "normalize_record.h"
+#include "search_cache.h"
+#include "raw_cache.h"
+#include "query_cache.h"
 
 static YAZ_MUTEX g_mutex = 0;
 static int no_clients = 0;
@@ -115,6 +123,7 @@ struct client {
     char *addinfo; // diagnostic info for most resent error
     Odr_int hits;
     int record_offset;
+    int records_ahead; // records ingested before their RECV_RECORD event
     int filtered; // When using local:, this will count the number of filtered records.
     int maxrecs;
     int startrecs;
@@ -132,6 +141,9 @@ struct client {
     int same_search;
     char *sort_strategy;
     char *sort_criteria;
+    search_cache_entry_t cache_hit; // search cache entry result comes from
+    search_cache_entry_t cache_new; // entry filled while target is searched
+    struct ingest_cache *ingest_cache; // prepared records of result set
 };
 
 struct suggestions {
@@ -149,6 +161,7 @@ struct show_raw {
     char *syntax;
     char *esn;
     char *nativesyntax;
+    char *cache_key; // key in raw record cache; 0 if cache is disabled
     void (*error_handler)(void *data, const char *addinfo);
     void (*record_handler)(void *data, const char *buf, size_t sz);
     void *data;
@@ -176,7 +189,12 @@ enum client_state client_get_state(struct client *cl)
 
 void client_set_state_nb(struct client *cl, enum client_state st)
 {
+    int changed = cl->state != st;
     cl->state = st;
+    /* counter is bumped after the change so a snapshot made in between
+       can not claim to include it */
+    if (changed && cl->session)
+        session_changed(cl->session, SESSION_GEN_CLIENTS);
 }
 
 void client_set_state(struct client *cl, enum client_state st)
@@ -184,7 +202,12 @@ void client_set_state(struct client *cl, enum client_state st)
     int was_active = 0;
     if (client_is_active(cl))
         was_active = 1;
-    cl->state = st;
+    if (cl->state != st)
+    {
+        cl->state = st;
+        if (cl->session)
+            session_changed(cl->session, SESSION_GEN_CLIENTS);
+    }
     /* If client is going from being active to inactive and all clients
        are now idle we fire a watch for the session . The assumption is
        that session is not mutex locked if client is already active */
@@ -194,6 +217,7 @@ void client_set_state(struct client *cl, enum client_state st)
         int no_active = session_active_clients(cl->session);
         yaz_log(YLOG_DEBUG, "%s: releasing watches on zero active: %d",
                 client_get_id(cl), no_active);
+        session_publish(cl->session);
         if (no_active == 0) {
             session_alert_watch(cl->session, SESSION_WATCH_SHOW);
             session_alert_watch(cl->session, SESSION_WATCH_BYTARGET);
@@ -262,6 +286,21 @@ static void client_show_immediate(
     record_handler(data, buf, len);
 }
 
+static unsigned client_settings_hash(struct client *cl);
+
+/* key of raw record in raw record cache */
+static void client_raw_cache_key(struct client *cl, int position,
+                                 const char *syntax, const char *esn,
+                                 const char *nativesyntax, WRBUF w)
+{
+    wrbuf_printf(w, "%s\n%s\n%s\n%s\n%x\n%d\n%s\n%s\n%s",
+                 client_get_id(cl),
+                 cl->cqlquery ? cl->cqlquery : cl->pquery,
+                 cl->sort_strategy ? cl->sort_strategy : "",
+                 cl->sort_criteria ? cl->sort_criteria : "",
+                 client_settings_hash(cl), position,
+                 syntax ? syntax : "", esn ? esn : "", nativesyntax);
+}
 
 int client_show_raw_begin(struct client *cl, int position,
                           const char *syntax, const char *esn,
@@ -291,10 +330,29 @@ int client_show_raw_begin(struct client *cl, int position,
     else
     {
         struct show_raw *rr, **rrp;
+        WRBUF cache_key = 0;
 
-        if (!cl->connection)
-            return -1;
+        if (raw_cache_enabled() && (cl->pquery || cl->cqlquery))
+        {
+            WRBUF w = wrbuf_alloc();
 
+            cache_key = wrbuf_alloc();
+            client_raw_cache_key(cl, position, syntax, esn, nativesyntax,
+                                 cache_key);
+            if (raw_cache_lookup(wrbuf_cstr(cache_key), w))
+            {
+                record_handler(data, wrbuf_buf(w), wrbuf_len(w));
+                wrbuf_destroy(w);
+                wrbuf_destroy(cache_key);
+                return 0;
+            }
+            wrbuf_destroy(w);
+        }
+        if (!cl->connection || !cl->resultset)
+        {
+            wrbuf_destroy(cache_key);
+            return -1;
+        }
 
         rr = xmalloc(sizeof(*rr));
         rr->position = position;
@@ -314,6 +372,8 @@ int client_show_raw_begin(struct client *cl, int position,
 
         assert(nativesyntax);
         rr->nativesyntax = xstrdup(nativesyntax);
+        rr->cache_key = cache_key ? xstrdup(wrbuf_cstr(cache_key)) : 0;
+        wrbuf_destroy(cache_key);
 
         rr->next = 0;
 
@@ -342,6 +402,7 @@ static void client_show_raw_delete(struct show_raw *r)
     xfree(r->syntax);
     xfree(r->esn);
     xfree(r->nativesyntax);
+    xfree(r->cache_key);
     xfree(r);
 }
 
@@ -488,7 +549,12 @@ void client_report_facets(struct client *cl, ZOOM_resultset rs)
                                 ZOOM_facet_field_get_term(facets[facet_idx],
                                                           term_idx, &freq);
                             if (term)
+                            {
                                 add_facet(se, p, term, freq);
+                                if (cl->cache_new)
+                                    search_cache_entry_add_facet(
+                                        cl->cache_new, p, term, freq);
+                            }
                         }
                         break;
                     }
@@ -506,6 +572,8 @@ static void ingest_raw_record(struct client *cl, ZOOM_record rec)
 
     nativesyntax_to_type(cl->show_raw->nativesyntax, type, rec);
     buf = ZOOM_record_get(rec, type, &len);
+    if (buf && cl->show_raw->cache_key)
+        raw_cache_add(cl->show_raw->cache_key, buf, len);
     cl->show_raw->record_handler(cl->show_raw->data,  buf, len);
     client_show_raw_dequeue(cl);
 }
@@ -545,19 +613,108 @@ void client_search_response(struct client *cl)
     if (ZOOM_connection_error(link, &error, &addinfo))
     {
         cl->hits = 0;
+        search_cache_entry_destroy(cl->cache_new);
+        cl->cache_new = 0;
         client_set_state(cl, Client_Error);
         yaz_log(YLOG_WARN, "Search error %s (%s): %s",
                 error, addinfo, client_get_id(cl));
     }
     else
     {
+        const char *suggestions =
+            ZOOM_resultset_option_get(resultset, "suggestions");
         client_report_facets(cl, resultset);
         cl->record_offset = cl->startrecs;
+        cl->records_ahead = 0;
         cl->hits = ZOOM_resultset_size(resultset);
         yaz_log(YLOG_DEBUG, "client_search_response: hits " ODR_INT_PRINTF, cl->hits);
         if (cl->suggestions)
             client_suggestions_destroy(cl);
-        cl->suggestions = client_suggestions_create(ZOOM_resultset_option_get(resultset, "suggestions"));
+        cl->suggestions = client_suggestions_create(suggestions);
+        if (cl->cache_new)
+        {
+            search_cache_entry_set_hits(cl->cache_new, cl->hits);
+            search_cache_entry_set_suggestions(cl->cache_new, suggestions);
+        }
+        if (cl->session)
+            session_changed(cl->session, SESSION_GEN_CLIENTS);
+    }
+}
+
+/** \brief adds result of search to search cache
+    \param cl client whose search has completed without error
+
+    The result is only cached if all records that were asked for
+    were received.
+*/
+void client_search_cache_store(struct client *cl)
+{
+    search_cache_entry_t e = cl->cache_new;
+
+    if (e)
+    {
+        Odr_int expected = cl->hits - cl->startrecs;
+        if (expected > cl->maxrecs)
+            expected = cl->maxrecs;
+        if (expected < 0)
+            expected = 0;
+        if (search_cache_entry_num_records(e) == expected)
+            search_cache_add(e);
+        search_cache_entry_destroy(e);
+        cl->cache_new = 0;
+    }
+}
+
+/* whether normalized records are collected for the search cache */
+int client_search_cache_filling(struct client *cl)
+{
+    return cl->cache_new != 0;
+}
+
+/* stores normalized record for the search cache */
+void client_search_cache_record(struct client *cl, int position,
+                                const char *rec)
+{
+    if (cl->cache_new)
+        search_cache_entry_add_record(cl->cache_new, position, rec);
+}
+
+/* merges records into session; counts those failed and filtered.
+   zrecs and types are the ZOOM records and their types fetched, or NULL
+   for records not from a result set */
+static void client_ingest_records(struct client *cl, int num,
+                                  const char **recs, const int *record_nos,
+                                  ZOOM_record *zrecs, const char **types,
+                                  int normalized, NMEM nmem)
+{
+    struct session *se = client_get_session(cl);
+    int *rcs = nmem_malloc(nmem, sizeof(*rcs) * num);
+    int i;
+
+    ingest_record_batch(cl, num, recs, record_nos, normalized, rcs, nmem,
+                        cl->ingest_cache);
+    for (i = 0; i < num; i++)
+    {
+        /* OK = 0, -1 = failure, -2 = Filtered, -3 = ingested only */
+        if (rcs[i] == -1)
+        {
+            session_log(se, YLOG_WARN,
+                        "Failed to ingest record from %s #%d",
+                        client_get_id(cl), record_nos[i]);
+            if (zrecs)
+            {
+                const char *s = session_setting_oneval(
+                    client_get_database(cl), PZ_NATIVESYNTAX);
+                const char *rec_syn =
+                    ZOOM_record_get(zrecs[i], "syntax", NULL);
+                session_log(se, YLOG_LOG, "pz:nativesyntax=%s . "
+                            "ZOOM record type=%s . Actual record syntax=%s",
+                            s ? s : "null", types[i],
+                            rec_syn ? rec_syn : "null");
+            }
+        }
+        if (rcs[i] == -2)
+            cl->filtered += 1;
     }
 }
 
@@ -569,6 +726,7 @@ void client_got_records(struct client *cl)
         if (reclist_get_num_records(se->reclist) > 0)
         {
             client_unlock(cl);
+            session_publish(se);
             session_alert_watch(se, SESSION_WATCH_SHOW);
             session_alert_watch(se, SESSION_WATCH_BYTARGET);
             session_alert_watch(se, SESSION_WATCH_TERMLIST);
@@ -578,16 +736,45 @@ void client_got_records(struct client *cl)
     }
 }
 
-static void client_record_ingest(struct client *cl)
+/* hits and facets of search response are published for readers */
+void client_got_search(struct client *cl)
+{
+    struct session *se = cl->session;
+    if (se)
+    {
+        client_unlock(cl);
+        session_publish(se);
+        client_lock(cl);
+    }
+}
+
+/** \brief ingests records that are immediately available
+    \param cl client
+    \param max maximum number of records to ingest
+    \returns number of records consumed from result set
+
+    Records are prepared one by one and merged into the session in one
+    go, so the session is locked once per batch rather than per record.
+*/
+static int client_record_ingest(struct client *cl, int max)
 {
     const char *msg, *addinfo;
     ZOOM_record rec = 0;
     ZOOM_resultset resultset = cl->resultset;
     struct session *se = client_get_session(cl);
-
-    if ((rec = ZOOM_resultset_record_immediate(resultset, cl->record_offset)))
+    struct session_database *sdb = client_get_database(cl);
+    NMEM nmem = nmem_create();
+    const char **recs = nmem_malloc(nmem, sizeof(*recs) * max);
+    int *record_nos = nmem_malloc(nmem, sizeof(*record_nos) * max);
+    ZOOM_record *zrecs = nmem_malloc(nmem, sizeof(*zrecs) * max);
+    const char **types = nmem_malloc(nmem, sizeof(*types) * max);
+    int num = 0, consumed = 0;
+
+    while (consumed < max &&
+           (rec = ZOOM_resultset_record_immediate(resultset, cl->record_offset)))
     {
         int offset = ++cl->record_offset;
+        consumed++;
         if (cl->session == 0) {
             /* no operation */
         }
@@ -598,15 +785,26 @@ static void client_record_ingest(struct client *cl)
         }
         else
         {
-            struct session_database *sdb = client_get_database(cl);
-            NMEM nmem = nmem_create();
             const char *xmlrec;
             char type[80];
 
             const char *s = session_setting_oneval(sdb, PZ_NATIVESYNTAX);
-            if (nativesyntax_to_type(s, type, rec))
-                session_log(se, YLOG_WARN, "Failed to determine record type");
-            xmlrec = ZOOM_record_get(rec, type, NULL);
+            if (normalize_record_native(sdb->map, s)
+                && !strncmp(s, "iso2709", 7))
+            {
+                /* decoded by the MARC map of normalization */
+                int len;
+                const char *buf = ZOOM_record_get(rec, "raw", &len);
+                strcpy(type, "raw");
+                xmlrec = buf ? nmem_strdupn(nmem, buf, len) : 0;
+            }
+            else
+            {
+                if (nativesyntax_to_type(s, type, rec))
+                    session_log(se, YLOG_WARN,
+                                "Failed to determine record type");
+                xmlrec = ZOOM_record_get(rec, type, NULL);
+            }
             if (!xmlrec)
             {
                 const char *rec_syn =  ZOOM_record_get(rec, "syntax", NULL);
@@ -619,30 +817,149 @@ static void client_record_ingest(struct client *cl)
             }
             else
             {
-                /* OK = 0, -1 = failure, -2 = Filtered, -3 = ingested only */
-                int rc = ingest_record(cl, xmlrec, cl->record_offset, nmem);
-                if (rc == -1)
-                {
-                    const char *rec_syn =  ZOOM_record_get(rec, "syntax", NULL);
-                    session_log(se, YLOG_WARN,
-                                "Failed to ingest record from %s #%d",
-                                client_get_id(cl), offset);
-                    session_log(se, YLOG_LOG, "pz:nativesyntax=%s . "
-                                "ZOOM record type=%s . Actual record syntax=%s",
-                                s ? s : "null", type,
-                                rec_syn ? rec_syn : "null");
-                }
-                if (rc == -2)
-                    cl->filtered += 1;
+                recs[num] = xmlrec;
+                record_nos[num] = cl->record_offset;
+                zrecs[num] = rec;
+                types[num] = nmem_strdup(nmem, type);
+                num++;
             }
-            nmem_destroy(nmem);
         }
     }
-    else
+    if (consumed == 0)
     {
         session_log(se, YLOG_WARN, "Got NULL record from %s #%d",
                     client_get_id(cl), cl->record_offset);
     }
+    if (num > 0)
+        client_ingest_records(cl, num, recs, record_nos, zrecs, types, 0,
+                              nmem);
+    nmem_destroy(nmem);
+    return consumed;
+}
+
+/* hash of all settings of the database of client */
+static unsigned client_settings_hash(struct client *cl)
+{
+    struct session_database *sdb = client_get_database(cl);
+    WRBUF sw = wrbuf_alloc();
+    unsigned h;
+    int i;
+
+    for (i = 0; i < sdb->num_settings; i++)
+    {
+        struct setting *s;
+        for (s = sdb->settings[i]; s; s = s->next)
+            wrbuf_printf(sw, "%s=%s\n", s->name, s->value ? s->value : "");
+    }
+    h = jenkins_hash((const unsigned char *) wrbuf_cstr(sw));
+    wrbuf_destroy(sw);
+    return h;
+}
+
+/* ingests records of search cache entry, in batches */
+static void client_reingest_cached(struct client *cl)
+{
+    search_cache_entry_t e = cl->cache_hit;
+    int n = search_cache_entry_num_records(e);
+    int i = 0;
+
+    cl->filtered = 0;
+    cl->records_ahead = 0;
+    while (i < n)
+    {
+        NMEM nmem = nmem_create();
+        const char **recs =
+            nmem_malloc(nmem, sizeof(*recs) * CLIENT_INGEST_BATCH);
+        int *record_nos =
+            nmem_malloc(nmem, sizeof(*record_nos) * CLIENT_INGEST_BATCH);
+        int num = 0;
+
+        for (; num < CLIENT_INGEST_BATCH && i < n; i++)
+        {
+            recs[num] = search_cache_entry_record(e, i, record_nos + num);
+            if (recs[num])
+                num++;
+        }
+        if (num > 0)
+            client_ingest_records(cl, num, recs, record_nos, 0, 0, 1, nmem);
+        nmem_destroy(nmem);
+    }
+    cl->record_offset = cl->startrecs + n;
+}
+
+/* takes result of search from search cache entry cl->cache_hit */
+static void client_start_cached(struct client *cl)
+{
+    search_cache_entry_t e = cl->cache_hit;
+    struct session *se = client_get_session(cl);
+    int i;
+
+    if (cl->resultset)
+    {
+        ZOOM_resultset_destroy(cl->resultset);
+        cl->resultset = 0;
+    }
+    cl->diagnostic = 0;
+    cl->hits = search_cache_entry_hits(e);
+    if (cl->suggestions)
+        client_suggestions_destroy(cl);
+    cl->suggestions =
+        client_suggestions_create(search_cache_entry_suggestions(e));
+    ingest_cache_reset(cl->ingest_cache, client_settings_hash(cl));
+    for (i = 0; i < search_cache_entry_num_facets(e); i++)
+    {
+        const char *term;
+        int freq;
+        const char *name = search_cache_entry_facet(e, i, &term, &freq);
+        add_facet(se, name, term, freq);
+    }
+    client_reingest_cached(cl);
+    /* hits and suggestions changed even if state stays Idle */
+    session_changed(se, SESSION_GEN_CLIENTS);
+    client_set_state(cl, Client_Idle);
+    session_publish(se);
+    session_alert_watch(se, SESSION_WATCH_SHOW);
+    session_alert_watch(se, SESSION_WATCH_BYTARGET);
+    session_alert_watch(se, SESSION_WATCH_TERMLIST);
+    session_alert_watch(se, SESSION_WATCH_RECORD);
+}
+
+/* hash of the metadata definitions records are normalized against */
+static unsigned client_metadata_hash(struct conf_service *service)
+{
+    WRBUF mw = wrbuf_alloc();
+    unsigned h;
+    int i;
+
+    for (i = 0; i < service->num_metadata; i++)
+    {
+        struct conf_metadata *md = service->metadata + i;
+        wrbuf_printf(mw, "%s %d %d %s %d %d %d %d %d %s %s %s\n",
+                     md->name, md->brief, md->termlist,
+                     md->rank ? md->rank : "", md->sortkey_offset,
+                     md->type, md->merge, md->setting, md->mergekey,
+                     md->facetrule ? md->facetrule : "",
+                     md->limitmap ? md->limitmap : "",
+                     md->limitcluster ? md->limitcluster : "");
+    }
+    h = jenkins_hash((const unsigned char *) wrbuf_cstr(mw));
+    wrbuf_destroy(mw);
+    return h;
+}
+
+/* key of search in search cache. Settings and the normalization
+   pipeline are represented by hashes, since cached records are stored
+   normalized */
+static void client_search_cache_key(struct client *cl, WRBUF w)
+{
+    struct session_database *sdb = client_get_database(cl);
+    wrbuf_printf(w, "%s\n%s\n%s\n%s\n%d %d %x %x %x", client_get_id(cl),
+                 cl->cqlquery ? cl->cqlquery : cl->pquery,
+                 cl->sort_strategy ? cl->sort_strategy : "",
+                 cl->sort_criteria ? cl->sort_criteria : "",
+                 cl->startrecs, cl->maxrecs, client_settings_hash(cl),
+                 normalize_record_fingerprint(sdb->map),
+                 client_metadata_hash(cl->session->service));
 }
 
 void client_record_response(struct client *cl)
@@ -675,9 +992,20 @@ void client_record_response(struct client *cl)
                         cl->show_raw->position-1);
             }
         }
+        else if (cl->records_ahead > 0 &&
+                 !ZOOM_resultset_record_immediate(resultset,
+                                                  cl->record_offset))
+        {
+            /* event for a record already ingested with an earlier one */
+            cl->records_ahead--;
+        }
         else
         {
-            client_record_ingest(cl);
+            /* ZOOM signals each record of a present response with its
+               own event, but all of them are available already */
+            int n = client_record_ingest(cl, CLIENT_INGEST_BATCH);
+            if (n > 1)
+                cl->records_ahead += n - 1;
         }
     }
 }
@@ -686,11 +1014,32 @@ int client_reingest(struct client *cl)
 {
     int i = cl->startrecs;
     int to = cl->record_offset;
+    unsigned settings_hash = client_settings_hash(cl);
+
+    if (ingest_cache_match(cl->ingest_cache, settings_hash))
+    {
+        /* records are prepared already; only facet limits may differ */
+        cl->filtered = ingest_cache_reingest(cl, cl->ingest_cache);
+        cl->records_ahead = 0;
+        return 0;
+    }
+    ingest_cache_reset(cl->ingest_cache, settings_hash);
+    if (cl->cache_hit)
+    {
+        client_reingest_cached(cl);
+        return 0;
+    }
     cl->filtered = 0;
+    cl->records_ahead = 0;
 
     cl->record_offset = i;
-    for (; i < to; i++)
-        client_record_ingest(cl);
+    while (i < to)
+    {
+        int n = client_record_ingest(cl, to - i);
+        if (n == 0)
+            break;
+        i += n;
+    }
     return 0;
 }
 
@@ -810,7 +1159,35 @@ int client_start_search(struct client *cl)
     struct timeval tval;
     int present_chunk = 20; // Default chunk size
     int rc_prep_connection;
+    WRBUF cache_key = 0;
+
+    if (opt_maxrecs && *opt_maxrecs)
+    {
+        cl->maxrecs = atoi(opt_maxrecs);
+    }
 
+    if (cl->same_search == 1 && cl->cache_hit)
+    {
+        session_log(se, YLOG_LOG, "client %s REUSE cached result",
+                    client_get_id(cl));
+        return client_reingest(cl);
+    }
+    search_cache_entry_destroy(cl->cache_hit);
+    cl->cache_hit = 0;
+    if (!client_is_active(cl))
+    {
+        /* result from another session. No connection needed */
+        cache_key = wrbuf_alloc();
+        client_search_cache_key(cl, cache_key);
+        if ((cl->cache_hit = search_cache_lookup(wrbuf_cstr(cache_key))))
+        {
+            wrbuf_destroy(cache_key);
+            session_log(se, YLOG_LOG, "client %s CACHED result",
+                        client_get_id(cl));
+            client_start_cached(cl);
+            return 0;
+        }
+    }
 
     yaz_gettimeofday(&tval);
     tval.tv_sec += 5;
@@ -825,13 +1202,15 @@ int client_start_search(struct client *cl)
                                se->service->server->iochan_man,
                                &tval);
     /* Nothing has changed and we already have a result */
-    if (cl->same_search == 1 && rc_prep_connection == 2)
+    if (cl->same_search == 1 && rc_prep_connection == 2 && cl->resultset)
     {
+        wrbuf_destroy(cache_key);
         session_log(se, YLOG_LOG, "client %s REUSE result", client_get_id(cl));
         return client_reingest(cl);
     }
     else if (!rc_prep_connection)
     {
+        wrbuf_destroy(cache_key);
         session_log(se, YLOG_LOG, "client %s FAILED to search: No connection.", client_get_id(cl));
         return -1;
     }
@@ -842,6 +1221,16 @@ int client_start_search(struct client *cl)
 
     session_log(se, YLOG_LOG, "client %s NEW search", client_get_id(cl));
 
+    search_cache_entry_destroy(cl->cache_new);
+    cl->cache_new = 0;
+    ingest_cache_reset(cl->ingest_cache, client_settings_hash(cl));
+    if (cache_key)
+    {
+        cl->cache_new = search_cache_entry_create(wrbuf_cstr(cache_key),
+                                                  cl->startrecs, cl->maxrecs);
+        wrbuf_destroy(cache_key);
+    }
+
     cl->diagnostic = 0;
     cl->filtered = 0;
 
@@ -868,11 +1257,6 @@ int client_start_search(struct client *cl)
     if (*opt_requestsyn)
         ZOOM_connection_option_set(link, "preferredRecordSyntax", opt_requestsyn);
 
-    if (opt_maxrecs && *opt_maxrecs)
-    {
-        cl->maxrecs = atoi(opt_maxrecs);
-    }
-
     /* convert back to string representation used in ZOOM API */
     sprintf(maxrecs_str, "%d", cl->maxrecs);
     ZOOM_connection_option_set(link, "count", maxrecs_str);
@@ -918,6 +1302,7 @@ int client_start_search(struct client *cl)
     client_set_state(cl, Client_Working);
     cl->hits = 0;
     cl->record_offset = 0;
+    cl->records_ahead = 0;
     rs = ZOOM_connection_search(link, query);
     ZOOM_query_destroy(query);
     ZOOM_resultset_destroy(cl->resultset);
@@ -940,6 +1325,7 @@ struct client *client_create(const char *id)
     cl->session = 0;
     cl->hits = 0;
     cl->record_offset = 0;
+    cl->records_ahead = 0;
     cl->filtered = 0;
     cl->diagnostic = 0;
     cl->state = Client_Disconnected;
@@ -953,6 +1339,9 @@ struct client *client_create(const char *id)
     cl->facet_limits = 0;
     cl->sort_strategy = 0;
     cl->sort_criteria = 0;
+    cl->cache_hit = 0;
+    cl->cache_new = 0;
+    cl->ingest_cache = ingest_cache_create();
     assert(id);
     cl->id = xstrdup(id);
     client_use(1);
@@ -996,6 +1385,9 @@ int client_destroy(struct client *c)
             xfree(c->id);
             xfree(c->sort_strategy);
             xfree(c->sort_criteria);
+            search_cache_entry_destroy(c->cache_hit);
+            search_cache_entry_destroy(c->cache_new);
+            ingest_cache_destroy(c->ingest_cache);
             assert(!c->connection);
             facet_limits_destroy(c->facet_limits);
 
@@ -1037,15 +1429,30 @@ void client_disconnect(struct client *cl)
 }
 
 
-// Initialize CCL map for a target
-static CCL_bibset prepare_cclmap(struct client *cl, CCL_bibset base_bibset)
+// Initialize CCL map for a target. Shared by targets with same map.
+// Keyed on the directives of the base bibset, since services may come
+// and go and the bibset address does not identify its content
+static query_cache_map_t prepare_cclmap(struct client *cl,
+                                        CCL_bibset base_bibset,
+                                        const char *base_directives)
 {
     struct session_database *sdb = client_get_database(cl);
     struct setting *s;
     CCL_bibset res;
+    query_cache_map_t map;
+    WRBUF key;
 
     if (!sdb->settings)
         return 0;
+    key = wrbuf_alloc();
+    wrbuf_printf(key, "%s\n", base_directives ? base_directives : "");
+    for (s = sdb->settings[PZ_CCLMAP]; s; s = s->next)
+        wrbuf_printf(key, "%s=%s\n", s->name, s->value ? s->value : "");
+    if ((map = query_cache_map_lookup(wrbuf_cstr(key))))
+    {
+        wrbuf_destroy(key);
+        return map;
+    }
     if (base_bibset)
         res = ccl_qual_dup(base_bibset);
     else
@@ -1065,6 +1472,7 @@ static CCL_bibset prepare_cclmap(struct client *cl, CCL_bibset base_bibset)
             client_set_state_nb(cl, Client_Error);
             ccl_qual_rm(&res);
             wrbuf_destroy(w);
+            wrbuf_destroy(key);
             return 0;
         }
         p++;
@@ -1081,10 +1489,46 @@ static CCL_bibset prepare_cclmap(struct client *cl, CCL_bibset base_bibset)
             client_set_state_nb(cl, Client_Error);
             ccl_qual_rm(&res);
             wrbuf_destroy(w);
+            wrbuf_destroy(key);
             return 0;
         }
     }
-    return res;
+    map = query_cache_map_add(wrbuf_cstr(key), res);
+    wrbuf_destroy(key);
+    return map;
+}
+
+// PQF of CCL query. Cached by map and query. Returns 0 if OK; -1 on error
+static int ccl_to_pqf(query_cache_map_t map, const char *query, WRBUF w)
+{
+    unsigned id = query_cache_map_id(map);
+    struct ccl_rpn_node *cn;
+    int cerror, cpos;
+    WRBUF key = 0;
+
+    if (id)
+    {
+        int r;
+        key = wrbuf_alloc();
+        wrbuf_printf(key, "ccl\n%u\n%s", id, query);
+        if ((r = query_cache_lookup(wrbuf_cstr(key), w)))
+        {
+            wrbuf_destroy(key);
+            return r == 1 ? 0 : -1;
+        }
+    }
+    cn = ccl_find_str(query_cache_map_bibset(map), query, &cerror, &cpos);
+    if (cn)
+    {
+        ccl_pquery(w, cn);
+        ccl_rpn_delete(cn);
+    }
+    if (key)
+    {
+        query_cache_add(wrbuf_cstr(key), cn ? wrbuf_cstr(w) : 0);
+        wrbuf_destroy(key);
+    }
+    return cn ? 0 : -1;
 }
 
 // returns a xmalloced CQL query corresponding to the pquery in client
@@ -1130,6 +1574,31 @@ static char *make_solrquery(struct client *cl, Z_RPNQuery *zquery)
     return r;
 }
 
+// returns a xmalloced CQL or SOLR query. Cached by PQF of client
+static char *make_native_query(struct client *cl, const char *sru,
+                               Z_RPNQuery *zquery)
+{
+    int solr = !strcmp(sru, "solr");
+    WRBUF key = wrbuf_alloc();
+    WRBUF w = wrbuf_alloc();
+    char *r = 0;
+
+    wrbuf_printf(key, "%s\n%s", solr ? "solr" : "cql", cl->pquery);
+    switch (query_cache_lookup(wrbuf_cstr(key), w))
+    {
+    case 1:
+        r = xstrdup(wrbuf_cstr(w));
+        break;
+    case 0:
+        r = solr ? make_solrquery(cl, zquery) : make_cqlquery(cl, zquery);
+        query_cache_add(wrbuf_cstr(key), r);
+        break;
+    }
+    wrbuf_destroy(key);
+    wrbuf_destroy(w);
+    return r;
+}
+
 const char *client_get_facet_limit_local(struct client *cl,
                                          struct session_database *sdb,
                                          int *l,
@@ -1303,20 +1772,22 @@ int client_parse_query(struct client *cl, const char *query,
     struct session *se = client_get_session(cl);
     struct conf_service *service = se->service;
     struct session_database *sdb = client_get_database(cl);
-    struct ccl_rpn_node *cn;
     int cerror, cpos;
     ODR odr_out;
-    CCL_bibset ccl_map = prepare_cclmap(cl, service->ccl_bibset);
+    query_cache_map_t map = prepare_cclmap(cl, service->ccl_bibset,
+                                           service->ccl_directives);
+    CCL_bibset ccl_map;
     const char *sru = session_setting_oneval(sdb, PZ_SRU);
     const char *pqf_prefix = session_setting_oneval(sdb, PZ_PQF_PREFIX);
     const char *pqf_strftime = session_setting_oneval(sdb, PZ_PQF_STRFTIME);
     const char *query_syntax = session_setting_oneval(sdb, PZ_QUERY_SYNTAX);
-    WRBUF w_ccl, w_pqf;
+    WRBUF w_ccl, w_pqf, w_query;
     int ret_value = 1;
     Z_RPNQuery *zquery;
 
-    if (!ccl_map)
+    if (!map)
         return -3;
+    ccl_map = query_cache_map_bibset(map);
 
     w_ccl = wrbuf_alloc();
     wrbuf_puts(w_ccl, query);
@@ -1330,7 +1801,9 @@ int client_parse_query(struct client *cl, const char *query,
 
     if (apply_limit(sdb, facet_limits, w_pqf, ccl_map, service))
     {
-        ccl_qual_rm(&ccl_map);
+        query_cache_map_release(map);
+        wrbuf_destroy(w_ccl);
+        wrbuf_destroy(w_pqf);
         return -2;
     }
 
@@ -1338,22 +1811,22 @@ int client_parse_query(struct client *cl, const char *query,
     cl->facet_limits = facet_limits_dup(facet_limits);
 
     yaz_log(YLOG_LOG, "Client %s: CCL query: %s limit: %s", client_get_id(cl), wrbuf_cstr(w_ccl), wrbuf_cstr(w_pqf));
-    cn = ccl_find_str(ccl_map, wrbuf_cstr(w_ccl), &cerror, &cpos);
-    ccl_qual_rm(&ccl_map);
-    if (!cn)
+    w_query = wrbuf_alloc();
+    if (ccl_to_pqf(map, wrbuf_cstr(w_ccl), w_query))
     {
         client_set_state(cl, Client_Error);
         session_log(se, YLOG_WARN, "Client %s: Failed to parse CCL query '%s'",
                     client_get_id(cl),
                     wrbuf_cstr(w_ccl));
+        query_cache_map_release(map);
         wrbuf_destroy(w_ccl);
         wrbuf_destroy(w_pqf);
+        wrbuf_destroy(w_query);
         return -1;
     }
-    wrbuf_destroy(w_ccl);
 
     if (!pqf_strftime || !*pqf_strftime)
-        ccl_pquery(w_pqf, cn);
+        wrbuf_puts(w_pqf, wrbuf_cstr(w_query));
     else
     {
         time_t cur_time = time(0);
@@ -1367,7 +1840,7 @@ int client_parse_query(struct client *cl, const char *query,
         for (; *cp; cp++)
         {
             if (cp[0] == '%')
-                ccl_pquery(w_pqf, cn);
+                wrbuf_puts(w_pqf, wrbuf_cstr(w_query));
             else
                 wrbuf_putc(w_pqf, cp[0]);
         }
@@ -1408,10 +1881,7 @@ int client_parse_query(struct client *cl, const char *query,
         /* Support for PQF on SRU targets. */
         if (strcmp(query_syntax, "pqf") != 0 && *sru)
         {
-            if (!strcmp(sru, "solr"))
-                cl->cqlquery = make_solrquery(cl, zquery);
-            else
-                cl->cqlquery = make_cqlquery(cl, zquery);
+            cl->cqlquery = make_native_query(cl, sru, zquery);
             if (!cl->cqlquery)
                 ret_value = -1;
             else
@@ -1425,13 +1895,21 @@ int client_parse_query(struct client *cl, const char *query,
     if (!se->relevance)
     {
         // Initialize relevance structure with query terms
-        se->relevance = relevance_create_ccl(se->service->charsets, cn,
-                                             se->service->rank_cluster,
-                                             se->service->rank_follow,
-                                             se->service->rank_lead,
-                                             se->service->rank_length);
+        struct ccl_rpn_node *cn =
+            ccl_find_str(ccl_map, wrbuf_cstr(w_ccl), &cerror, &cpos);
+        if (cn)
+        {
+            se->relevance = relevance_create_ccl(se->service->charsets, cn,
+                                                 se->service->rank_cluster,
+                                                 se->service->rank_follow,
+                                                 se->service->rank_lead,
+                                                 se->service->rank_length);
+            ccl_rpn_delete(cn);
+        }
     }
-    ccl_rpn_delete(cn);
+    query_cache_map_release(map);
+    wrbuf_destroy(w_ccl);
+    wrbuf_destroy(w_query);
     return ret_value;
 }
 
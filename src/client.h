@@ -104,12 +104,17 @@ int  client_get_maxrecs(struct client *cl);
 void client_remove_from_session(struct client *c);
 void client_incref(struct client *c);
 void client_got_records(struct client *c);
+void client_got_search(struct client *c);
 void client_lock(struct client *c);
 void client_unlock(struct client *c);
 
 int client_has_facet(struct client *cl, const char *name);
 void client_check_preferred_watch(struct client *cl);
 int client_reingest(struct client *cl);
+void client_search_cache_store(struct client *cl);
+int client_search_cache_filling(struct client *cl);
+void client_search_cache_record(struct client *cl, int position,
+                                const char *rec);
 const char *client_get_facet_limit_local(struct client *cl,
                                          struct session_database *sdb,
                                          int *l,
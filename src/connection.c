@@ -198,6 +198,7 @@ static struct connection *connection_create(struct client *cl,
 static void non_block_events(struct connection *co)
 {
     int got_records = 0;
+    int got_search = 0;
     IOCHAN iochan = co->iochan;
     ZOOM_connection link = co->link;
     while (1)
@@ -232,6 +233,7 @@ static void non_block_events(struct connection *co)
                 else
                 {
                     iochan_settimeout(iochan, co->session_timeout);
+                    client_search_cache_store(cl);
                     client_set_state(cl, Client_Idle);
                 }
                 yaz_cond_broadcast(co->host->cond_ready);
@@ -255,6 +257,7 @@ static void non_block_events(struct connection *co)
             break;
         case ZOOM_EVENT_RECV_SEARCH:
             client_search_response(cl);
+            got_search = 1;
             break;
         case ZOOM_EVENT_RECV_RECORD:
             client_record_response(cl);
@@ -275,6 +278,12 @@ static void non_block_events(struct connection *co)
             client_got_records(cl);
         }
     }
+    else if (got_search)
+    {
+        struct client *cl = co->client;
+        if (cl)
+            client_got_search(cl);
+    }
 }
 
 void connection_continue(struct connection *co)
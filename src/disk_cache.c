@@ -0,0 +1,879 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file disk_cache.c
+    \brief Persistent cache of search results in segment files
+
+    Second level of the search cache (see search_cache.c). Complete
+    results of a target are appended to segment files in a directory,
+    so they survive a restart and a warm node can serve popular searches
+    without contacting slow targets. Records are stored normalized
+    (output of the normalization stylesheets), so a hit needs no XSLT.
+
+    Segment files are named NNNNNNNN.seg and are never modified except
+    for appending. Each starts with SEGMENT_MAGIC followed by entries:
+
+    \verbatim
+    u32 ENTRY_MAGIC, u32 length, payload of length bytes
+    payload: u64 created, u64 hits, u32 startrecs, u32 maxrecs,
+             u32 num_records, u32 num_facets, str key, str suggestions,
+             num_records * (u32 position, str record),
+             num_facets * (str name, str term, u32 freq)
+    str: u32 length (0xffffffff for none), bytes, 0
+    \endverbatim
+
+    Integers are in host byte order. An index in memory maps the search
+    key (target, query, sort, range and settings) to the most recent entry
+    and is built by scanning the segments at start. Entries are read
+    through read-only memory maps of the segments. When the segments
+    exceed the size budget the oldest segment is removed. Superseded and
+    expired entries take space until the segment is removed or the
+    directory is compacted with pazpar2_cache.
+*/
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#if HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+
+#include <yaz/xmalloc.h>
+#include <yaz/wrbuf.h>
+#include <yaz/log.h>
+#include <yaz/mutex.h>
+#include <yaz/snprintf.h>
+
+#include "ppmutex.h"
+#include "jenkins_hash.h"
+#include "disk_cache.h"
+
+#define SEGMENT_MAGIC "PZ2SEG1\n"
+#define SEGMENT_MAGIC_LEN DISK_CACHE_SEGMENT_HEADER
+#define ENTRY_MAGIC 0x505a3245
+#define ENTRY_HEAD_LEN 8
+#define NO_STRING 0xffffffffU
+#define DISK_CACHE_BUCKETS 1024
+
+/* reads payload of entry */
+struct cursor {
+    const char *p;
+    const char *end;
+    int error;
+};
+
+static unsigned get_u32(struct cursor *c)
+{
+    unsigned v = 0;
+    if (c->end - c->p < 4)
+        c->error = 1;
+    else
+    {
+        memcpy(&v, c->p, 4);
+        c->p += 4;
+    }
+    return v;
+}
+
+static unsigned long long get_u64(struct cursor *c)
+{
+    unsigned long long v = 0;
+    if (c->end - c->p < 8)
+        c->error = 1;
+    else
+    {
+        memcpy(&v, c->p, 8);
+        c->p += 8;
+    }
+    return v;
+}
+
+static const char *get_str(struct cursor *c)
+{
+    const char *s;
+    unsigned len = get_u32(c);
+
+    if (c->error || len == NO_STRING)
+        return 0;
+    if ((size_t) (c->end - c->p) < (size_t) len + 1 || c->p[len])
+    {
+        c->error = 1;
+        return 0;
+    }
+    s = c->p;
+    c->p += len + 1;
+    return s;
+}
+
+static void put_u32(WRBUF w, unsigned v)
+{
+    wrbuf_write(w, (const char *) &v, 4);
+}
+
+static void put_u64(WRBUF w, unsigned long long v)
+{
+    wrbuf_write(w, (const char *) &v, 8);
+}
+
+static void put_str(WRBUF w, const char *s)
+{
+    if (!s)
+        put_u32(w, NO_STRING);
+    else
+    {
+        size_t len = strlen(s);
+        put_u32(w, (unsigned) len);
+        wrbuf_write(w, s, len + 1);
+    }
+}
+
+/* encodes entry with header into w */
+static void entry_encode(WRBUF w, search_cache_entry_t e, time_t created)
+{
+    unsigned length;
+    int i, position;
+    int maxrecs = search_cache_entry_maxrecs(e);
+    int num_facets = search_cache_entry_num_facets(e);
+
+    wrbuf_rewind(w);
+    put_u32(w, ENTRY_MAGIC);
+    put_u32(w, 0); /* length; set below */
+    put_u64(w, (unsigned long long) created);
+    put_u64(w, (unsigned long long) search_cache_entry_hits(e));
+    put_u32(w, (unsigned) search_cache_entry_startrecs(e));
+    put_u32(w, (unsigned) maxrecs);
+    put_u32(w, (unsigned) search_cache_entry_num_records(e));
+    put_u32(w, (unsigned) num_facets);
+    put_str(w, search_cache_entry_key(e));
+    put_str(w, search_cache_entry_suggestions(e));
+    for (i = 0; i < maxrecs; i++)
+    {
+        const char *rec = search_cache_entry_record(e, i, &position);
+        if (rec)
+        {
+            put_u32(w, (unsigned) position);
+            put_str(w, rec);
+        }
+    }
+    for (i = 0; i < num_facets; i++)
+    {
+        const char *term;
+        int freq;
+        const char *name = search_cache_entry_facet(e, i, &term, &freq);
+        put_str(w, name);
+        put_str(w, term);
+        put_u32(w, (unsigned) freq);
+    }
+    length = wrbuf_len(w) - ENTRY_HEAD_LEN;
+    memcpy(wrbuf_buf(w) + 4, &length, 4);
+}
+
+/** \brief decodes payload of entry
+    \param buf payload
+    \param length length of payload
+    \param created time the entry was written (result)
+    \returns entry (to be released with search_cache_entry_destroy) or
+    NULL if the payload is malformed
+*/
+search_cache_entry_t disk_cache_decode(const char *buf, size_t length,
+                                       time_t *created)
+{
+    struct cursor c;
+    search_cache_entry_t e;
+    Odr_int hits;
+    unsigned startrecs, maxrecs, num_records, num_facets, i;
+    const char *key, *suggestions;
+
+    c.p = buf;
+    c.end = buf + length;
+    c.error = 0;
+    *created = (time_t) get_u64(&c);
+    hits = (Odr_int) get_u64(&c);
+    startrecs = get_u32(&c);
+    maxrecs = get_u32(&c);
+    num_records = get_u32(&c);
+    num_facets = get_u32(&c);
+    key = get_str(&c);
+    suggestions = get_str(&c);
+    if (c.error || !key || num_records > maxrecs)
+        return 0;
+    e = search_cache_entry_new(key, (int) startrecs, (int) maxrecs);
+    search_cache_entry_set_hits(e, hits);
+    search_cache_entry_set_suggestions(e, suggestions);
+    for (i = 0; i < num_records && !c.error; i++)
+    {
+        int position = (int) get_u32(&c);
+        const char *rec = get_str(&c);
+        if (rec)
+            search_cache_entry_add_record(e, position, rec);
+    }
+    for (i = 0; i < num_facets && !c.error; i++)
+    {
+        const char *name = get_str(&c);
+        const char *term = get_str(&c);
+        int freq = (int) get_u32(&c);
+        if (name && term)
+            search_cache_entry_add_facet(e, name, term, freq);
+    }
+    if (c.error)
+    {
+        search_cache_entry_destroy(e);
+        return 0;
+    }
+    return e;
+}
+
+#if HAVE_SYS_MMAN_H && HAVE_DIRENT_H
+
+/** \brief scans segment file
+    \param fname file name of segment
+    \param fun called for each entry
+    \param data user data for fun
+    \returns size of valid part of segment; -1 if it is not a segment
+
+    The payload passed to fun is only valid during the call.
+*/
+long disk_cache_scan(const char *fname, disk_cache_scan_fun fun, void *data)
+{
+    struct stat st;
+    char *map;
+    size_t offset = SEGMENT_MAGIC_LEN;
+    int fd = open(fname, O_RDONLY);
+
+    if (fd == -1)
+        return -1;
+    if (fstat(fd, &st) || st.st_size < SEGMENT_MAGIC_LEN)
+    {
+        close(fd);
+        return -1;
+    }
+    map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    if (memcmp(map, SEGMENT_MAGIC, SEGMENT_MAGIC_LEN))
+    {
+        munmap(map, st.st_size);
+        return -1;
+    }
+    while (offset + ENTRY_HEAD_LEN <= (size_t) st.st_size)
+    {
+        unsigned magic, length;
+        struct cursor c;
+
+        memcpy(&magic, map + offset, 4);
+        memcpy(&length, map + offset + 4, 4);
+        if (magic != ENTRY_MAGIC
+            || offset + ENTRY_HEAD_LEN + length > (size_t) st.st_size)
+            break; /* truncated by crash */
+        c.p = map + offset + ENTRY_HEAD_LEN;
+        c.end = c.p + length;
+        c.error = 0;
+        {
+            time_t created = (time_t) get_u64(&c);
+            const char *key;
+
+            get_u64(&c);
+            get_u32(&c);
+            get_u32(&c);
+            get_u32(&c);
+            get_u32(&c);
+            key = get_str(&c);
+            if (c.error || !key)
+                break;
+            if (fun)
+                fun(data, map + offset + ENTRY_HEAD_LEN, offset, length,
+                    created, key);
+        }
+        offset += ENTRY_HEAD_LEN + length;
+    }
+    munmap(map, st.st_size);
+    return (long) offset;
+}
+
+/** \brief creates empty segment
+    \param fname file name of segment
+    \returns file descriptor for appending or -1 on error
+*/
+int disk_cache_segment_create(const char *fname)
+{
+    int fd = open(fname, O_RDWR|O_CREAT|O_EXCL|O_APPEND, 0666);
+    if (fd == -1)
+        return -1;
+    if (write(fd, SEGMENT_MAGIC, SEGMENT_MAGIC_LEN) != SEGMENT_MAGIC_LEN)
+    {
+        close(fd);
+        unlink(fname);
+        return -1;
+    }
+    return fd;
+}
+
+static long append_buf(int fd, WRBUF w)
+{
+    size_t len = wrbuf_len(w);
+    if (write(fd, wrbuf_buf(w), len) != (ssize_t) len)
+        return -1;
+    return (long) len;
+}
+
+/** \brief appends entry to segment
+    \param fd file descriptor of segment (see disk_cache_segment_create)
+    \param e entry
+    \param created time of entry
+    \returns number of bytes written; -1 on error
+*/
+long disk_cache_append(int fd, search_cache_entry_t e, time_t created)
+{
+    WRBUF w = wrbuf_alloc();
+    long r;
+
+    entry_encode(w, e, created);
+    r = append_buf(fd, w);
+    wrbuf_destroy(w);
+    return r;
+}
+
+void disk_cache_segment_name(char *fname, size_t sz, const char *dir,
+                             unsigned no)
+{
+    yaz_snprintf(fname, sz, "%s/%08u.seg", dir, no);
+}
+
+static int cmp_unsigned(const void *a, const void *b)
+{
+    unsigned x = *(const unsigned *) a;
+    unsigned y = *(const unsigned *) b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/** \brief lists segments of directory
+    \param dir directory
+    \param nos segment numbers in ascending order (result; xfree it)
+    \returns number of segments; -1 if directory cannot be read
+*/
+int disk_cache_segments(const char *dir, unsigned **nos)
+{
+    DIR *d = opendir(dir);
+    struct dirent *de;
+    int num = 0, max = 0;
+
+    *nos = 0;
+    if (!d)
+        return -1;
+    while ((de = readdir(d)))
+    {
+        unsigned no;
+        char dummy;
+        if (sscanf(de->d_name, "%8u.se%c", &no, &dummy) == 2
+            && strlen(de->d_name) == 12)
+        {
+            if (num == max)
+            {
+                max = max ? 2 * max : 16;
+                *nos = xrealloc(*nos, sizeof(**nos) * max);
+            }
+            (*nos)[num++] = no;
+        }
+    }
+    closedir(d);
+    if (num > 0)
+        qsort(*nos, num, sizeof(**nos), cmp_unsigned);
+    return num;
+}
+
+struct segment {
+    unsigned no;
+    int fd;
+    size_t size;        /* bytes in file */
+    char *map;          /* read-only map, 0 if not mapped yet */
+    size_t map_size;
+    struct segment *next;    /* oldest first */
+};
+
+struct index_entry {
+    char *key;
+    unsigned hash;
+    struct segment *seg;
+    size_t offset;      /* of entry header */
+    size_t length;      /* of payload */
+    time_t created;
+    struct index_entry *next;
+};
+
+static YAZ_MUTEX cache_mutex = 0;
+static char *cache_dir = 0;
+static struct index_entry **buckets = 0;
+static struct segment *segments = 0;
+static size_t cache_bytes = 0;
+static size_t max_bytes = 0;
+static size_t segment_max = 0;
+static int cache_ttl = 0;
+static int cache_entries = 0;
+static int num_segments = 0;
+static unsigned long cache_hits = 0;
+static unsigned long cache_misses = 0;
+static unsigned long cache_writes = 0;
+static unsigned long cache_evictions = 0;
+
+static void segment_fname(char *fname, size_t sz, unsigned no)
+{
+    disk_cache_segment_name(fname, sz, cache_dir, no);
+}
+
+static struct index_entry **index_find(unsigned h, const char *key)
+{
+    struct index_entry **ip = &buckets[h % DISK_CACHE_BUCKETS];
+    for (; *ip; ip = &(*ip)->next)
+        if ((*ip)->hash == h && !strcmp((*ip)->key, key))
+            break;
+    return ip;
+}
+
+static void index_remove(struct index_entry **ip)
+{
+    struct index_entry *ie = *ip;
+    *ip = ie->next;
+    xfree(ie->key);
+    xfree(ie);
+    cache_entries--;
+}
+
+/* most recent entry for key wins */
+static void index_update(const char *key, struct segment *seg,
+                         size_t offset, size_t length, time_t created)
+{
+    unsigned h = jenkins_hash((const unsigned char *) key);
+    struct index_entry **ip = index_find(h, key);
+    struct index_entry *ie = *ip;
+
+    if (!ie)
+    {
+        ie = xmalloc(sizeof(*ie));
+        ie->key = xstrdup(key);
+        ie->hash = h;
+        ie->next = 0;
+        *ip = ie;
+        cache_entries++;
+    }
+    ie->seg = seg;
+    ie->offset = offset;
+    ie->length = length;
+    ie->created = created;
+}
+
+static void scan_handler(void *data, const char *buf, size_t offset,
+                         size_t length, time_t created, const char *key)
+{
+    struct segment *seg = data;
+    if (created + cache_ttl > time(0))
+        index_update(key, seg, offset, length, created);
+}
+
+static struct segment *segment_add(unsigned no, int fd, size_t size)
+{
+    struct segment **sp = &segments;
+    struct segment *seg = xmalloc(sizeof(*seg));
+
+    seg->no = no;
+    seg->fd = fd;
+    seg->size = size;
+    seg->map = 0;
+    seg->map_size = 0;
+    seg->next = 0;
+    while (*sp)
+        sp = &(*sp)->next;
+    *sp = seg;
+    cache_bytes += size;
+    num_segments++;
+    return seg;
+}
+
+static void segment_free(struct segment *seg)
+{
+    if (seg->map)
+        munmap(seg->map, seg->map_size);
+    close(seg->fd);
+    cache_bytes -= seg->size;
+    num_segments--;
+    xfree(seg);
+}
+
+static struct segment *segment_active(void)
+{
+    struct segment *seg = segments;
+    while (seg && seg->next)
+        seg = seg->next;
+    return seg;
+}
+
+static struct segment *segment_new(void)
+{
+    struct segment *last = segment_active();
+    unsigned no = last ? last->no + 1 : 1;
+    char fname[1024];
+    int fd;
+
+    segment_fname(fname, sizeof(fname), no);
+    fd = disk_cache_segment_create(fname);
+    if (fd == -1)
+    {
+        yaz_log(YLOG_WARN|YLOG_ERRNO, "disk cache: cannot create %s", fname);
+        return 0;
+    }
+    return segment_add(no, fd, SEGMENT_MAGIC_LEN);
+}
+
+/* removes oldest segment and its index entries. Caller holds mutex */
+static void segment_evict(void)
+{
+    struct segment *seg = segments;
+    char fname[1024];
+    int i;
+
+    for (i = 0; i < DISK_CACHE_BUCKETS; i++)
+    {
+        struct index_entry **ip = &buckets[i];
+        while (*ip)
+            if ((*ip)->seg == seg)
+                index_remove(ip);
+            else
+                ip = &(*ip)->next;
+    }
+    segments = seg->next;
+    segment_fname(fname, sizeof(fname), seg->no);
+    if (unlink(fname))
+        yaz_log(YLOG_WARN|YLOG_ERRNO, "disk cache: cannot remove %s", fname);
+    segment_free(seg);
+    cache_evictions++;
+}
+
+/** \brief enables the cache and loads index of existing segments
+    \param dir directory of segment files
+    \param max_kbytes size budget in kilobytes; 0 disables the cache
+    \param ttl seconds an entry may be used
+    \retval 0 OK (or disabled)
+    \retval -1 directory could not be read
+*/
+int disk_cache_init(const char *dir, int max_kbytes, int ttl)
+{
+    unsigned *nos;
+    int num, i;
+
+    if (buckets || !dir || max_kbytes <= 0 || ttl <= 0)
+        return 0;
+    num = disk_cache_segments(dir, &nos);
+    if (num < 0)
+    {
+        yaz_log(YLOG_FATAL|YLOG_ERRNO, "disk cache: cannot open %s", dir);
+        return -1;
+    }
+
+    cache_dir = xstrdup(dir);
+    buckets = xmalloc(DISK_CACHE_BUCKETS * sizeof(*buckets));
+    memset(buckets, 0, DISK_CACHE_BUCKETS * sizeof(*buckets));
+    max_bytes = (size_t) max_kbytes * 1024;
+    segment_max = max_bytes / 8;
+    if (segment_max < 65536)
+        segment_max = 65536;
+    cache_ttl = ttl;
+    pazpar2_mutex_create(&cache_mutex, "disk_cache");
+
+    for (i = 0; i < num; i++)
+    {
+        char fname[1024];
+        struct segment *seg;
+        long size;
+        int fd;
+
+        segment_fname(fname, sizeof(fname), nos[i]);
+        if (disk_cache_scan(fname, 0, 0) < 0)
+        {
+            yaz_log(YLOG_WARN, "disk cache: %s is not a segment", fname);
+            continue;
+        }
+        fd = open(fname, O_RDWR|O_APPEND);
+        if (fd == -1)
+        {
+            yaz_log(YLOG_WARN|YLOG_ERRNO, "disk cache: cannot open %s",
+                    fname);
+            continue;
+        }
+        seg = segment_add(nos[i], fd, 0);
+        size = disk_cache_scan(fname, scan_handler, seg);
+        if (size < 0)
+            size = SEGMENT_MAGIC_LEN;
+        else if (ftruncate(fd, size)) /* drops entry cut by a crash */
+            yaz_log(YLOG_WARN|YLOG_ERRNO, "disk cache: cannot truncate %s",
+                    fname);
+        seg->size = size;
+        cache_bytes += size;
+    }
+    xfree(nos);
+    yaz_log(YLOG_LOG, "disk cache: %s: %d segments, %d entries, %ld KB",
+            dir, num_segments, cache_entries, (long) (cache_bytes / 1024));
+    return 0;
+}
+
+void disk_cache_destroy(void)
+{
+    int i;
+
+    if (!buckets)
+        return;
+    for (i = 0; i < DISK_CACHE_BUCKETS; i++)
+        while (buckets[i])
+            index_remove(&buckets[i]);
+    while (segments)
+    {
+        struct segment *seg = segments;
+        segments = seg->next;
+        segment_free(seg);
+    }
+    xfree(buckets);
+    buckets = 0;
+    xfree(cache_dir);
+    cache_dir = 0;
+    yaz_mutex_destroy(&cache_mutex);
+    cache_bytes = max_bytes = segment_max = 0;
+    cache_ttl = cache_entries = num_segments = 0;
+    cache_hits = cache_misses = cache_writes = cache_evictions = 0;
+}
+
+int disk_cache_enabled(void)
+{
+    return buckets != 0;
+}
+
+/* maps segment so that it covers need bytes. Caller holds mutex */
+static int segment_map(struct segment *seg, size_t need)
+{
+    char *map;
+
+    if (seg->map && seg->map_size >= need)
+        return 0;
+    if (need > seg->size)
+        return -1;
+    map = mmap(0, seg->size, PROT_READ, MAP_SHARED, seg->fd, 0);
+    if (map == MAP_FAILED)
+    {
+        yaz_log(YLOG_WARN|YLOG_ERRNO, "disk cache: mmap of segment %u",
+                seg->no);
+        return -1;
+    }
+    if (seg->map)
+        munmap(seg->map, seg->map_size);
+    seg->map = map;
+    seg->map_size = seg->size;
+    return 0;
+}
+
+/** \brief looks up result
+    \param key search key
+    \returns entry (to be released with search_cache_entry_destroy)
+    or NULL if there is no valid entry for key
+*/
+search_cache_entry_t disk_cache_lookup(const char *key)
+{
+    search_cache_entry_t e = 0;
+    struct index_entry **ip;
+    unsigned h;
+
+    if (!buckets)
+        return 0;
+    h = jenkins_hash((const unsigned char *) key);
+    yaz_mutex_enter(cache_mutex);
+    ip = index_find(h, key);
+    if (*ip && (*ip)->created + cache_ttl <= time(0))
+        index_remove(ip);
+    else if (*ip)
+    {
+        struct index_entry *ie = *ip;
+        time_t created;
+
+        if (!segment_map(ie->seg, ie->offset + ENTRY_HEAD_LEN + ie->length))
+            e = disk_cache_decode(ie->seg->map + ie->offset + ENTRY_HEAD_LEN,
+                                  ie->length, &created);
+        if (!e)
+            index_remove(ip);
+    }
+    if (e)
+        cache_hits++;
+    else
+        cache_misses++;
+    yaz_mutex_leave(cache_mutex);
+    return e;
+}
+
+/** \brief appends complete result to the active segment
+    \param e entry; the caller keeps its reference
+*/
+void disk_cache_store(search_cache_entry_t e)
+{
+    struct segment *seg;
+    WRBUF w;
+    time_t now = time(0);
+
+    if (!buckets || !e)
+        return;
+    w = wrbuf_alloc();
+    entry_encode(w, e, now);
+    if (wrbuf_len(w) > max_bytes / 2)
+    {
+        wrbuf_destroy(w);
+        return;
+    }
+    yaz_mutex_enter(cache_mutex);
+    seg = segment_active();
+    if (!seg || (seg->size > SEGMENT_MAGIC_LEN
+                 && seg->size + wrbuf_len(w) > segment_max))
+        seg = segment_new();
+    if (seg)
+    {
+        if (append_buf(seg->fd, w) < 0)
+        {
+            yaz_log(YLOG_WARN|YLOG_ERRNO, "disk cache: write to segment %u",
+                    seg->no);
+            /* drop a partial entry; scan stops at it anyway */
+            if (ftruncate(seg->fd, seg->size))
+                yaz_log(YLOG_WARN|YLOG_ERRNO, "disk cache: truncate of "
+                        "segment %u", seg->no);
+        }
+        else
+        {
+            index_update(search_cache_entry_key(e), seg, seg->size,
+                         wrbuf_len(w) - ENTRY_HEAD_LEN, now);
+            seg->size += wrbuf_len(w);
+            cache_bytes += wrbuf_len(w);
+            cache_writes++;
+            while (cache_bytes > max_bytes && segments != seg)
+                segment_evict();
+        }
+    }
+    yaz_mutex_leave(cache_mutex);
+    wrbuf_destroy(w);
+}
+
+void disk_cache_get_stat(struct disk_cache_stat *stat)
+{
+    memset(stat, 0, sizeof(*stat));
+    if (!buckets)
+        return;
+    yaz_mutex_enter(cache_mutex);
+    stat->segments = num_segments;
+    stat->entries = cache_entries;
+    stat->bytes = cache_bytes;
+    stat->max_bytes = max_bytes;
+    stat->ttl = cache_ttl;
+    stat->hits = cache_hits;
+    stat->misses = cache_misses;
+    stat->writes = cache_writes;
+    stat->evictions = cache_evictions;
+    yaz_mutex_leave(cache_mutex);
+}
+
+#else
+/* no memory maps; the cache is not available */
+
+void disk_cache_segment_name(char *fname, size_t sz, const char *dir,
+                             unsigned no)
+{
+    yaz_snprintf(fname, sz, "%s/%08u.seg", dir, no);
+}
+
+int disk_cache_segments(const char *dir, unsigned **nos)
+{
+    *nos = 0;
+    return -1;
+}
+
+long disk_cache_scan(const char *fname, disk_cache_scan_fun fun, void *data)
+{
+    return -1;
+}
+
+int disk_cache_segment_create(const char *fname)
+{
+    return -1;
+}
+
+long disk_cache_append(int fd, search_cache_entry_t e, time_t created)
+{
+    return -1;
+}
+
+int disk_cache_init(const char *dir, int max_kbytes, int ttl)
+{
+    if (dir && max_kbytes > 0)
+    {
+        yaz_log(YLOG_FATAL, "disk cache not supported on this platform");
+        return -1;
+    }
+    return 0;
+}
+
+void disk_cache_destroy(void)
+{
+}
+
+int disk_cache_enabled(void)
+{
+    return 0;
+}
+
+search_cache_entry_t disk_cache_lookup(const char *key)
+{
+    return 0;
+}
+
+void disk_cache_store(search_cache_entry_t e)
+{
+}
+
+void disk_cache_get_stat(struct disk_cache_stat *stat)
+{
+    memset(stat, 0, sizeof(*stat));
+}
+
+#endif
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
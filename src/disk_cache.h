@@ -0,0 +1,75 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file disk_cache.h
+    \brief Persistent cache of search results in segment files
+*/
+
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+#include <stddef.h>
+#include <time.h>
+#include "search_cache.h"
+
+struct disk_cache_stat {
+    int segments;
+    int entries;
+    size_t bytes;
+    size_t max_bytes;
+    int ttl;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long writes;
+    unsigned long evictions;
+};
+
+int disk_cache_init(const char *dir, int max_kbytes, int ttl);
+void disk_cache_destroy(void);
+int disk_cache_enabled(void);
+
+search_cache_entry_t disk_cache_lookup(const char *key);
+void disk_cache_store(search_cache_entry_t e);
+void disk_cache_get_stat(struct disk_cache_stat *stat);
+
+/* segment access, also used by the offline tool pazpar2_cache */
+#define DISK_CACHE_SEGMENT_HEADER 8  /* bytes of magic starting a segment */
+typedef void (*disk_cache_scan_fun)(void *data, const char *buf,
+                                    size_t offset, size_t length,
+                                    time_t created, const char *key);
+int disk_cache_segments(const char *dir, unsigned **nos);
+void disk_cache_segment_name(char *fname, size_t sz, const char *dir,
+                             unsigned no);
+long disk_cache_scan(const char *fname, disk_cache_scan_fun fun, void *data);
+search_cache_entry_t disk_cache_decode(const char *buf, size_t length,
+                                       time_t *created);
+int disk_cache_segment_create(const char *fname);
+long disk_cache_append(int fd, search_cache_entry_t e, time_t created);
+
+#endif
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
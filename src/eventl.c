@@ -55,6 +55,7 @@
 #include <yaz/xmalloc.h>
 #include <yaz/mutex.h>
 #include <yaz/poll.h>
+#include <yaz/gettimeofday.h>
 #include "eventl.h"
 #include "sel_thread.h"
 
@@ -168,6 +169,7 @@ IOCHAN iochan_create(int fd, IOC_CALLBACK cb, int flags, const char *name) {
     new_iochan->flags = flags;
     new_iochan->fun = cb;
     new_iochan->last_event = new_iochan->max_idle = 0;
+    new_iochan->deadline = 0.0;
     new_iochan->next = NULL;
     new_iochan->man = 0;
     new_iochan->thread_users = 0;
@@ -175,6 +177,23 @@ IOCHAN iochan_create(int fd, IOC_CALLBACK cb, int flags, const char *name) {
     return new_iochan;
 }
 
+static double clock_now(void) {
+    struct timeval tv;
+    yaz_gettimeofday(&tv);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/** \brief sets one-shot timeout of channel
+    \param i channel
+    \param ms milliseconds from now; negative to cancel
+
+    Unlike iochan_settimeout the timeout is not in whole seconds, and
+    it is not postponed by activity on the channel.
+*/
+void iochan_setdeadline(IOCHAN i, int ms) {
+    i->deadline = ms < 0 ? 0.0 : clock_now() + ms / 1000.0;
+}
+
 static void work_handler(void *work_data) {
     IOCHAN p = work_data;
 
@@ -217,6 +236,7 @@ static int event_loop(iochan_man_t man, IOCHAN *iochans) {
         int res, max;
         static struct timeval to;
         struct timeval *timeout;
+        double wait, now_d;
 
 //        struct yaz_poll_fd *fds;
         int no_fds = 0;
@@ -239,11 +259,15 @@ static int event_loop(iochan_man_t man, IOCHAN *iochans) {
 //        fds = (struct yaz_poll_fd *) xmalloc(no_fds * sizeof(*fds));
 
         max = 0;
+        now_d = clock_now();
+        wait = to.tv_sec;
         for (p = start; p; p = p->next) {
             if (p->thread_users > 0)
                 continue;
-            if (p->max_idle && p->max_idle < to.tv_sec)
-                to.tv_sec = p->max_idle;
+            if (p->max_idle && p->max_idle < wait)
+                wait = p->max_idle;
+            if (p->deadline != 0.0 && p->deadline - now_d < wait)
+                wait = p->deadline > now_d ? p->deadline - now_d : 0.0;
             if (p->fd < 0)
                 continue;
             if (p->flags & EVENT_INPUT)
@@ -255,6 +279,8 @@ static int event_loop(iochan_man_t man, IOCHAN *iochans) {
             if (p->fd > max)
                 max = p->fd;
         }
+        to.tv_sec = (long) wait;
+        to.tv_usec = (long) ((wait - to.tv_sec) * 1000000.0);
         yaz_log(man->log_level, "max=%d sel_fd=%d", max, man->sel_fd);
 
         if (man->sel_fd != -1) {
@@ -294,6 +320,7 @@ static int event_loop(iochan_man_t man, IOCHAN *iochans) {
             }
             yaz_log(man->log_level, "%d channels", no);
         }
+        now_d = clock_now();
         for (p = start; p; p = p->next) {
             time_t now = time(0);
 
@@ -315,6 +342,10 @@ static int event_loop(iochan_man_t man, IOCHAN *iochans) {
                 p->last_event = now;
                 p->this_event |= EVENT_TIMEOUT;
             }
+            if (p->deadline != 0.0 && now_d >= p->deadline) {
+                p->deadline = 0.0;
+                p->this_event |= EVENT_TIMEOUT;
+            }
             if (p->fd >= 0) {
                 if (FD_ISSET(p->fd, &in)) {
                     p->last_event = now;
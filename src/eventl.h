@@ -41,6 +41,7 @@ typedef struct iochan
     int destroyed;
     time_t last_event;
     time_t max_idle;
+    double deadline;  /* one-shot EVENT_TIMEOUT at this time; 0 for none */
     int this_event;
     int thread_users;
 
@@ -68,6 +69,7 @@ void iochan_man_destroy(iochan_man_t *mp);
 #define iochan_activity(i) ((i)->last_event = time(0))
 
 IOCHAN iochan_create(int fd, IOC_CALLBACK cb, int flags, const char *name);
+void iochan_setdeadline(IOCHAN i, int ms);
 
 void pazpar2_sleep(double d);
 
@@ -856,6 +856,50 @@ void http_send_response(struct http_channel *ch)
     }
 }
 
+/** \brief sends response headers of a streamed response
+    \param ch HTTP channel with response (payload is ignored)
+
+    The body has no length; it is written with http_send_stream and the
+    connection is closed after the last part. The channel stays busy,
+    so no further requests are read from it.
+*/
+void http_send_stream_head(struct http_channel *ch)
+{
+    struct http_response *rs = ch->response;
+    struct http_buf *hb;
+
+    assert(rs);
+    rs->payload = 0;
+    ch->keep_alive = 0;
+    ch->stream = 1;
+    hb = http_serialize_response(ch, rs);
+    if (hb)
+    {
+        http_buf_enqueue(&ch->oqueue, hb);
+        iochan_setflag(ch->iochan, EVENT_OUTPUT);
+    }
+}
+
+/** \brief sends part of streamed response body
+    \param ch HTTP channel
+    \param buf data
+    \param len length of data; must be positive for last part
+    \param last if non-zero, connection is closed when data is sent
+*/
+void http_send_stream(struct http_channel *ch, const char *buf, size_t len,
+                      int last)
+{
+    struct http_buf *hb = http_buf_bybuf(ch->http_server, (char *) buf, len);
+
+    if (last)
+        ch->stream = 0;
+    if (hb)
+    {
+        http_buf_enqueue(&ch->oqueue, hb);
+        iochan_setflag(ch->iochan, EVENT_OUTPUT);
+    }
+}
+
 static void http_error(struct http_channel *hc, int no, const char *msg)
 {
     struct http_response *rs = http_create_response(hc);
@@ -1001,7 +1045,7 @@ static void http_io(IOCHAN i, int event)
                 }
                 if (!hc->oqueue)
                 {
-                    if (!hc->keep_alive)
+                    if (!hc->keep_alive && !hc->stream)
                     {
                         http_channel_destroy(i);
                         return;
@@ -1171,6 +1215,7 @@ static struct http_channel *http_channel_create(http_server_t hs,
     r->iqueue = r->oqueue = 0;
     r->state = Http_Idle;
     r->keep_alive = 0;
+    r->stream = 0;
     r->request = 0;
     r->response = 0;
     if (!addr)
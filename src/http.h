@@ -43,6 +43,7 @@ struct http_channel
         Http_Busy      // Don't process new HTTP requests while we're busy
     } state;
     int keep_alive;
+    int stream;    // response body is streamed; keep open when queue is empty
     NMEM nmem;
     WRBUF wrbuf;
     struct http_request *request;
@@ -119,6 +120,9 @@ const char *http_argbyname(struct http_request *r, const char *name);
 const char *http_headerbyname(struct http_header *r, const char *name);
 struct http_response *http_create_response(struct http_channel *c);
 void http_send_response(struct http_channel *c);
+void http_send_stream_head(struct http_channel *c);
+void http_send_stream(struct http_channel *c, const char *buf, size_t len,
+                      int last);
 void urlencode(const char *i, char *o);
 
 typedef void (*http_channel_destroy_t)(void *data, struct http_channel *c,
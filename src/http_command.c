@@ -27,6 +27,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #endif
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #if HAVE_SYS_TIME_H
 #include <sys/time.h>
 #endif
@@ -40,6 +41,12 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "http.h"
 #include "settings.h"
 #include "client.h"
+#include "charset_cache.h"
+#include "search_cache.h"
+#include "disk_cache.h"
+#include "raw_cache.h"
+#include "query_cache.h"
+#include "jenkins_hash.h"
 
 #ifdef HAVE_MALLINFO
 #include <malloc.h>
@@ -77,19 +84,46 @@ struct http_session {
     struct session *psession;
     unsigned int session_id;
     int timestamp;
-    int destroy_counter;
-    int activity_counter;
+    volatile int destroy_counter;  // atomic
+    volatile int activity_counter; // modified with shard mutex held
     NMEM nmem;
     http_sessions_t http_sessions;
     struct http_session *next;
 };
 
-struct http_sessions {
-    struct http_session *session_list;
+/* sessions are hashed by id into shards, each with its own lock */
+#define HTTP_SESSION_SHARDS 16
+#define HTTP_SESSION_BUCKETS 256
+
+struct http_session_shard {
     YAZ_MUTEX mutex;
+    struct http_session *buckets[HTTP_SESSION_BUCKETS];
+};
+
+/* session ids: node id in the high bits, a permuted counter in the rest */
+#define SESSIONID_SEQ_BITS 24
+#define SESSIONID_SEQ_MASK ((1U << SESSIONID_SEQ_BITS) - 1)
+#define SESSIONID_MAX_NODE 127
+
+struct http_sessions {
+    struct http_session_shard shards[HTTP_SESSION_SHARDS];
+    volatile int id_seq;
+    unsigned int id_offset;
     int log_level;
 };
 
+static struct http_session_shard *session_shard(http_sessions_t hs,
+                                                unsigned int id)
+{
+    return hs->shards + id % HTTP_SESSION_SHARDS;
+}
+
+static struct http_session **session_bucket(struct http_session_shard *sh,
+                                            unsigned int id)
+{
+    return sh->buckets + (id / HTTP_SESSION_SHARDS) % HTTP_SESSION_BUCKETS;
+}
+
 static YAZ_MUTEX g_http_session_mutex = 0;
 static int g_http_sessions = 0;
 
@@ -120,9 +154,16 @@ int http_session_use(int delta)
 http_sessions_t http_sessions_create(void)
 {
     http_sessions_t hs = xmalloc(sizeof(*hs));
-    hs->session_list = 0;
-    hs->mutex = 0;
-    pazpar2_mutex_create(&hs->mutex, "http_sessions");
+    int i;
+    memset(hs, 0, sizeof(*hs));
+    for (i = 0; i < HTTP_SESSION_SHARDS; i++)
+        pazpar2_mutex_create(&hs->shards[i].mutex, "http_sessions");
+    hs->id_seq = 0;
+#ifdef WIN32
+    hs->id_offset = (unsigned int) time(0);
+#else
+    hs->id_offset = (unsigned int) time(0) ^ ((unsigned int) getpid() << 12);
+#endif
     hs->log_level = yaz_log_module_level("HTTP");
     return hs;
 }
@@ -131,16 +172,23 @@ void http_sessions_destroy(http_sessions_t hs)
 {
     if (hs)
     {
-        struct http_session *s = hs->session_list;
-        while (s)
+        int i, j;
+        for (i = 0; i < HTTP_SESSION_SHARDS; i++)
         {
-            struct http_session *s_next = s->next;
-            iochan_destroy(s->timeout_iochan);
-            session_destroy(s->psession);
-            nmem_destroy(s->nmem);
-            s = s_next;
+            for (j = 0; j < HTTP_SESSION_BUCKETS; j++)
+            {
+                struct http_session *s = hs->shards[i].buckets[j];
+                while (s)
+                {
+                    struct http_session *s_next = s->next;
+                    iochan_destroy(s->timeout_iochan);
+                    session_destroy(s->psession);
+                    nmem_destroy(s->nmem);
+                    s = s_next;
+                }
+            }
+            yaz_mutex_destroy(&hs->shards[i].mutex);
         }
-        yaz_mutex_destroy(&hs->mutex);
         xfree(hs);
     }
 }
@@ -169,10 +217,14 @@ struct http_session *http_session_create(struct conf_service *service,
     r->destroy_counter = r->activity_counter = 0;
     r->http_sessions = http_sessions;
 
-    yaz_mutex_enter(http_sessions->mutex);
-    r->next = http_sessions->session_list;
-    http_sessions->session_list = r;
-    yaz_mutex_leave(http_sessions->mutex);
+    {
+        struct http_session_shard *sh = session_shard(http_sessions, sesid);
+        struct http_session **bucket = session_bucket(sh, sesid);
+        yaz_mutex_enter(sh->mutex);
+        r->next = *bucket;
+        *bucket = r;
+        yaz_mutex_leave(sh->mutex);
+    }
 
     r->timeout_iochan = iochan_create(-1, session_timeout, 0, "http_session_timeout");
     iochan_setdata(r->timeout_iochan, r);
@@ -189,22 +241,26 @@ void http_session_destroy(struct http_session *s)
     int must_destroy = 0;
 
     http_sessions_t http_sessions = s->http_sessions;
+    struct http_session_shard *sh = session_shard(http_sessions,
+                                                  s->session_id);
 
     yaz_log(http_sessions->log_level, "Session %u destroy", s->session_id);
-    yaz_mutex_enter(http_sessions->mutex);
-    /* only if http_session has no active http sessions on it can be destroyed */
-    if (s->destroy_counter == s->activity_counter)
+    yaz_mutex_enter(sh->mutex);
+    /* only if http_session has no active http sessions on it can be destroyed.
+       activity_counter can't change while we hold the shard lock; a stale
+       destroy_counter only delays destruction until next timeout */
+    if (pazpar2_atomic_add(&s->destroy_counter, 0) == s->activity_counter)
     {
         struct http_session **p = 0;
         must_destroy = 1;
-        for (p = &http_sessions->session_list; *p; p = &(*p)->next)
+        for (p = session_bucket(sh, s->session_id); *p; p = &(*p)->next)
             if (*p == s)
             {
                 *p = (*p)->next;
                 break;
             }
     }
-    yaz_mutex_leave(http_sessions->mutex);
+    yaz_mutex_leave(sh->mutex);
     if (must_destroy)
     {   /* destroying for real */
         yaz_log(http_sessions->log_level, "Session %u destroyed", s->session_id);
@@ -300,33 +356,88 @@ static void response_close(struct http_channel *c, const char *command)
     http_send_response(c);
 }
 
-unsigned int make_sessionid(void)
+/** \brief sets ETag of response or answers conditional request
+    \param c HTTP channel
+    \param s HTTP session
+    \param gens bit mask of SESSION_GEN_.. the response depends on
+    \retval 1 If-None-Match matched; 304 Not Modified has been sent
+    \retval 0 ETag added; the response must be made as usual
+
+    The ETag combines the selected generation counters of the session
+    with a hash of the request arguments, so different windows or
+    termlists of the same session get different tags. The counters are
+    read live; a body made from a snapshot that is slightly behind
+    is revalidated at the latest when the clients go idle, since that
+    bumps SESSION_GEN_CLIENTS, which every conditional command
+    depends on.
+*/
+static int response_not_modified(struct http_channel *c,
+                                 struct http_session *s, int gens)
 {
-    static int seq = 0; /* thread pr */
-    unsigned int res;
+    struct http_request *rq = c->request;
+    struct http_response *rs = c->response;
+    const char *match = http_lookup_header(rq->headers, "If-None-Match");
+    struct http_header *h;
+    char etag[100];
+    unsigned args;
+    int i;
 
-    seq++;
-    if (global_parameters.predictable_sessions)
-        res = seq;
-    else
+    wrbuf_rewind(c->wrbuf);
+    wrbuf_puts(c->wrbuf, rq->search);
+    if (rq->content_buf)
+        wrbuf_write(c->wrbuf, rq->content_buf, rq->content_len);
+    args = jenkins_hash((const unsigned char *) wrbuf_cstr(c->wrbuf));
+
+    sprintf(etag, "\"%x-%x", c->http_sessions->id_offset, args);
+    for (i = 0; i <= SESSION_GEN_MAX; i++)
+        if (gens & (1 << i))
+            sprintf(etag + strlen(etag), "-%x",
+                    session_get_changes(s->psession, i));
+    strcat(etag, "\"");
+
+    http_addheader(rs, "ETag", etag);
+    /* no-store would keep browsers from revalidating */
+    for (h = rs->headers; h; h = h->next)
+        if (!strcmp(h->name, "Cache-Control"))
+            h->value = nmem_strdup(c->nmem, "no-cache");
+    if (match && strstr(match, etag))
     {
-#ifdef WIN32
-        res = seq;
-#else
-        struct timeval t;
+        strcpy(rs->code, "304");
+        rs->msg = "Not Modified";
+        http_send_response(c);
+        return 1;
+    }
+    return 0;
+}
 
-        if (gettimeofday(&t, 0) < 0)
-        {
-            yaz_log(YLOG_WARN|YLOG_ERRNO, "gettimeofday");
-            exit(1);
-        }
-        /* at most 256 sessions per second ..
-           (long long would be more appropriate)*/
-        res = t.tv_sec;
-        res = ((res << 8) | (seq & 0xff)) & ((1U << 31) - 1);
-#endif
+/** \brief makes new session ID
+    \param hs HTTP sessions
+    \param node_id node identifier encoded in upper bits (0..127)
+    \returns session ID
+
+    The lower 24 bits are an atomic counter multiplied by an odd constant
+    (a bijection modulo 2^24) and offset by a start value, so IDs are not
+    reused before 2^24 sessions have been created on this node, yet they
+    are not consecutive. Predictable sessions (-X / -d) just use the counter.
+    The result always fits in 31 bits.
+*/
+static unsigned int make_sessionid(http_sessions_t hs, int node_id)
+{
+    unsigned int node = ((unsigned int) node_id & SESSIONID_MAX_NODE)
+        << SESSIONID_SEQ_BITS;
+    unsigned int res;
+
+    do
+    {
+        unsigned int seq = (unsigned int) pazpar2_atomic_add(&hs->id_seq, 1);
+        if (global_parameters.predictable_sessions)
+            res = seq;
+        else
+            res = seq * 2654435761U + hs->id_offset;
+        res &= SESSIONID_SEQ_MASK;
     }
-    return res;
+    while (res == 0);
+    return node | res;
 }
 
 static struct http_session *locate_session(struct http_channel *c)
@@ -336,6 +447,7 @@ static struct http_session *locate_session(struct http_channel *c)
     struct http_session *p;
     const char *session = http_argbyname(rq, "session");
     http_sessions_t http_sessions = c->http_sessions;
+    struct http_session_shard *sh;
     unsigned int id;
 
     if (!session)
@@ -344,13 +456,14 @@ static struct http_session *locate_session(struct http_channel *c)
         return 0;
     }
     id = atoi(session);
-    yaz_mutex_enter(http_sessions->mutex);
-    for (p = http_sessions->session_list; p; p = p->next)
+    sh = session_shard(http_sessions, id);
+    yaz_mutex_enter(sh->mutex);
+    for (p = *session_bucket(sh, id); p; p = p->next)
         if (id == p->session_id)
             break;
     if (p)
         p->activity_counter++;
-    yaz_mutex_leave(http_sessions->mutex);
+    yaz_mutex_leave(sh->mutex);
     if (p)
         iochan_activity(p->timeout_iochan);
     else
@@ -362,11 +475,8 @@ static struct http_session *locate_session(struct http_channel *c)
 static void release_session(struct http_channel *c,
                             struct http_session *session)
 {
-    http_sessions_t http_sessions = c->http_sessions;
-    yaz_mutex_enter(http_sessions->mutex);
     if (session)
-        session->destroy_counter++;
-    yaz_mutex_leave(http_sessions->mutex);
+        pazpar2_atomic_add(&session->destroy_counter, 1);
 }
 
 // Decode settings parameters and apply to session
@@ -449,7 +559,7 @@ static void cmd_init(struct http_channel *c)
             return;
         }
     }
-    sesid = make_sessionid();
+    sesid = make_sessionid(c->http_sessions, c->server->node_id);
     s = http_session_create(service, c->http_sessions, sesid);
 
     yaz_log(c->http_sessions->log_level, "Session init %u ", sesid);
@@ -462,7 +572,7 @@ static void cmd_init(struct http_channel *c)
         return;
 
     response_open(c, "init");
-    wrbuf_printf(c->wrbuf, "<session>%d", sesid);
+    wrbuf_printf(c->wrbuf, "<session>%u", sesid);
     if (c->server->server_id)
     {
         wrbuf_puts(c->wrbuf, ".");
@@ -540,6 +650,10 @@ static void termlist_response(struct http_channel *c, struct http_session *s, co
     if (nums)
         num = atoi(nums);
 
+    if (response_not_modified(c, s, (1 << SESSION_GEN_TERMLIST) |
+                              (1 << SESSION_GEN_CLIENTS)))
+        return;
+
     status = session_active_clients(s->psession);
 
     response_open_no_status(c, "termlist");
@@ -554,6 +668,42 @@ static void termlist_response(struct http_channel *c, struct http_session *s, co
     response_close(c, "termlist");
 }
 
+/** \brief parses block parameter of show, termlist and bytarget
+    \param block value of block parameter ("1" or thresholds)
+    \param service service with default thresholds
+    \param min_records number of new records before release (result)
+    \param window_ms milliseconds before release (result)
+    \retval 1 block (value is 1 or records:N, ms:T separated by comma)
+    \retval 0 do not block (no, empty or malformed value)
+*/
+static int parse_block(const char *block, struct conf_service *service,
+                       int *min_records, int *window_ms)
+{
+    *min_records = service->block_records;
+    *window_ms = service->block_window;
+    if (!block || !*block)
+        return 0;
+    if (!strcmp(block, "1"))
+        return 1;
+    *min_records = *window_ms = 0;
+    while (*block)
+    {
+        int v, len;
+        if (sscanf(block, "records:%d%n", &v, &len) == 1 && v >= 0)
+            *min_records = v;
+        else if (sscanf(block, "ms:%d%n", &v, &len) == 1 && v >= 0)
+            *window_ms = v;
+        else
+            return 0;
+        block += len;
+        if (*block == ',')
+            block++;
+        else if (*block)
+            return 0;
+    }
+    return 1;
+}
+
 static void termlist_result_ready(void *data)
 {
     struct http_channel *c = (struct http_channel *) data;
@@ -573,51 +723,27 @@ static void termlist_result_ready(void *data)
 static void cmd_termlist(struct http_channel *c)
 {
     struct http_request *rq = c->request;
-    struct http_response *rs = c->response;
     struct http_session *s = locate_session(c);
     const char *block = http_argbyname(rq, "block");
     const char *report = http_argbyname(rq, "report");
-    int report_status = 0;
-    int report_error = 0;
     const char *status_message = 0;
     int active_clients;
-    if (report  && !strcmp("error", report)) {
-        report_error = 1;
-        status_message = "OK";
-    }
-    if (report  && !strcmp("status", report)) {
-        report_status = 1;
+    int min_records, window_ms;
+    if (report && (!strcmp("error", report) || !strcmp("status", report)))
         status_message = "OK";
-    }
     if (!s)
         return;
 
     active_clients = session_active_clients(s->psession);
-    if (block && !strcmp("1", block) && active_clients)
+    if (parse_block(block, s->psession->service, &min_records, &window_ms)
+        && active_clients)
     {
-        // if there is already a watch/block. we do not block this one
-        if (session_set_watch(s->psession, SESSION_WATCH_TERMLIST,
-                              termlist_result_ready, c, c) != 0)
-        {
-            yaz_log(YLOG_WARN, "Session %u: Attempt to block multiple times on termlist block. Not supported!", s->session_id);
-            if (report_error) {
-                error(rs, PAZPAR2_ALREADY_BLOCKED, "termlist");
-                release_session(c, s);
-                return;
-            }
-            else if (report_status) {
-                status_message = "WARNING (Already blocked on termlist)";
-            }
-            else {
-                yaz_log(YLOG_WARN, "Session %u: Ignoring termlist block. Return current result", s->session_id);
-            }
-        }
-        else
-        {
-            yaz_log(c->http_sessions->log_level, "Session %u: Blocking on command termlist", s->session_id);
-            release_session(c, s);
-            return;
-        }
+        session_set_watch(s->psession, SESSION_WATCH_TERMLIST,
+                          termlist_result_ready, c, c,
+                          min_records, window_ms);
+        yaz_log(c->http_sessions->log_level, "Session %u: Blocking on command termlist", s->session_id);
+        release_session(c, s);
+        return;
     }
 
     termlist_response(c, s, status_message);
@@ -628,11 +754,17 @@ size_t session_get_memory_status(struct session *session);
 
 static void session_status(struct http_channel *c, struct http_session *s)
 {
-    size_t session_nmem;
+    size_t session_nmem, strings_unique, strings_saved;
     wrbuf_printf(c->wrbuf, "<http_count>%u</http_count>\n", s->activity_counter);
     wrbuf_printf(c->wrbuf, "<http_nmem>%zu</http_nmem>\n", nmem_total(s->nmem) );
     session_nmem = session_get_memory_status(s->psession);
     wrbuf_printf(c->wrbuf, "<session_nmem>%zu</session_nmem>\n", session_nmem);
+    session_get_string_pool_status(s->psession, &strings_unique,
+                                   &strings_saved);
+    wrbuf_printf(c->wrbuf, "<session_strings>%zu</session_strings>\n",
+                 strings_unique);
+    wrbuf_printf(c->wrbuf, "<session_strings_saved>%zu</session_strings_saved>\n",
+                 strings_saved);
 }
 
 static void cmd_session_status(struct http_channel *c)
@@ -660,12 +792,76 @@ static void cmd_server_status(struct http_channel *c)
     int sessions   = sessions_count();
     int clients    = clients_count();
     int resultsets = resultsets_count();
+    struct charset_cache_stat cc_stat;
+    struct search_cache_stat sc_stat;
+    struct disk_cache_stat dc_stat;
+    struct raw_cache_stat rc_stat;
+    struct query_cache_stat qc_stat;
 
     response_open(c, "server-status");
     wrbuf_printf(c->wrbuf, "\n  <sessions>%u</sessions>\n", sessions);
     wrbuf_printf(c->wrbuf, "  <clients>%u</clients>\n",   clients);
     /* Only works if yaz has been compiled with enabling of this */
     wrbuf_printf(c->wrbuf, "  <resultsets>%u</resultsets>\n",resultsets);
+    charset_cache_get_stat(&cc_stat);
+    wrbuf_printf(c->wrbuf, "  <normalization-cache>\n"
+                 "   <entries>%d</entries>\n"
+                 "   <max-entries>%d</max-entries>\n"
+                 "   <hits>%lu</hits>\n"
+                 "   <misses>%lu</misses>\n"
+                 "   <evictions>%lu</evictions>\n"
+                 "  </normalization-cache>\n",
+                 cc_stat.entries, cc_stat.max_entries,
+                 cc_stat.hits, cc_stat.misses, cc_stat.evictions);
+    search_cache_get_stat(&sc_stat);
+    wrbuf_printf(c->wrbuf, "  <search-cache>\n"
+                 "   <entries>%d</entries>\n"
+                 "   <bytes>%zu</bytes>\n"
+                 "   <max-bytes>%zu</max-bytes>\n"
+                 "   <hits>%lu</hits>\n"
+                 "   <misses>%lu</misses>\n"
+                 "   <evictions>%lu</evictions>\n"
+                 "  </search-cache>\n",
+                 sc_stat.entries, sc_stat.bytes, sc_stat.max_bytes,
+                 sc_stat.hits, sc_stat.misses, sc_stat.evictions);
+    disk_cache_get_stat(&dc_stat);
+    wrbuf_printf(c->wrbuf, "  <disk-cache>\n"
+                 "   <segments>%d</segments>\n"
+                 "   <entries>%d</entries>\n"
+                 "   <bytes>%zu</bytes>\n"
+                 "   <max-bytes>%zu</max-bytes>\n"
+                 "   <hits>%lu</hits>\n"
+                 "   <misses>%lu</misses>\n"
+                 "   <writes>%lu</writes>\n"
+                 "   <evictions>%lu</evictions>\n"
+                 "  </disk-cache>\n",
+                 dc_stat.segments, dc_stat.entries, dc_stat.bytes,
+                 dc_stat.max_bytes, dc_stat.hits, dc_stat.misses,
+                 dc_stat.writes, dc_stat.evictions);
+    raw_cache_get_stat(&rc_stat);
+    wrbuf_printf(c->wrbuf, "  <raw-cache>\n"
+                 "   <entries>%d</entries>\n"
+                 "   <bytes>%zu</bytes>\n"
+                 "   <max-bytes>%zu</max-bytes>\n"
+                 "   <hits>%lu</hits>\n"
+                 "   <misses>%lu</misses>\n"
+                 "   <evictions>%lu</evictions>\n"
+                 "  </raw-cache>\n",
+                 rc_stat.entries, rc_stat.bytes, rc_stat.max_bytes,
+                 rc_stat.hits, rc_stat.misses, rc_stat.evictions);
+    query_cache_get_stat(&qc_stat);
+    wrbuf_printf(c->wrbuf, "  <query-cache>\n"
+                 "   <maps>%d</maps>\n"
+                 "   <queries>%d</queries>\n"
+                 "   <max-entries>%d</max-entries>\n"
+                 "   <map-hits>%lu</map-hits>\n"
+                 "   <map-misses>%lu</map-misses>\n"
+                 "   <query-hits>%lu</query-hits>\n"
+                 "   <query-misses>%lu</query-misses>\n"
+                 "  </query-cache>\n",
+                 qc_stat.maps, qc_stat.queries, qc_stat.max_entries,
+                 qc_stat.map_hits, qc_stat.map_misses,
+                 qc_stat.query_hits, qc_stat.query_misses);
     print_meminfo(c->wrbuf);
 
 /* TODO add all sessions status                         */
@@ -690,13 +886,66 @@ static void cmd_server_status(struct http_channel *c)
     xmalloc_trav(0);
 }
 
+/* writes content of one target element of bytarget */
+static void write_target(WRBUF w, struct hitsbytarget *ht, int version,
+                         int settings)
+{
+    wrbuf_puts(w, "<id>");
+    wrbuf_xmlputs(w, ht->id);
+    wrbuf_puts(w, "</id>\n");
+
+    if (ht->name && ht->name[0])
+    {
+        wrbuf_puts(w, "<name>");
+        wrbuf_xmlputs(w, ht->name);
+        wrbuf_puts(w, "</name>\n");
+    }
+
+    wrbuf_printf(w, "<hits>" ODR_INT_PRINTF "</hits>\n", ht->hits);
+    wrbuf_printf(w, "<diagnostic>%d</diagnostic>\n", ht->diagnostic);
+    if (ht->diagnostic)
+    {
+        wrbuf_puts(w, "<message>");
+        wrbuf_xmlputs(w, ht->message);
+        wrbuf_puts(w, "</message>\n");
+        wrbuf_puts(w, "<addinfo>");
+        if (ht->addinfo)
+            wrbuf_xmlputs(w, ht->addinfo);
+        wrbuf_puts(w, "</addinfo>\n");
+    }
+
+    wrbuf_printf(w, "<records>%d</records>\n", ht->records - ht->filtered);
+    if (version >= 2) {
+        wrbuf_printf(w, "<filtered>%d</filtered>\n", ht->filtered);
+        wrbuf_printf(w, "<approximation>" ODR_INT_PRINTF "</approximation>\n", ht->approximation);
+    }
+    wrbuf_puts(w, "<state>");
+    wrbuf_xmlputs(w, ht->state);
+    wrbuf_puts(w, "</state>\n");
+    if (settings)
+    {
+        wrbuf_puts(w, "<settings>\n");
+        wrbuf_puts(w, ht->settings_xml);
+        wrbuf_puts(w, "</settings>\n");
+    }
+    if (ht->suggestions_xml && ht->suggestions_xml[0]) {
+        wrbuf_puts(w, "<suggestions>");
+        wrbuf_puts(w, ht->suggestions_xml);
+        wrbuf_puts(w, "</suggestions>");
+    }
+}
+
 static void bytarget_response(struct http_channel *c, struct http_session *s, const char *cmd_status) {
     int count, i;
     struct hitsbytarget *ht;
     struct http_request *rq = c->request;
     const char *settings = http_argbyname(rq, "settings");
     int version = get_version(rq);
-    ht = get_hitsbytarget(s->psession, &count, c->nmem);
+
+    if (response_not_modified(c, s, 1 << SESSION_GEN_CLIENTS))
+        return;
+    ht = get_hitsbytarget(s->psession, settings && *settings == '1',
+                          &count, c->nmem);
     if (!cmd_status)
         /* Old protocol, always ok */
         response_open(c, "bytarget");
@@ -711,50 +960,7 @@ static void bytarget_response(struct http_channel *c, struct http_session *s, co
     for (i = 0; i < count; i++)
     {
         wrbuf_puts(c->wrbuf, "\n<target>");
-
-        wrbuf_puts(c->wrbuf, "<id>");
-        wrbuf_xmlputs(c->wrbuf, ht[i].id);
-        wrbuf_puts(c->wrbuf, "</id>\n");
-
-        if (ht[i].name && ht[i].name[0])
-        {
-            wrbuf_puts(c->wrbuf, "<name>");
-            wrbuf_xmlputs(c->wrbuf, ht[i].name);
-            wrbuf_puts(c->wrbuf, "</name>\n");
-        }
-
-        wrbuf_printf(c->wrbuf, "<hits>" ODR_INT_PRINTF "</hits>\n", ht[i].hits);
-        wrbuf_printf(c->wrbuf, "<diagnostic>%d</diagnostic>\n", ht[i].diagnostic);
-        if (ht[i].diagnostic)
-        {
-            wrbuf_puts(c->wrbuf, "<message>");
-            wrbuf_xmlputs(c->wrbuf, ht[i].message);
-            wrbuf_puts(c->wrbuf, "</message>\n");
-            wrbuf_puts(c->wrbuf, "<addinfo>");
-            if (ht[i].addinfo)
-                wrbuf_xmlputs(c->wrbuf, ht[i].addinfo);
-            wrbuf_puts(c->wrbuf, "</addinfo>\n");
-        }
-
-        wrbuf_printf(c->wrbuf, "<records>%d</records>\n", ht[i].records - ht[i].filtered);
-        if (version >= 2) {
-            wrbuf_printf(c->wrbuf, "<filtered>%d</filtered>\n", ht[i].filtered);
-            wrbuf_printf(c->wrbuf, "<approximation>" ODR_INT_PRINTF "</approximation>\n", ht[i].approximation);
-        }
-        wrbuf_puts(c->wrbuf, "<state>");
-        wrbuf_xmlputs(c->wrbuf, ht[i].state);
-        wrbuf_puts(c->wrbuf, "</state>\n");
-        if (settings && *settings == '1')
-        {
-            wrbuf_puts(c->wrbuf, "<settings>\n");
-            wrbuf_puts(c->wrbuf, ht[i].settings_xml);
-            wrbuf_puts(c->wrbuf, "</settings>\n");
-        }
-        if (ht[i].suggestions_xml && ht[i].suggestions_xml[0]) {
-            wrbuf_puts(c->wrbuf, "<suggestions>");
-            wrbuf_puts(c->wrbuf, ht[i].suggestions_xml);
-            wrbuf_puts(c->wrbuf, "</suggestions>");
-        }
+        write_target(c->wrbuf, ht + i, version, settings && *settings == '1');
         wrbuf_puts(c->wrbuf, "</target>");
     }
     response_close(c, "bytarget");
@@ -779,56 +985,64 @@ static void bytarget_result_ready(void *data)
 static void cmd_bytarget(struct http_channel *c)
 {
     struct http_request *rq = c->request;
-    struct http_response *rs = c->response;
     struct http_session *s = locate_session(c);
     const char *block = http_argbyname(rq, "block");
-    const char *report = http_argbyname(rq, "report");
-    int report_error = 0;
-    int report_status = 0;
     const char *status_message = "OK";
     int no_active;
-
-    if (report && !strcmp("error", report)) {
-        report_error = 1;
-    }
-    if (report && !strcmp("status", report)) {
-        report_status = 1;
-    }
+    int min_records, window_ms;
 
     if (!s)
         return;
 
     no_active = session_active_clients(s->psession);
-    if (block && !strcmp("1",block) && no_active)
+    if (parse_block(block, s->psession->service, &min_records, &window_ms)
+        && no_active)
     {
-        // if there is already a watch/block. we do not block this one
-        if (session_set_watch(s->psession, SESSION_WATCH_BYTARGET,
-                              bytarget_result_ready, c, c) != 0)
-        {
-            yaz_log(YLOG_WARN, "Session %u: Attempt to block multiple times on bytarget block. Not supported!", s->session_id);
-            if (report_error) {
-                error(rs, PAZPAR2_ALREADY_BLOCKED, "bytarget");
-                release_session(c, s);
-                return;
-            }
-            else if (report_status) {
-                status_message = "WARNING (Already blocked on bytarget)";
-            }
-            else {
-                yaz_log(YLOG_WARN, "Session %u: Ignoring bytarget block. Return current result.", s->session_id);
-            }
-        }
-        else
-        {
-            yaz_log(c->http_sessions->log_level, "Session %u: Blocking on command bytarget", s->session_id);
-            release_session(c, s);
-            return;
-        }
+        session_set_watch(s->psession, SESSION_WATCH_BYTARGET,
+                          bytarget_result_ready, c, c,
+                          min_records, window_ms);
+        yaz_log(c->http_sessions->log_level, "Session %u: Blocking on command bytarget", s->session_id);
+        release_session(c, s);
+        return;
     }
     bytarget_response(c, s, status_message);
     release_session(c, s);
 }
 
+static void write_metadata_value(WRBUF w, struct conf_metadata *cmd,
+                                 const union data_types *data,
+                                 struct record_metadata_attr *attr,
+                                 int indent)
+{
+    int i;
+    for (i = 0; i < indent; i++)
+        wrbuf_putc(w, ' ');
+    wrbuf_printf(w, "<md-%s", cmd->name);
+
+    for (; attr; attr = attr->next)
+    {
+        wrbuf_printf(w, " %s=\"", attr->name);
+        wrbuf_xmlputs(w, attr->value);
+        wrbuf_puts(w, "\"");
+    }
+    wrbuf_puts(w, ">");
+    switch (cmd->type)
+    {
+        case Metadata_type_generic:
+            wrbuf_xmlputs(w, data->text.disp);
+            break;
+        case Metadata_type_year:
+            wrbuf_printf(w, "%d", data->number.min);
+            if (data->number.min != data->number.max)
+                wrbuf_printf(w, "-%d", data->number.max);
+            break;
+        default:
+            wrbuf_puts(w, "[can't represent]");
+            break;
+    }
+    wrbuf_printf(w, "</md-%s>\n", cmd->name);
+}
+
 static void write_metadata(WRBUF w, struct conf_service *service,
                            struct record_metadata **ml, int full, int indent)
 {
@@ -841,36 +1055,24 @@ static void write_metadata(WRBUF w, struct conf_service *service,
         if (!cmd->brief && !full)
             continue;
         for (md = ml[imeta]; md; md = md->next)
-        {
-            struct record_metadata_attr *attr = md->attributes;
-            int i;
-            for (i = 0; i < indent; i++)
-                wrbuf_putc(w, ' ');
-            wrbuf_printf(w, "<md-%s", cmd->name);
+            write_metadata_value(w, cmd, &md->data, md->attributes, indent);
+    }
+}
 
-            for (; attr; attr = attr->next)
-            {
-                wrbuf_printf(w, " %s=\"", attr->name);
-                wrbuf_xmlputs(w, attr->value);
-                wrbuf_puts(w, "\"");
-            }
-            wrbuf_puts(w, ">");
-            switch (cmd->type)
-            {
-                case Metadata_type_generic:
-                    wrbuf_xmlputs(w, md->data.text.disp);
-                    break;
-                case Metadata_type_year:
-                    wrbuf_printf(w, "%d", md->data.number.min);
-                    if (md->data.number.min != md->data.number.max)
-                        wrbuf_printf(w, "-%d", md->data.number.max);
-                    break;
-                default:
-                    wrbuf_puts(w, "[can't represent]");
-                    break;
-            }
-            wrbuf_printf(w, "</md-%s>\n", cmd->name);
-        }
+static void write_record_metadata(WRBUF w, struct conf_service *service,
+                                  struct record *r, int full, int indent)
+{
+    int imeta;
+
+    for (imeta = 0; imeta < service->num_metadata; imeta++)
+    {
+        struct conf_metadata *cmd = &service->metadata[imeta];
+        int j;
+        if (!cmd->brief && !full)
+            continue;
+        for (j = r->field_start[imeta]; j < r->field_start[imeta + 1]; j++)
+            write_metadata_value(w, cmd, &r->values[j].data,
+                                 r->values[j].attributes, indent);
     }
 }
 
@@ -896,7 +1098,7 @@ static void write_subrecord(struct record *r, WRBUF w,
     wrbuf_printf(w, "%u", r->checksum);
     wrbuf_puts(w, "\">\n");
 
-    write_metadata(w, service, r->metadata, show_details, 2);
+    write_record_metadata(w, service, r, show_details, 2);
     wrbuf_puts(w, " </location>\n");
 }
 
@@ -975,11 +1177,9 @@ static void show_record(struct http_channel *c, struct http_session *s)
         {
             error(rs, PAZPAR2_RECORD_MISSING, idstr);
         }
-        else if (session_set_watch(s->psession, SESSION_WATCH_RECORD,
-                              cmd_record_ready, c, c) != 0)
-        {
-            error(rs, PAZPAR2_RECORD_MISSING, idstr);
-        }
+        else
+            session_set_watch(s->psession, SESSION_WATCH_RECORD,
+                              cmd_record_ready, c, c, 0, 0);
         return;
     }
     if (offsetstr || checksumstr)
@@ -1081,6 +1281,34 @@ static void cmd_record(struct http_channel *c)
 }
 
 
+/* writes content of one hit element of show */
+static void write_hit(WRBUF w, struct conf_service *service,
+                      struct record_cluster *rec, const char *sort)
+{
+    int ccount;
+    struct record *p;
+
+    write_metadata(w, service, rec->metadata, 0, 1);
+    for (ccount = 0, p = rec->records; p;  p = p->next, ccount++)
+        write_subrecord(p, w, service, 0); // subrecs w/o details
+    wrbuf_printf(w, " <count>%d</count>\n", ccount);
+    if (strstr(sort, "relevance"))
+    {
+        wrbuf_printf(w, " <relevance>%d</relevance>\n",
+                     rec->relevance_score);
+        if (service->rank_debug)
+        {
+            wrbuf_printf(w, " <relevance_info>\n");
+            wrbuf_xmlputs(w, wrbuf_cstr(rec->relevance_explain1));
+            wrbuf_xmlputs(w, wrbuf_cstr(rec->relevance_explain2));
+            wrbuf_printf(w, " </relevance_info>\n");
+        }
+    }
+    wrbuf_puts(w, " <recid>");
+    wrbuf_xmlputs(w, rec->recid);
+    wrbuf_puts(w, "</recid>\n");
+}
+
 static void show_records(struct http_channel *c, struct http_session *s, int active)
 {
     struct http_request *rq = c->request;
@@ -1122,7 +1350,11 @@ static void show_records(struct http_channel *c, struct http_session *s, int act
 
     }
 
-    rl = show_range_start(s->psession, sp, startn, &numn, &total, &total_hits, &approx_hits);
+    if (response_not_modified(c, s, (1 << SESSION_GEN_RECLIST) |
+                              (1 << SESSION_GEN_CLIENTS)))
+        return;
+
+    rl = show_range_start(s->psession, c->nmem, sp, startn, &numn, &total, &total_hits, &approx_hits);
 
     response_open(c, "show");
     wrbuf_printf(c->wrbuf, "\n<activeclients>%d</activeclients>\n", active);
@@ -1136,31 +1368,8 @@ static void show_records(struct http_channel *c, struct http_session *s, int act
 
     for (i = 0; i < numn; i++)
     {
-        int ccount;
-        struct record *p;
-        struct record_cluster *rec = rl[i];
-        struct conf_service *service = s->psession->service;
-
         wrbuf_puts(c->wrbuf, "<hit>\n");
-        write_metadata(c->wrbuf, service, rec->metadata, 0, 1);
-        for (ccount = 0, p = rl[i]->records; p;  p = p->next, ccount++)
-            write_subrecord(p, c->wrbuf, service, 0); // subrecs w/o details
-        wrbuf_printf(c->wrbuf, " <count>%d</count>\n", ccount);
-	if (strstr(sort, "relevance"))
-        {
-	    wrbuf_printf(c->wrbuf, " <relevance>%d</relevance>\n",
-                         rec->relevance_score);
-            if (service->rank_debug)
-            {
-                wrbuf_printf(c->wrbuf, " <relevance_info>\n");
-                wrbuf_xmlputs(c->wrbuf, wrbuf_cstr(rec->relevance_explain1));
-                wrbuf_xmlputs(c->wrbuf, wrbuf_cstr(rec->relevance_explain2));
-                wrbuf_printf(c->wrbuf, " </relevance_info>\n");
-            }
-        }
-        wrbuf_puts(c->wrbuf, " <recid>");
-        wrbuf_xmlputs(c->wrbuf, rec->recid);
-        wrbuf_puts(c->wrbuf, "</recid>\n");
+        write_hit(c->wrbuf, s->psession->service, rl[i], sort);
         wrbuf_puts(c->wrbuf, "</hit>\n");
     }
 
@@ -1186,19 +1395,13 @@ static void show_records_ready(void *data)
 static void cmd_show(struct http_channel *c)
 {
     struct http_request  *rq = c->request;
-    struct http_response *rs = c->response;
     struct http_session *s = locate_session(c);
     const char *block = http_argbyname(rq, "block");
     const char *sort = http_argbyname(rq, "sort");
-    const char *block_error = http_argbyname(rq, "report");
     struct conf_service *service = 0;
 
     struct reclist_sortparms *sp;
     int status;
-    int report_error = 0;
-    if (block_error && !strcmp("1", block_error)) {
-        report_error = 1;
-    }
     if (!s)
         return;
 
@@ -1221,52 +1424,25 @@ static void cmd_show(struct http_channel *c)
     {
         if (!strcmp(block, "preferred") && !session_is_preferred_clients_ready(s->psession) && reclist_get_num_records(s->psession->reclist) == 0)
         {
-            // if there is already a watch/block. we do not block this one
-            if (session_set_watch(s->psession, SESSION_WATCH_SHOW_PREF,
-                                  show_records_ready, c, c) == 0)
-            {
-                yaz_log(c->http_sessions->log_level,
-                        "Session %u: Blocking on command show (preferred targets)", s->session_id);
-                release_session(c, s);
-                return;
-            }
-            else
-            {
-                yaz_log(YLOG_WARN, "Session %u: Attempt to block multiple times on show (preferred targets) block. Not supported!",
-                    s->session_id);
-                if (report_error) {
-                    error(rs, PAZPAR2_ALREADY_BLOCKED, "show (preferred targets)");
-                    release_session(c, s);
-                    return;
-                }
-                else {
-                    yaz_log(YLOG_WARN, "Session %u: Ignoring show(preferred) block. Returning current result.", s->session_id);
-                }
-            }
-
+            session_set_watch(s->psession, SESSION_WATCH_SHOW_PREF,
+                              show_records_ready, c, c, 0, 0);
+            yaz_log(c->http_sessions->log_level,
+                    "Session %u: Blocking on command show (preferred targets)", s->session_id);
+            release_session(c, s);
+            return;
         }
         else if (status)
         {
-            // if there is already a watch/block. we do not block this one
-            if (session_set_watch(s->psession, SESSION_WATCH_SHOW,
-                                  show_records_ready, c, c) != 0)
-            {
-                yaz_log(YLOG_WARN, "Session %u: Attempt to block multiple times on show block. Not supported!", s->session_id);
-                if (report_error) {
-                    error(rs, PAZPAR2_ALREADY_BLOCKED, "show");
-                    release_session(c, s);
-                    return;
-                }
-                else {
-                    yaz_log(YLOG_WARN, "Session %u: Ignoring show block. Returning current result.", s->session_id);
-                }
-            }
-            else
-            {
-                yaz_log(c->http_sessions->log_level, "Session %u: Blocking on command show", s->session_id);
-                release_session(c, s);
-                return;
-            }
+            int min_records, window_ms;
+
+            /* any other value blocks; thresholds are optional */
+            parse_block(block, service, &min_records, &window_ms);
+            session_set_watch(s->psession, SESSION_WATCH_SHOW,
+                              show_records_ready, c, c,
+                              min_records, window_ms);
+            yaz_log(c->http_sessions->log_level, "Session %u: Blocking on command show", s->session_id);
+            release_session(c, s);
+            return;
         }
     }
     show_records(c, s, status);
@@ -1414,41 +1590,503 @@ static void cmd_search(struct http_channel *c)
 }
 
 
-static void cmd_stat(struct http_channel *c)
+/* writes content of stat element */
+static void write_stat(WRBUF w, struct session *se, int clients)
 {
-    struct http_session *s = locate_session(c);
     struct statistics stat;
-    int clients;
-
     float progress = 0;
 
-    if (!s)
-        return;
-
-    clients = session_active_clients(s->psession);
-    statistics(s->psession, &stat);
+    statistics(se, &stat);
 
     if (stat.num_clients > 0)
     {
         progress = (stat.num_clients  - clients) / (float)stat.num_clients;
     }
 
+    wrbuf_printf(w, "\n <activeclients>%d</activeclients>\n", clients);
+    wrbuf_printf(w, " <hits>" ODR_INT_PRINTF "</hits>\n", stat.num_hits);
+    wrbuf_printf(w, " <records>%d</records>\n", stat.num_records);
+    wrbuf_printf(w, " <clients>%d</clients>\n", stat.num_clients);
+    wrbuf_printf(w, " <unconnected>%d</unconnected>\n", stat.num_no_connection);
+    wrbuf_printf(w, " <connecting>%d</connecting>\n", stat.num_connecting);
+    wrbuf_printf(w, " <working>%d</working>\n", stat.num_working);
+    wrbuf_printf(w, " <idle>%d</idle>\n", stat.num_idle);
+    wrbuf_printf(w, " <failed>%d</failed>\n", stat.num_failed);
+    wrbuf_printf(w, " <error>%d</error>\n", stat.num_error);
+    wrbuf_printf(w, " <progress>%.2f</progress>\n", progress);
+}
+
+static void cmd_stat(struct http_channel *c)
+{
+    struct http_session *s = locate_session(c);
+    int clients;
+
+    if (!s)
+        return;
+    if (response_not_modified(c, s, 1 << SESSION_GEN_CLIENTS))
+    {
+        release_session(c, s);
+        return;
+    }
+
+    clients = session_active_clients(s->psession);
+
     response_open_no_status(c, "stat");
-    wrbuf_printf(c->wrbuf, "\n <activeclients>%d</activeclients>\n", clients);
-    wrbuf_printf(c->wrbuf, " <hits>" ODR_INT_PRINTF "</hits>\n", stat.num_hits);
-    wrbuf_printf(c->wrbuf, " <records>%d</records>\n", stat.num_records);
-    wrbuf_printf(c->wrbuf, " <clients>%d</clients>\n", stat.num_clients);
-    wrbuf_printf(c->wrbuf, " <unconnected>%d</unconnected>\n", stat.num_no_connection);
-    wrbuf_printf(c->wrbuf, " <connecting>%d</connecting>\n", stat.num_connecting);
-    wrbuf_printf(c->wrbuf, " <working>%d</working>\n", stat.num_working);
-    wrbuf_printf(c->wrbuf, " <idle>%d</idle>\n", stat.num_idle);
-    wrbuf_printf(c->wrbuf, " <failed>%d</failed>\n", stat.num_failed);
-    wrbuf_printf(c->wrbuf, " <error>%d</error>\n", stat.num_error);
-    wrbuf_printf(c->wrbuf, " <progress>%.2f</progress>\n", progress);
+    write_stat(c->wrbuf, s->psession, clients);
     response_close(c, "stat");
     release_session(c, s);
 }
 
+/* item last sent by a stream; key is recid, target id or termlist name */
+struct stream_item {
+    char *key;
+    char *value;
+    struct stream_item *next;
+};
+
+/* state of stream command. Lives as long as its HTTP channel or an
+   update in progress, whichever is longer */
+struct http_stream {
+    unsigned id;             /* watches refer to stream by id */
+    int refcount;            /* protected by streams_mutex */
+    struct http_stream *next;
+    struct http_channel *c;
+    struct http_session *s;  /* held until stream ends */
+    YAZ_MUTEX mutex;
+    int finished;            /* ended or channel gone */
+    WRBUF events;
+    WRBUF value;
+    WRBUF stat;              /* stat last sent */
+    int num;                 /* hits in window last sent */
+    NMEM nmem;               /* items last sent */
+    struct stream_item *hits;
+    struct stream_item *targets;
+    struct stream_item *termlists;
+};
+
+/* live streams. A watch may fire after the channel of its stream is
+   gone, so watches hold an id which is looked up here */
+static YAZ_MUTEX streams_mutex = 0;
+static struct http_stream *streams = 0;
+static unsigned streams_id = 0;
+
+static void stream_release(struct http_stream *st)
+{
+    int refcount;
+
+    yaz_mutex_enter(streams_mutex);
+    refcount = --st->refcount;
+    yaz_mutex_leave(streams_mutex);
+    if (refcount == 0)
+    {
+        wrbuf_destroy(st->events);
+        wrbuf_destroy(st->value);
+        wrbuf_destroy(st->stat);
+        nmem_destroy(st->nmem);
+        yaz_mutex_destroy(&st->mutex);
+        xfree(st);
+    }
+}
+
+/* writes server-sent event; each line of data is a data field */
+static void stream_event(WRBUF w, const char *event, const char *data)
+{
+    wrbuf_printf(w, "event: %s\n", event);
+    while (*data)
+    {
+        const char *nl = strchr(data, '\n');
+        size_t len = nl ? nl - data : strlen(data);
+
+        wrbuf_puts(w, "data: ");
+        wrbuf_write(w, data, len);
+        wrbuf_putc(w, '\n');
+        data += len;
+        if (nl)
+            data++;
+    }
+    wrbuf_putc(w, '\n');
+}
+
+/* adds item to list; returns 1 if value differs from the one in old */
+static int stream_item_add(NMEM nmem, struct stream_item **list,
+                           struct stream_item *old,
+                           const char *key, const char *value)
+{
+    struct stream_item *item = nmem_malloc(nmem, sizeof(*item));
+
+    item->key = nmem_strdup(nmem, key);
+    item->value = nmem_strdup(nmem, value);
+    item->next = *list;
+    *list = item;
+    for (; old; old = old->next)
+        if (!strcmp(old->key, key))
+            return strcmp(old->value, value) ? 1 : 0;
+    return 1;
+}
+
+static void stream_ready(void *data);
+
+/* item of old list with key; 0 if none */
+static struct stream_item *stream_item_find(struct stream_item *old,
+                                            const char *key)
+{
+    for (; old; old = old->next)
+        if (!strcmp(old->key, key))
+            return old;
+    return 0;
+}
+
+/* ends list of termlist output: adds terms that left it with frequency
+   0 and sends the terms that changed as event termlist */
+static void stream_termlist_end(struct http_stream *st, NMEM nmem,
+                                struct stream_item **items,
+                                const char *list, WRBUF block, WRBUF delta)
+{
+    size_t list_len = strlen(list);
+    struct stream_item *old;
+
+    if (wrbuf_len(block) &&
+        stream_item_add(nmem, items, st->termlists, list, wrbuf_cstr(block)))
+        wrbuf_puts(delta, wrbuf_cstr(block));
+    for (old = st->termlists; old; old = old->next)
+        if (!strncmp(old->key, list, list_len) && old->key[list_len] == '\n'
+            && !stream_item_find(*items, old->key))
+            wrbuf_printf(delta, "%s<frequency>0</frequency></term>\n",
+                         old->key + list_len + 1);
+    if (wrbuf_len(delta))
+    {
+        wrbuf_rewind(st->value);
+        wrbuf_printf(st->value, "<termlist>\n%s\n%s</list>\n</termlist>",
+                     list, wrbuf_cstr(delta));
+        stream_event(st->events, "termlist", wrbuf_cstr(st->value));
+    }
+    wrbuf_rewind(block);
+    wrbuf_rewind(delta);
+}
+
+/* sends terms of termlist that changed since last update.
+   perform_termlist writes a line per term, keyed here by list and name.
+   Terms of xtargets span lines; such a list is compared as a whole */
+static void stream_termlist(struct http_stream *st, NMEM nmem,
+                            struct stream_item **items,
+                            const char *name, int num, int version)
+{
+    struct http_channel *c = st->c;
+    WRBUF block = wrbuf_alloc();
+    WRBUF delta = wrbuf_alloc();
+    WRBUF key = wrbuf_alloc();
+    char *list = 0;  /* open tag of current list */
+    char *cp;
+
+    wrbuf_rewind(c->wrbuf);
+    perform_termlist(c, st->s->psession, name, num, version);
+    cp = nmem_strdup(nmem, wrbuf_cstr(c->wrbuf));
+    while (*cp)
+    {
+        char *line = cp;
+        char *nl = strchr(cp, '\n');
+        char *freq;
+        size_t len;
+
+        if (nl)
+        {
+            *nl = '\0';
+            cp = nl + 1;
+        }
+        else
+            cp += strlen(cp);
+        len = strlen(line);
+        if (!strncmp(line, "<list name=\"", 12))
+        {
+            list = line;
+            if (len >= 2 && !strcmp(line + len - 2, "/>"))
+            {
+                /* empty list */
+                strcpy(line + len - 2, ">");
+                stream_termlist_end(st, nmem, items, list, block, delta);
+                list = 0;
+            }
+        }
+        else if (!list)
+            ;
+        else if (!strcmp(line, "</list>"))
+        {
+            stream_termlist_end(st, nmem, items, list, block, delta);
+            list = 0;
+        }
+        else if (!strncmp(line, "<term><name>", 12)
+                 && (freq = strstr(line, "<frequency>")))
+        {
+            wrbuf_rewind(key);
+            wrbuf_printf(key, "%s\n", list);
+            wrbuf_write(key, line, freq - line);
+            if (stream_item_add(nmem, items, st->termlists,
+                                wrbuf_cstr(key), line))
+                wrbuf_printf(delta, "%s\n", line);
+        }
+        else
+            wrbuf_printf(block, "%s\n", line);
+    }
+    wrbuf_destroy(key);
+    wrbuf_destroy(delta);
+    wrbuf_destroy(block);
+}
+
+/* sends events for what changed since last update.
+   Returns number of active clients */
+static int stream_update(struct http_stream *st)
+{
+    struct http_channel *c = st->c;
+    struct http_request *rq = c->request;
+    struct session *se = st->s->psession;
+    struct conf_service *service = se->service;
+    const char *start = http_argbyname(rq, "start");
+    const char *num = http_argbyname(rq, "num");
+    const char *sort = http_argbyname(rq, "sort");
+    const char *termlist = http_argbyname(rq, "termlist");
+    const char *termnum = http_argbyname(rq, "termnum");
+    int version = get_version(rq);
+    NMEM nmem = nmem_create();
+    struct stream_item *hits = 0, *targets = 0, *termlists = 0;
+    struct record_cluster **rl;
+    struct reclist_sortparms *sp;
+    struct hitsbytarget *ht;
+    int startn = start ? atoi(start) : 0;
+    int numn = num ? atoi(num) : 20;
+    int num_terms = termnum ? atoi(termnum) : 15;
+    int total, count, changed, i;
+    Odr_int total_hits, approx_hits;
+    int active = session_active_clients(se);
+
+    wrbuf_rewind(st->events);
+
+    wrbuf_rewind(st->value);
+    write_stat(st->value, se, active);
+    if (strcmp(wrbuf_cstr(st->value), wrbuf_cstr(st->stat)))
+    {
+        wrbuf_rewind(st->stat);
+        wrbuf_puts(st->stat, wrbuf_cstr(st->value));
+        wrbuf_rewind(st->value);
+        wrbuf_printf(st->value, "<stat>%s</stat>", wrbuf_cstr(st->stat));
+        stream_event(st->events, "stat", wrbuf_cstr(st->value));
+    }
+
+    /* hits are compared by position in window */
+    if (!sort)
+        sort = service->default_sort;
+    sp = reclist_parse_sortparms(nmem, sort, service);
+    rl = show_range_start(se, nmem, sp, startn, &numn, &total,
+                          &total_hits, &approx_hits);
+    wrbuf_rewind(c->wrbuf);
+    changed = numn != st->num;
+    for (i = 0; i < numn; i++)
+    {
+        char key[20];
+
+        sprintf(key, "%d", startn + i);
+        wrbuf_rewind(st->value);
+        write_hit(st->value, service, rl[i], sort);
+        if (stream_item_add(nmem, &hits, st->hits, key,
+                            wrbuf_cstr(st->value)))
+        {
+            wrbuf_printf(c->wrbuf, "<hit position=\"%s\">\n%s</hit>\n",
+                         key, wrbuf_cstr(st->value));
+            changed = 1;
+        }
+    }
+    show_range_stop(se, rl);
+    if (changed)
+    {
+        wrbuf_rewind(st->value);
+        wrbuf_printf(st->value, "<show>\n<activeclients>%d</activeclients>\n",
+                     active);
+        wrbuf_printf(st->value, "<merged>%d</merged>\n", total);
+        wrbuf_printf(st->value, "<total>" ODR_INT_PRINTF "</total>\n",
+                     total_hits);
+        if (version >= 2)
+            wrbuf_printf(st->value, "<approximation>" ODR_INT_PRINTF
+                         "</approximation>\n", approx_hits);
+        wrbuf_printf(st->value, "<start>%d</start>\n", startn);
+        wrbuf_printf(st->value, "<num>%d</num>\n", numn);
+        wrbuf_printf(st->value, "%s</show>", wrbuf_cstr(c->wrbuf));
+        stream_event(st->events, "show", wrbuf_cstr(st->value));
+    }
+    st->num = numn;
+
+    ht = get_hitsbytarget(se, 0, &count, nmem);
+    wrbuf_rewind(c->wrbuf);
+    for (i = 0; i < count; i++)
+    {
+        wrbuf_rewind(st->value);
+        write_target(st->value, ht + i, version, 0);
+        if (stream_item_add(nmem, &targets, st->targets, ht[i].id,
+                            wrbuf_cstr(st->value)))
+            wrbuf_printf(c->wrbuf, "<target>%s</target>\n",
+                         wrbuf_cstr(st->value));
+    }
+    if (wrbuf_len(c->wrbuf))
+    {
+        wrbuf_rewind(st->value);
+        wrbuf_printf(st->value, "<bytarget>\n%s</bytarget>",
+                     wrbuf_cstr(c->wrbuf));
+        stream_event(st->events, "bytarget", wrbuf_cstr(st->value));
+    }
+
+    if (termlist)
+    {
+        char **names;
+        int num_names;
+
+        nmem_strsplit(nmem, ",", termlist, &names, &num_names);
+        for (i = 0; i < num_names; i++)
+            stream_termlist(st, nmem, &termlists, names[i], num_terms,
+                            version);
+    }
+
+    nmem_destroy(st->nmem);
+    st->nmem = nmem;
+    st->hits = hits;
+    st->targets = targets;
+    st->termlists = termlists;
+    return active;
+}
+
+/* updates stream; ends it when no clients are active */
+static void stream_run(struct http_stream *st)
+{
+    const char *block = http_argbyname(st->c->request, "block");
+    struct conf_service *service;
+    int min_records, window_ms;
+    int last;
+
+    yaz_mutex_enter(st->mutex);
+    if (st->finished)
+    {
+        yaz_mutex_leave(st->mutex);
+        return;
+    }
+    iochan_activity(st->s->timeout_iochan);
+    service = st->s->psession->service;
+    /* records are coalesced into updates like blocking show */
+    if (!parse_block(block, service, &min_records, &window_ms))
+    {
+        min_records = service->block_records;
+        window_ms = service->block_window;
+    }
+    /* watch is set before looking, so no alert can be missed */
+    session_set_watch(st->s->psession, SESSION_WATCH_SHOW, stream_ready,
+                      (void *) (size_t) st->id, st->c,
+                      min_records, window_ms);
+    last = stream_update(st) == 0;
+    if (last)
+    {
+        stream_event(st->events, "end", "");
+        st->finished = 1;
+        release_session(st->c, st->s);
+        st->s = 0;
+    }
+    if (wrbuf_len(st->events))
+        http_send_stream(st->c, wrbuf_buf(st->events),
+                         wrbuf_len(st->events), last);
+    yaz_mutex_leave(st->mutex);
+}
+
+static void stream_ready(void *data)
+{
+    unsigned id = (unsigned) (size_t) data;
+    struct http_stream *st;
+
+    yaz_mutex_enter(streams_mutex);
+    for (st = streams; st; st = st->next)
+        if (st->id == id)
+        {
+            st->refcount++;
+            break;
+        }
+    yaz_mutex_leave(streams_mutex);
+    if (st)
+    {
+        stream_run(st);
+        stream_release(st);
+    }
+}
+
+/* HTTP channel of stream is gone */
+static void stream_destroy(void *data, struct http_channel *c, void *data2)
+{
+    struct http_stream *st = data;
+    struct http_stream **sp;
+
+    /* no watch reaches the stream from now on */
+    yaz_mutex_enter(streams_mutex);
+    for (sp = &streams; *sp; sp = &(*sp)->next)
+        if (*sp == st)
+        {
+            *sp = st->next;
+            break;
+        }
+    yaz_mutex_leave(streams_mutex);
+
+    /* waits for an update in progress; later ones do nothing */
+    yaz_mutex_enter(st->mutex);
+    st->finished = 1;
+    if (st->s)
+        release_session(c, st->s);
+    st->s = 0;
+    yaz_mutex_leave(st->mutex);
+    stream_release(st);
+}
+
+static void cmd_stream(struct http_channel *c)
+{
+    struct http_request *rq = c->request;
+    struct http_session *s = locate_session(c);
+    const char *sort = http_argbyname(rq, "sort");
+    struct reclist_sortparms *sp;
+    struct http_stream *st;
+
+    if (!s)
+        return;
+    if (!sort)
+        sort = s->psession->service->default_sort;
+    if (!(sp = reclist_parse_sortparms(c->nmem, sort, s->psession->service)))
+    {
+        error(c->response, PAZPAR2_MALFORMED_PARAMETER_VALUE, "sort");
+        release_session(c, s);
+        return;
+    }
+    session_sort(s->psession, sp);
+
+    st = xmalloc(sizeof(*st));
+    st->refcount = 1; /* released when channel is gone */
+    st->c = c;
+    st->s = s;
+    st->mutex = 0;
+    pazpar2_mutex_create(&st->mutex, "http_stream");
+    st->finished = 0;
+    st->events = wrbuf_alloc();
+    st->value = wrbuf_alloc();
+    st->stat = wrbuf_alloc();
+    st->num = 0;
+    st->nmem = nmem_create();
+    st->hits = st->targets = st->termlists = 0;
+    http_add_observer(c, st, stream_destroy);
+
+    if (!streams_mutex)
+        pazpar2_mutex_create(&streams_mutex, "http_streams");
+    yaz_mutex_enter(streams_mutex);
+    st->id = ++streams_id;
+    st->next = streams;
+    streams = st;
+    yaz_mutex_leave(streams_mutex);
+
+    yaz_log(c->http_sessions->log_level, "Session %u: Streaming",
+            s->session_id);
+    http_addheader(c->response, "Content-Type", "text/event-stream");
+    http_send_stream_head(c);
+    stream_run(st);
+}
+
 static void cmd_info(struct http_channel *c)
 {
     char yaz_version_str[20];
@@ -1508,6 +2146,7 @@ struct {
     { "record", cmd_record },
     { "info", cmd_info },
     { "ingested", cmd_ingested },
+    { "stream", cmd_stream },
     {0,0}
 };
 
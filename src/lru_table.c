@@ -0,0 +1,162 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file lru_table.c
+    \brief Hash table with LRU list, shared by the server-wide caches
+
+    Nodes are embedded in the cached structures, which are owned and
+    freed by the caches. A table only links them.
+*/
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <yaz/xmalloc.h>
+
+#include "lru_table.h"
+
+#define LRU_TABLE_BUCKETS 1024
+
+struct lru_table {
+    struct lru_node *buckets[LRU_TABLE_BUCKETS];
+    struct lru_node *head;
+    struct lru_node *tail;
+    int num;
+};
+
+lru_table_t lru_table_create(void)
+{
+    lru_table_t t = xmalloc(sizeof(*t));
+    memset(t, 0, sizeof(*t));
+    return t;
+}
+
+/** \brief frees table; nodes still in it are not touched */
+void lru_table_destroy(lru_table_t t)
+{
+    xfree(t);
+}
+
+/** \brief first node of the bucket chain (hnext) for hash */
+struct lru_node *lru_table_bucket(lru_table_t t, unsigned hash)
+{
+    return t->buckets[hash % LRU_TABLE_BUCKETS];
+}
+
+/** \brief finds node by key; LRU order is not changed */
+struct lru_node *lru_table_find(lru_table_t t, unsigned hash,
+                                const char *key)
+{
+    struct lru_node *n = t->buckets[hash % LRU_TABLE_BUCKETS];
+
+    for (; n; n = n->hnext)
+        if (n->hash == hash && !strcmp(n->key, key))
+            break;
+    return n;
+}
+
+static void lru_unlink(lru_table_t t, struct lru_node *n)
+{
+    if (n->prev)
+        n->prev->next = n->next;
+    else
+        t->head = n->next;
+    if (n->next)
+        n->next->prev = n->prev;
+    else
+        t->tail = n->prev;
+}
+
+static void lru_push_front(lru_table_t t, struct lru_node *n)
+{
+    n->prev = 0;
+    n->next = t->head;
+    if (t->head)
+        t->head->prev = n;
+    else
+        t->tail = n;
+    t->head = n;
+}
+
+/** \brief makes node the most recently used */
+void lru_table_touch(lru_table_t t, struct lru_node *n)
+{
+    if (n != t->head)
+    {
+        lru_unlink(t, n);
+        lru_push_front(t, n);
+    }
+}
+
+/** \brief adds node as most recently used; key and hash must be set */
+void lru_table_insert(lru_table_t t, struct lru_node *n)
+{
+    struct lru_node **np = &t->buckets[n->hash % LRU_TABLE_BUCKETS];
+
+    n->hnext = *np;
+    *np = n;
+    lru_push_front(t, n);
+    t->num++;
+}
+
+/** \brief removes node; its links may be reused by the owner after */
+void lru_table_remove(lru_table_t t, struct lru_node *n)
+{
+    struct lru_node **np = &t->buckets[n->hash % LRU_TABLE_BUCKETS];
+
+    for (; *np; np = &(*np)->hnext)
+        if (*np == n)
+        {
+            *np = n->hnext;
+            break;
+        }
+    lru_unlink(t, n);
+    t->num--;
+}
+
+/** \brief most recently used node; follow next for older ones */
+struct lru_node *lru_table_head(lru_table_t t)
+{
+    return t->head;
+}
+
+/** \brief least recently used node */
+struct lru_node *lru_table_tail(lru_table_t t)
+{
+    return t->tail;
+}
+
+int lru_table_num(lru_table_t t)
+{
+    return t->num;
+}
+
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -0,0 +1,64 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file lru_table.h
+    \brief Hash table with LRU list, shared by the server-wide caches
+*/
+
+#ifndef LRU_TABLE_H
+#define LRU_TABLE_H
+
+/** \brief node of a table; first member of the cached structure.
+    key and hash are set by the owner before insert */
+struct lru_node {
+    const char *key;
+    unsigned hash;
+    struct lru_node *hnext;  /* hash bucket chain */
+    struct lru_node *prev;   /* LRU list, head is most recent */
+    struct lru_node *next;
+};
+
+/** \brief table; not thread safe, owners hold their own lock */
+typedef struct lru_table *lru_table_t;
+
+lru_table_t lru_table_create(void);
+void lru_table_destroy(lru_table_t t);
+
+struct lru_node *lru_table_find(lru_table_t t, unsigned hash,
+                                const char *key);
+struct lru_node *lru_table_bucket(lru_table_t t, unsigned hash);
+void lru_table_touch(lru_table_t t, struct lru_node *n);
+void lru_table_insert(lru_table_t t, struct lru_node *n);
+void lru_table_remove(lru_table_t t, struct lru_node *n);
+
+struct lru_node *lru_table_head(lru_table_t t);
+struct lru_node *lru_table_tail(lru_table_t t);
+int lru_table_num(lru_table_t t);
+
+#endif
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -18,7 +18,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
 /** \file
-    \brief MARC MAP utilities (hash lookup etc)
+    \brief MARC MAP utilities (tag indexed lookup etc)
 */
 
 #if HAVE_CONFIG_H
@@ -36,8 +36,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <libxml/tree.h>
 #include <libxml/parser.h>
 #include <yaz/nmem.h>
+#include <yaz/wrbuf.h>
 
-#include "jenkins_hash.h"
 #include "marchash.h"
 
 static inline void strtrimcat(char *dest, const char *src)
@@ -81,98 +81,151 @@ struct marchash *marchash_create(NMEM nmem)
     return new;
 }
 
+/* slot of tag: the tag itself if numeric */
+static inline int marchash_slot(const char *key)
+{
+    if (key[0] >= '0' && key[0] <= '9' &&
+        key[1] >= '0' && key[1] <= '9' &&
+        key[2] >= '0' && key[2] <= '9' && key[3] == '\0')
+        return (key[0] - '0') * 100 + (key[1] - '0') * 10 + key[2] - '0';
+    return MARCHASH_TAGS;
+}
+
+/* text of node; not copied if it is a single text node */
+static const char *node_text(xmlNodePtr node, xmlChar **buf)
+{
+    *buf = 0;
+    if (!node->children)
+        return "";
+    if (node->children->type == XML_TEXT_NODE && !node->children->next)
+        return (const char *) node->children->content;
+    *buf = xmlNodeGetContent(node);
+    return *buf ? (const char *) *buf : "";
+}
+
+/* value of attribute; not copied */
+static const char *attr_text(xmlNodePtr node, const char *name)
+{
+    xmlAttrPtr attr = xmlHasProp(node, BAD_CAST name);
+
+    if (!attr)
+        return 0;
+    if (!attr->children)
+        return "";
+    if (attr->children->type == XML_TEXT_NODE && !attr->children->next)
+        return (const char *) attr->children->content;
+    return 0;
+}
+
+static struct marcfield *marchash_new_field(struct marchash *marchash,
+                                            const char *key)
+{
+    int slot;
+    struct marcfield *new;
+    struct marcfield *first;
+
+    // only 3 char in a marc field name
+    if (strlen(key) != 3)
+        return 0;
+    slot = marchash_slot(key);
+    new = nmem_malloc(marchash->nmem, sizeof (struct marcfield));
+    new->next = NULL;
+    new->last = NULL;
+    new->subfields = NULL;
+    new->last_subfield = NULL;
+    new->codes = 0;
+    new->val = NULL;
+    strcpy(new->key, key);
+
+    first = marchash->table[slot];
+    if (first)
+        first->last->next = new;
+    else
+        first = marchash->table[slot] = new;
+    first->last = new;
+    return new;
+}
+
+static void marchash_set_val(struct marchash *marchash,
+                             struct marcfield *field, const char *val)
+{
+    field->val = nmem_malloc(marchash->nmem, sizeof (char) * strlen(val) + 1);
+    strtrimcpy(field->val, val);
+}
+
 void marchash_ingest_marcxml(struct marchash *marchash, xmlNodePtr rec_node)
 {
      xmlNodePtr field_node;
      xmlNodePtr sub_node;
      struct marcfield *field;
-     field_node = rec_node->children;
+     WRBUF content = 0;
 
-     while (field_node)
+     for (field_node = rec_node->children; field_node;
+          field_node = field_node->next)
      {
-         if (field_node->type == XML_ELEMENT_NODE)
+         const char *tag;
+         const char *text;
+         xmlChar *buf;
+
+         if (field_node->type != XML_ELEMENT_NODE)
+             continue;
+         if (!strcmp((const char *) field_node->name, "controlfield"))
          {
-             field = NULL;
-             if (!strcmp((const char *) field_node->name, "controlfield"))
+             if ((tag = attr_text(field_node, "tag")) &&
+                 (field = marchash_new_field(marchash, tag)))
              {
-                 xmlChar *content = xmlNodeGetContent(field_node);
-                 xmlChar *tag = xmlGetProp(field_node, BAD_CAST "tag");
-                 if (tag && content)
-                     field = marchash_add_field(
-                         marchash, (const char *) tag, (const char *) content);
-                 xmlFree(content);
-                 xmlFree(tag);
+                 text = node_text(field_node, &buf);
+                 marchash_set_val(marchash, field, text);
+                 xmlFree(buf);
              }
-             else if (!strcmp((const char *) field_node->name, "datafield"))
-             {
-                 xmlChar *content = xmlNodeGetContent(field_node);
-                 xmlChar *tag = xmlGetProp(field_node, BAD_CAST "tag");
-                 if (tag && content)
-                     field = marchash_add_field(
-                         marchash, (const char *) tag, (const char *) content);
-                 xmlFree(content);
-                 xmlFree(tag);
-             }
-             if (field)
+         }
+         else if (!strcmp((const char *) field_node->name, "datafield"))
+         {
+             if (!(tag = attr_text(field_node, "tag")) ||
+                 !(field = marchash_new_field(marchash, tag)))
+                 continue;
+             /* field value is content of field: one pass, no copies */
+             if (!content)
+                 content = wrbuf_alloc();
+             wrbuf_rewind(content);
+             for (sub_node = field_node->children; sub_node;
+                  sub_node = sub_node->next)
              {
-                 sub_node = field_node->children;
-                 while (sub_node)
+                 if (sub_node->type == XML_TEXT_NODE ||
+                     sub_node->type == XML_CDATA_SECTION_NODE)
+                 {
+                     wrbuf_puts(content, (const char *) sub_node->content);
+                 }
+                 else if (sub_node->type == XML_ELEMENT_NODE ||
+                          sub_node->type == XML_ENTITY_REF_NODE)
                  {
-                     if ((sub_node->type == XML_ELEMENT_NODE) &&
+                     text = node_text(sub_node, &buf);
+                     wrbuf_puts(content, text);
+                     if (sub_node->type == XML_ELEMENT_NODE &&
                          !strcmp((const char *) sub_node->name, "subfield"))
                      {
-                         xmlChar *content = xmlNodeGetContent(sub_node);
-                         xmlChar *code = xmlGetProp(sub_node, BAD_CAST "code");
-                         if (code && content)
-                             marchash_add_subfield(
-                                 marchash, field,
-                                 code[0], (const char *) content);
-                         xmlFree(content);
-                         xmlFree(code);
+                         const char *code = attr_text(sub_node, "code");
+                         if (code)
+                             marchash_add_subfield(marchash, field,
+                                                   code[0], text);
                      }
-                     sub_node = sub_node->next;
+                     xmlFree(buf);
                  }
              }
+             marchash_set_val(marchash, field, wrbuf_cstr(content));
          }
-         field_node = field_node->next;
      }
+     if (content)
+         wrbuf_destroy(content);
 }
 
 struct marcfield *marchash_add_field(struct marchash *marchash,
                                      const char *key, const char *val)
 {
-    int slot;
-    struct marcfield *new;
-    struct marcfield *last;
-
-    slot = jenkins_hash((const unsigned char *) key) & MARCHASH_MASK;
-    new = marchash->table[slot];
-    last = NULL;
-
-    while (new)
-    {
-        last = new;
-        new = new->next;
-    }
-
-    new = nmem_malloc(marchash->nmem, sizeof (struct marcfield));
-
-    if (last)
-        last->next = new;
-    else
-        marchash->table[slot] = new;
-
-    new->next = NULL;
-    new->subfields = NULL;
-    strncpy(new->key, key, 4);
-
-    // only 3 char in a marc field name
-    if (new->key[3] != '\0')
-        return 0;
-
-    new->val = nmem_malloc(marchash->nmem, sizeof (char) * strlen(val) + 1);
-    strtrimcpy(new->val, val);
+    struct marcfield *new = marchash_new_field(marchash, key);
 
+    if (new)
+        marchash_set_val(marchash, new, val);
     return new;
 }
 
@@ -181,27 +234,18 @@ struct marcsubfield *marchash_add_subfield(struct marchash *marchash,
                                            const char key, const char *val)
 {
     struct marcsubfield *new;
-    struct marcsubfield *last;
-    last = NULL;
-    new = field->subfields;
-
-    while (new)
-    {
-        last = new;
-        new = new->next;
-    }
 
     new = nmem_malloc(marchash->nmem, sizeof (struct marcsubfield));
-
-    if (last)
-        last->next = new;
+    if (field->last_subfield)
+        field->last_subfield->next = new;
     else
         field->subfields = new;
+    field->last_subfield = new;
+    field->codes |= MARCHASH_CODE_BIT(key);
 
     new->next = NULL;
     new->key = key;
-    new->val = nmem_malloc(marchash->nmem, sizeof (char) * strlen(val) + 1);
-    strcpy(new->val, val);
+    new->val = nmem_strdup(marchash->nmem, val);
     return new;
 }
 
@@ -212,7 +256,7 @@ struct marcfield *marchash_get_field (struct marchash *marchash,
     if (last)
         cur = last->next;
     else
-        cur = marchash->table[jenkins_hash((const unsigned char *)key) & MARCHASH_MASK];
+        cur = marchash->table[marchash_slot(key)];
     while (cur)
     {
         if (!strcmp(cur->key, key))
@@ -229,6 +273,8 @@ struct marcsubfield *marchash_get_subfield(char key,
     struct marcsubfield *cur;
     if (last)
         cur = last->next;
+    else if (!(field->codes & MARCHASH_CODE_BIT(key)))
+        return NULL;
     else
         cur = field->subfields;
     while (cur)
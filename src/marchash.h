@@ -20,11 +20,15 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #ifndef MARCHASH_H
 #define MARCHASH_H
 
-#define MARCHASH_MASK 127
+/* numeric tags are direct indexed; others share the last slot */
+#define MARCHASH_TAGS 1000
+
+/* bit in marcfield.codes for subfield code */
+#define MARCHASH_CODE_BIT(c) (1U << ((unsigned char) (c) & 31))
 
 struct marchash
 {
-    struct marcfield *table[MARCHASH_MASK + 1];
+    struct marcfield *table[MARCHASH_TAGS + 1];
     NMEM nmem;
 };
 
@@ -32,8 +36,11 @@ struct marcfield
 {
    char key[4];
    char *val;
+   unsigned codes;                      /* MARCHASH_CODE_BIT of subfields */
    struct marcsubfield *subfields;
-   struct marcfield *next;
+   struct marcsubfield *last_subfield;
+   struct marcfield *next;              /* next field in slot */
+   struct marcfield *last;              /* last field in slot (first only) */
 };
 
 struct marcsubfield
@@ -54,6 +54,8 @@ struct marcmap *marcmap_load(const char *filename, NMEM nmem)
     mm = NULL;
     mmhead = NULL;
     fp = fopen(filename, "r");
+    if (!fp)
+        return 0;
 
     while ((c = getc(fp) ) != EOF)
     {
@@ -70,6 +72,7 @@ struct marcmap *marcmap_load(const char *filename, NMEM nmem)
             { mm = nmem_malloc(nmem, sizeof(struct marcmap));
                 mmhead = mm;
             }
+            memset(mm, 0, sizeof(*mm));
             newrec = 0;
         }
 	// whitespace saves and moves on
@@ -117,7 +120,9 @@ struct marcmap *marcmap_load(const char *filename, NMEM nmem)
             len++;
         }
     }
-    mm->next = NULL;
+    fclose(fp);
+    if (mm)
+        mm->next = NULL;
     return mmhead;
 }
 
@@ -152,7 +157,7 @@ xmlDoc *marcmap_apply(struct marcmap *marcmap, xmlDoc *xml_in)
     while (mmcur != NULL)
     {
         field = 0;
-        while ((field = marchash_get_field(marchash, mmcur->field, field)) != 0)
+        while (mmcur->field && (field = marchash_get_field(marchash, mmcur->field, field)) != 0)
         {
             // field value
             if ((mmcur->subfield == '$') && (s = field->val))
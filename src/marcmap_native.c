@@ -0,0 +1,512 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file
+    \brief MARC map applied to ISO2709 and TurboMARC records
+
+    The map is compiled to a table indexed by tag. A record is decoded
+    field by field and only fields that the map refers to are kept; no
+    MARCXML is produced or parsed. The result is the same pz:record that
+    marcmap_apply produces.
+*/
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <libxml/tree.h>
+#include <libxml/xmlreader.h>
+
+#include <yaz/yaz-util.h>
+
+#include "marcmap_native.h"
+
+#define ISO2709_IDFS 0x1f
+#define ISO2709_FS 0x1e
+#define ISO2709_RS 0x1d
+
+struct marcmap_rule {
+    int no;             /* position in map; output order */
+    char subfield;      /* '$': field value, '*': all subfields */
+    struct marcmap_rule *next;
+};
+
+struct marcmap_table {
+    int num_rules;
+    const char **pz;    /* metadata type for each rule */
+    struct marcmap_rule *tags[1000];
+};
+
+struct native_subfield {
+    char code;
+    const char *val;
+    struct native_subfield *next;
+};
+
+struct native_value {
+    const char *val;
+    struct native_value *next;
+};
+
+/* values collected while a record is decoded */
+struct native_record {
+    struct marcmap_table *t;
+    NMEM nmem;
+    struct native_value **values;  /* per rule, in record order */
+    struct native_value **last;
+    int seen_245, seen_900, seen_773;
+    const char *medium_245h;
+    int has_900ab;
+    int has_773t;
+};
+
+static int decimal(const char *p, int n)
+{
+    int v = 0;
+    for (; n > 0; n--, p++)
+    {
+        if (*p < '0' || *p > '9')
+            return -1;
+        v = v * 10 + *p - '0';
+    }
+    return v;
+}
+
+/** \brief compiles MARC map
+    \param marcmap map as loaded by marcmap_load
+    \param nmem memory for table
+    \returns table; NULL if the map has tags that are not numeric
+*/
+struct marcmap_table *marcmap_table_create(struct marcmap *marcmap,
+                                           NMEM nmem)
+{
+    struct marcmap_table *t = nmem_malloc(nmem, sizeof(*t));
+    struct marcmap *mm;
+    int no = 0;
+
+    memset(t->tags, 0, sizeof(t->tags));
+    for (mm = marcmap; mm; mm = mm->next)
+        no++;
+    t->num_rules = no;
+    t->pz = nmem_malloc(nmem, sizeof(*t->pz) * (no + 1));
+    for (no = 0, mm = marcmap; mm; mm = mm->next, no++)
+    {
+        struct marcmap_rule *rule;
+        int tag;
+
+        t->pz[no] = mm->pz;
+        if (!mm->field || !mm->pz)
+            continue; /* blank line */
+        tag = decimal(mm->field, 3);
+        if (tag < 0 || mm->field[3])
+            return 0;
+        rule = nmem_malloc(nmem, sizeof(*rule));
+        rule->no = no;
+        rule->subfield = mm->subfield;
+        rule->next = t->tags[tag];
+        t->tags[tag] = rule;
+    }
+    return t;
+}
+
+static int native_needed(struct native_record *r, int tag)
+{
+    return r->t->tags[tag] || tag == 245 || tag == 900 || tag == 773;
+}
+
+static void native_add(struct native_record *r, int no, const char *val)
+{
+    struct native_value *v = nmem_malloc(r->nmem, sizeof(*v));
+    v->val = val;
+    v->next = 0;
+    if (r->last[no])
+        r->last[no]->next = v;
+    else
+        r->values[no] = v;
+    r->last[no] = v;
+}
+
+/* trimmed values of subfields separated by blank */
+static const char *native_catenate(struct native_record *r,
+                                   struct native_subfield *s)
+{
+    WRBUF w = wrbuf_alloc();
+    const char *res;
+
+    for (; s; s = s->next)
+    {
+        const char *b = s->val;
+        const char *e = b + strlen(b);
+        while (*b && strchr(" \t\r\n", *b))
+            b++;
+        while (e > b && strchr(" \t\r\n", e[-1]))
+            e--;
+        wrbuf_write(w, b, e - b);
+        if (s->next)
+            wrbuf_puts(w, " ");
+    }
+    res = nmem_strdup(r->nmem, wrbuf_cstr(w));
+    wrbuf_destroy(w);
+    return res;
+}
+
+static struct native_subfield *native_subfield_find(
+    struct native_subfield *s, char code)
+{
+    for (; s; s = s->next)
+        if (s->code == code)
+            return s;
+    return 0;
+}
+
+/* applies rules of tag to field. value is 0 for a data field */
+static void native_field(struct native_record *r, int tag, const char *value,
+                         struct native_subfield *subfields)
+{
+    struct marcmap_rule *rule;
+    struct native_subfield *s;
+    const char *field_value = 0;
+
+    if (tag == 245 && !r->seen_245++)
+    {
+        if ((s = native_subfield_find(subfields, 'h')))
+            r->medium_245h = s->val;
+    }
+    else if (tag == 900 && !r->seen_900++)
+        r->has_900ab = native_subfield_find(subfields, 'a') ||
+            native_subfield_find(subfields, 'b');
+    else if (tag == 773 && !r->seen_773++)
+        r->has_773t = native_subfield_find(subfields, 't') != 0;
+
+    for (rule = r->t->tags[tag]; rule; rule = rule->next)
+    {
+        if (rule->subfield == '$')
+        {
+            if (!field_value)
+            {
+                struct native_subfield vs;
+                vs.val = value;
+                vs.next = 0;
+                field_value = native_catenate(r, value ? &vs : subfields);
+            }
+            native_add(r, rule->no, field_value);
+        }
+        else if (rule->subfield == '*')
+        {
+            if (subfields)
+                native_add(r, rule->no, native_catenate(r, subfields));
+        }
+        else
+        {
+            for (s = subfields; s; s = s->next)
+                if (s->code == rule->subfield)
+                    native_add(r, rule->no, s->val);
+        }
+    }
+}
+
+static void native_init(struct native_record *r, struct marcmap_table *t,
+                        NMEM nmem)
+{
+    int n = t->num_rules + 1;
+    r->t = t;
+    r->nmem = nmem;
+    r->values = nmem_malloc(nmem, sizeof(*r->values) * n);
+    r->last = nmem_malloc(nmem, sizeof(*r->last) * n);
+    memset(r->values, 0, sizeof(*r->values) * n);
+    memset(r->last, 0, sizeof(*r->last) * n);
+    r->seen_245 = r->seen_900 = r->seen_773 = 0;
+    r->medium_245h = 0;
+    r->has_900ab = 0;
+    r->has_773t = 0;
+}
+
+static xmlDoc *native_to_doc(struct native_record *r)
+{
+    xmlDoc *doc = xmlNewDoc(BAD_CAST "1.0");
+    xmlNode *root = xmlNewNode(0, BAD_CAST "record");
+    xmlNs *ns_pz;
+    xmlNode *n;
+    char medium[32];
+    int no;
+
+    doc->encoding = xmlCharStrdup("UTF-8");
+    xmlDocSetRootElement(doc, root);
+    ns_pz = xmlNewNs(root, BAD_CAST "http://www.indexdata.com/pazpar2/1.0",
+                     BAD_CAST "pz");
+    xmlSetNs(root, ns_pz);
+    for (no = 0; no < r->t->num_rules; no++)
+    {
+        struct native_value *v;
+        for (v = r->values[no]; v; v = v->next)
+        {
+            n = xmlNewTextChild(root, ns_pz, BAD_CAST "metadata",
+                                BAD_CAST v->val);
+            xmlSetProp(n, BAD_CAST "type", BAD_CAST r->t->pz[no]);
+        }
+    }
+    /* hard coded mappings as in marcmap_apply */
+    if (r->medium_245h)
+    {
+        strncpy(medium, r->medium_245h, sizeof(medium) - 1);
+        medium[sizeof(medium) - 1] = '\0';
+    }
+    else if (r->has_900ab)
+        strcpy(medium, "electronic resource");
+    else if (r->has_773t)
+        strcpy(medium, "article");
+    else
+        strcpy(medium, "book");
+    n = xmlNewTextChild(root, ns_pz, BAD_CAST "metadata", BAD_CAST medium);
+    xmlSetProp(n, BAD_CAST "type", BAD_CAST "medium");
+    return doc;
+}
+
+static const char *iso2709_value(NMEM nmem, const char *b, const char *e,
+                                 yaz_iconv_t cd, WRBUF w)
+{
+    if (!cd)
+        return nmem_strdupn(nmem, b, e - b);
+    wrbuf_rewind(w);
+    wrbuf_iconv_write(w, cd, b, e - b);
+    wrbuf_iconv_reset(w, cd);
+    return nmem_strdup(nmem, wrbuf_cstr(w));
+}
+
+static int iso2709_decode(struct native_record *r, const char *buf, size_t len,
+                          yaz_iconv_t cd)
+{
+    int record_len, base, indicator_len, identifier_len;
+    int length_len, start_len, entry_len;
+    const char *entry;
+    WRBUF w;
+
+    if (len < 25 || (record_len = decimal(buf, 5)) < 25
+        || (size_t) record_len > len
+        || (base = decimal(buf + 12, 5)) < 25 || base > record_len)
+        return -1;
+    indicator_len = decimal(buf + 10, 1);
+    identifier_len = decimal(buf + 11, 1);
+    length_len = decimal(buf + 20, 1);
+    start_len = decimal(buf + 21, 1);
+    if (indicator_len < 0)
+        indicator_len = 2;
+    if (identifier_len < 1)
+        identifier_len = 2;
+    if (length_len < 1)
+        length_len = 4;
+    if (start_len < 1)
+        start_len = 5;
+    entry_len = 3 + length_len + start_len;
+
+    w = wrbuf_alloc();
+    for (entry = buf + 24;
+         entry + entry_len <= buf + base && *entry != ISO2709_FS;
+         entry += entry_len)
+    {
+        int tag = decimal(entry, 3);
+        int field_len = decimal(entry + 3, length_len);
+        int field_start = decimal(entry + 3 + length_len, start_len);
+        const char *b, *e;
+
+        if (tag < 0 || field_len < 0 || field_start < 0
+            || base + field_start + field_len > record_len)
+            continue;
+        if (!native_needed(r, tag))
+            continue;
+        b = buf + base + field_start;
+        e = b + field_len;
+        while (e > b && (e[-1] == ISO2709_FS || e[-1] == ISO2709_RS))
+            e--;
+        if (entry[0] == '0' && entry[1] == '0')
+            native_field(r, tag, iso2709_value(r->nmem, b, e, cd, w), 0);
+        else
+        {
+            struct native_subfield *subfields = 0, **sp = &subfields;
+
+            b += indicator_len;
+            while (b < e && *b != ISO2709_IDFS)
+                b++;
+            while (b + identifier_len <= e)
+            {
+                const char *v = b + identifier_len;
+                const char *ve = v;
+                while (ve < e && *ve != ISO2709_IDFS)
+                    ve++;
+                *sp = nmem_malloc(r->nmem, sizeof(**sp));
+                (*sp)->code = b[1];
+                (*sp)->val = iso2709_value(r->nmem, v, ve, cd, w);
+                sp = &(*sp)->next;
+                b = ve;
+            }
+            *sp = 0;
+            native_field(r, tag, 0, subfields);
+        }
+    }
+    wrbuf_destroy(w);
+    return 0;
+}
+
+/** \brief applies compiled MARC map to ISO2709 record
+    \param t compiled map
+    \param buf record
+    \param len length of buf
+    \param charset of record; NULL or utf-8 if no conversion is needed
+    \returns pz:record; NULL for a bad record
+*/
+xmlDoc *marcmap_apply_iso2709(struct marcmap_table *t,
+                              const char *buf, size_t len,
+                              const char *charset)
+{
+    NMEM nmem = nmem_create();
+    yaz_iconv_t cd = 0;
+    struct native_record r;
+    xmlDoc *doc = 0;
+
+    /* MARC21 tells about UTF-8 in leader */
+    if (charset && len > 9 && buf[9] == 'a'
+        && (!strncmp(charset, "marc", 4) || !strncmp(charset, "MARC", 4)))
+        charset = 0;
+    if (charset && strcmp(charset, "utf-8") && strcmp(charset, "UTF-8")
+        && !(cd = yaz_iconv_open("UTF-8", charset)))
+    {
+        yaz_log(YLOG_WARN, "Unsupported MARC charset: %s", charset);
+        nmem_destroy(nmem);
+        return 0;
+    }
+    native_init(&r, t, nmem);
+    if (iso2709_decode(&r, buf, len, cd) == 0)
+        doc = native_to_doc(&r);
+    if (cd)
+        yaz_iconv_close(cd);
+    nmem_destroy(nmem);
+    return doc;
+}
+
+/* TurboMARC tag of element such as c001 or d245; -1 if none */
+static int turbomarc_tag(const char *name, char type)
+{
+    if (name[0] != type || strlen(name) != 4)
+        return -1;
+    return decimal(name + 1, 3);
+}
+
+static const char *turbomarc_string(NMEM nmem, xmlTextReaderPtr reader)
+{
+    xmlChar *s = xmlTextReaderReadString(reader);
+    const char *res = nmem_strdup(nmem, s ? (const char *) s : "");
+    xmlFree(s);
+    return res;
+}
+
+/** \brief applies compiled MARC map to TurboMARC record
+    \param t compiled map
+    \param buf record (UTF-8)
+    \param len length of buf
+    \returns pz:record; NULL for a bad record
+
+    The record is read as a stream; no tree is built.
+*/
+xmlDoc *marcmap_apply_turbomarc(struct marcmap_table *t,
+                                const char *buf, size_t len)
+{
+    NMEM nmem = nmem_create();
+    struct native_record r;
+    struct native_subfield *subfields = 0, **sp = 0;
+    xmlTextReaderPtr reader;
+    xmlDoc *doc = 0;
+    int tag = -1;
+    int ret;
+
+    reader = xmlReaderForMemory(buf, len, 0, 0, XML_PARSE_NONET);
+    if (!reader)
+    {
+        nmem_destroy(nmem);
+        return 0;
+    }
+    native_init(&r, t, nmem);
+    while ((ret = xmlTextReaderRead(reader)) == 1)
+    {
+        int type = xmlTextReaderNodeType(reader);
+        int depth = xmlTextReaderDepth(reader);
+        const char *name = (const char *) xmlTextReaderConstLocalName(reader);
+        int t_no;
+
+        if (type == XML_READER_TYPE_ELEMENT && depth == 1)
+        {
+            if ((t_no = turbomarc_tag(name, 'c')) >= 0)
+            {
+                if (native_needed(&r, t_no))
+                    native_field(&r, t_no, turbomarc_string(nmem, reader), 0);
+            }
+            else if ((t_no = turbomarc_tag(name, 'd')) >= 0
+                     && native_needed(&r, t_no))
+            {
+                tag = t_no;
+                subfields = 0;
+                sp = &subfields;
+                if (xmlTextReaderIsEmptyElement(reader))
+                {
+                    native_field(&r, tag, 0, 0);
+                    tag = -1;
+                }
+            }
+        }
+        else if (type == XML_READER_TYPE_ELEMENT && depth == 2 && tag >= 0
+                 && name[0] == 's')
+        {
+            char code = name[1];
+            if (!code)
+            {
+                xmlChar *c = xmlTextReaderGetAttribute(reader,
+                                                       BAD_CAST "code");
+                code = c ? c[0] : 0;
+                xmlFree(c);
+            }
+            *sp = nmem_malloc(nmem, sizeof(**sp));
+            (*sp)->code = code;
+            (*sp)->val = turbomarc_string(nmem, reader);
+            (*sp)->next = 0;
+            sp = &(*sp)->next;
+        }
+        else if (type == XML_READER_TYPE_END_ELEMENT && depth == 1
+                 && tag >= 0)
+        {
+            native_field(&r, tag, 0, subfields);
+            tag = -1;
+        }
+    }
+    xmlFreeTextReader(reader);
+    if (ret == 0)
+        doc = native_to_doc(&r);
+    nmem_destroy(nmem);
+    return doc;
+}
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -0,0 +1,51 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+#ifndef MARCMAP_NATIVE_H
+#define MARCMAP_NATIVE_H
+
+#include <stddef.h>
+#include <libxml/tree.h>
+#include <yaz/nmem.h>
+
+#include "marcmap.h"
+
+struct marcmap_table;
+
+struct marcmap_table *marcmap_table_create(struct marcmap *marcmap,
+                                           NMEM nmem);
+
+xmlDoc *marcmap_apply_iso2709(struct marcmap_table *t,
+                              const char *buf, size_t len,
+                              const char *charset);
+
+xmlDoc *marcmap_apply_turbomarc(struct marcmap_table *t,
+                                const char *buf, size_t len);
+
+#endif
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
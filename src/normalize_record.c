@@ -17,20 +17,25 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 */
 
+#include <stdio.h>
 #include <string.h>
 
 #include <yaz/yaz-util.h>
+#include <yaz/mutex.h>
 #include <yaz/nmem.h>
 
 #if HAVE_CONFIG_H
 #include <config.h>
 #endif
 
+#include "ppmutex.h"
 #include "normalize_record.h"
+#include "jenkins_hash.h"
 
 #include "pazpar2_config.h"
 #include "service_xslt.h"
 #include "marcmap.h"
+#include "marcmap_native.h"
 #include <libxslt/xslt.h>
 #include <libxslt/transform.h>
 
@@ -39,13 +44,61 @@ struct normalize_step {
     xsltStylesheet *stylesheet;  /* created by normalize_record */
     xsltStylesheet *stylesheet2; /* external stylesheet (service) */
     struct marcmap *marcmap;
+    struct marcmap_table *marcmap_table; /* compiled marcmap */
+};
+
+/* parses before a parser context is replaced; bounds its dictionary */
+#define NORMALIZE_PARSER_MAX_USES 1000
+
+#define NORMALIZE_PARSE_OPTIONS (XML_PARSE_NONET | XML_PARSE_COMPACT)
+
+struct normalize_parser {
+    xmlParserCtxtPtr ctxt;
+    int uses;
+    struct normalize_parser *next;
 };
 
 struct normalize_record_s {
     struct normalize_step *steps;
     NMEM nmem;
+    xmlDictPtr dict;                   /* of first stylesheet or 0 */
+    YAZ_MUTEX mutex;
+    struct normalize_parser *parsers;  /* idle parser contexts */
+    unsigned fingerprint;              /* of stylesheet contents */
 };
 
+/* appends content of file to w; records that it could not be read */
+static void fingerprint_file(WRBUF w, const char *fname)
+{
+    char buf[4096];
+    size_t r;
+    FILE *inf = fopen(fname, "rb");
+
+    if (!inf)
+    {
+        wrbuf_printf(w, "%s: missing\n", fname);
+        return;
+    }
+    while ((r = fread(buf, 1, sizeof(buf), inf)) > 0)
+        wrbuf_write(w, buf, r);
+    fclose(inf);
+}
+
+/* appends serialized service-defined stylesheet to w */
+static void fingerprint_doc(WRBUF w, xsltStylesheetPtr xsp)
+{
+    xmlChar *buf_out = 0;
+    int len_out = 0;
+
+    if (xsp->doc)
+        xmlDocDumpMemory(xsp->doc, &buf_out, &len_out);
+    if (buf_out)
+    {
+        wrbuf_write(w, (const char *) buf_out, len_out);
+        xmlFree(buf_out);
+    }
+}
+
 normalize_record_t normalize_record_create(struct conf_service *service,
                                            const char *spec)
 {
@@ -54,21 +107,29 @@ normalize_record_t normalize_record_create(struct conf_service *service,
     struct normalize_step **m = &nt->steps;
     int no_errors = 0;
     int embed = 0;
+    WRBUF fp = wrbuf_alloc();
 
     if (*spec == '<')
         embed = 1;
 
     nt->nmem = nmem;
+    nt->dict = 0;
+    nt->parsers = 0;
+    nt->mutex = 0;
+    pazpar2_mutex_create(&nt->mutex, "normalize_record");
 
     if (embed)
     {
         xmlDoc *xsp_doc = xmlParseMemory(spec, strlen(spec));
 
+        wrbuf_puts(fp, spec);
+
         if (!xsp_doc)
             no_errors++;
         {
             *m = nmem_malloc(nt->nmem, sizeof(**m));
             (*m)->marcmap = NULL;
+            (*m)->marcmap_table = NULL;
             (*m)->stylesheet = NULL;
             (*m)->stylesheet2 = NULL;
 
@@ -92,11 +153,13 @@ normalize_record_t normalize_record_create(struct conf_service *service,
 
             *m = nmem_malloc(nt->nmem, sizeof(**m));
             (*m)->marcmap = NULL;
+            (*m)->marcmap_table = NULL;
             (*m)->stylesheet = NULL;
 
+            wrbuf_printf(fp, "%s\n", stylesheets[i]);
             (*m)->stylesheet2 = service_xslt_get(service, stylesheets[i]);
             if ((*m)->stylesheet2)
-                ;
+                fingerprint_doc(fp, (*m)->stylesheet2);
             else if (!strcmp(&stylesheets[i][strlen(stylesheets[i])-4], ".xsl"))
             {
                 if (!((*m)->stylesheet =
@@ -106,15 +169,20 @@ normalize_record_t normalize_record_create(struct conf_service *service,
                             stylesheets[i]);
                     no_errors++;
                 }
+                fingerprint_file(fp, wrbuf_cstr(fname));
             }
             else if (!strcmp(&stylesheets[i][strlen(stylesheets[i])-5], ".mmap"))
             {
+                fingerprint_file(fp, wrbuf_cstr(fname));
                 if (!((*m)->marcmap = marcmap_load(wrbuf_cstr(fname), nt->nmem)))
                 {
                     yaz_log(YLOG_FATAL|YLOG_ERRNO, "Unable to load marcmap: %s",
                             stylesheets[i]);
                     no_errors++;
                 }
+                else
+                    (*m)->marcmap_table =
+                        marcmap_table_create((*m)->marcmap, nt->nmem);
             }
             else
             {
@@ -127,6 +195,13 @@ normalize_record_t normalize_record_create(struct conf_service *service,
         }
     }
     *m = 0;  /* terminate list of steps */
+    nt->fingerprint = jenkins_hash((const unsigned char *) wrbuf_cstr(fp));
+    wrbuf_destroy(fp);
+
+    if (nt->steps && nt->steps->stylesheet)
+        nt->dict = nt->steps->stylesheet->dict;
+    else if (nt->steps && nt->steps->stylesheet2)
+        nt->dict = nt->steps->stylesheet2->dict;
 
     if (no_errors)
     {
@@ -136,61 +211,202 @@ normalize_record_t normalize_record_create(struct conf_service *service,
     return nt;
 }
 
+unsigned normalize_record_fingerprint(normalize_record_t nt)
+{
+    return nt ? nt->fingerprint : 0;
+}
+
 void normalize_record_destroy(normalize_record_t nt)
 {
     if (nt)
     {
         struct normalize_step *m;
+        while (nt->parsers)
+        {
+            struct normalize_parser *p = nt->parsers;
+            nt->parsers = p->next;
+            xmlFreeParserCtxt(p->ctxt);
+            xfree(p);
+        }
         for (m = nt->steps; m; m = m->next)
         {
             if (m->stylesheet)
                 xsltFreeStylesheet(m->stylesheet);
         }
+        yaz_mutex_destroy(&nt->mutex);
         nmem_destroy(nt->nmem);
     }
 }
 
+/* parser context with a sub dictionary of the stylesheet's, so that
+   names of the record are shared with the stylesheet */
+static struct normalize_parser *normalize_parser_create(normalize_record_t nt)
+{
+    struct normalize_parser *p;
+    xmlParserCtxtPtr ctxt = xmlNewParserCtxt();
+
+    if (!ctxt)
+        return 0;
+    if (nt->dict)
+    {
+        xmlDictPtr dict = xmlDictCreateSub(nt->dict);
+        if (dict)
+        {
+            xmlDictFree(ctxt->dict);
+            ctxt->dict = dict;
+            ctxt->str_xml = xmlDictLookup(dict, BAD_CAST "xml", 3);
+            ctxt->str_xmlns = xmlDictLookup(dict, BAD_CAST "xmlns", 5);
+            ctxt->str_xml_ns = xmlDictLookup(dict, XML_XML_NAMESPACE, 36);
+        }
+    }
+    p = xmalloc(sizeof(*p));
+    p->ctxt = ctxt;
+    p->uses = 0;
+    p->next = 0;
+    return p;
+}
+
+/** \brief parses record for normalization
+    \param nt normalization (may be NULL)
+    \param buf XML
+    \param len length of buf
+    \returns document or NULL if not well-formed
+
+    Parser contexts are reused; each is used by one thread at a time.
+*/
+xmlDoc *normalize_record_parse(normalize_record_t nt,
+                               const char *buf, size_t len)
+{
+    struct normalize_parser *p;
+    xmlDoc *doc;
+
+    if (!nt)
+        return xmlReadMemory(buf, len, 0, 0, NORMALIZE_PARSE_OPTIONS);
+    yaz_mutex_enter(nt->mutex);
+    if ((p = nt->parsers))
+        nt->parsers = p->next;
+    yaz_mutex_leave(nt->mutex);
+    if (!p && !(p = normalize_parser_create(nt)))
+        return xmlReadMemory(buf, len, 0, 0, NORMALIZE_PARSE_OPTIONS);
+
+    doc = xmlCtxtReadMemory(p->ctxt, buf, len, 0, 0, NORMALIZE_PARSE_OPTIONS);
+
+    if (++p->uses >= NORMALIZE_PARSER_MAX_USES)
+    {
+        xmlFreeParserCtxt(p->ctxt);
+        xfree(p);
+    }
+    else
+    {
+        yaz_mutex_enter(nt->mutex);
+        p->next = nt->parsers;
+        nt->parsers = p;
+        yaz_mutex_leave(nt->mutex);
+    }
+    return doc;
+}
+
+/* checks result of step; *doc is 0 when called */
+static int normalize_step_result(xmlDoc **doc, xmlDoc *ndoc)
+{
+    xmlNodePtr root = 0;
+
+    if (ndoc)
+        root = xmlDocGetRootElement(ndoc);
+
+    if (ndoc && root && root->children)
+    {
+        *doc = ndoc;
+        return 0;
+    }
+    if (!ndoc)
+        yaz_log(YLOG_WARN, "XSLT produced no document");
+    else if (!root)
+        yaz_log(YLOG_WARN, "XSLT produced XML with no root node");
+    else if (!root->children)
+        yaz_log(YLOG_WARN, "XSLT produced XML with no root children nodes");
+    if (ndoc)
+        xmlFreeDoc(ndoc);
+    return -1;
+}
+
+static int normalize_steps(struct normalize_step *m, xmlDoc **doc,
+                           const char **parms)
+{
+    for (; m; m = m->next)
+    {
+        xmlDoc *ndoc;
+        if (m->stylesheet)
+            ndoc = xsltApplyStylesheet(m->stylesheet, *doc, parms);
+        else if (m->stylesheet2)
+            ndoc = xsltApplyStylesheet(m->stylesheet2, *doc, parms);
+        else if (m->marcmap)
+            ndoc = marcmap_apply(m->marcmap, *doc);
+        else
+            ndoc = 0;
+        xmlFreeDoc(*doc);
+        *doc = 0;
+        if (normalize_step_result(doc, ndoc))
+            return -1;
+    }
+    return 0;
+}
+
 int normalize_record_transform(normalize_record_t nt, xmlDoc **doc,
                                const char **parms)
 {
     if (nt)
-    {
-        struct normalize_step *m;
-	for (m = nt->steps; m; m = m->next)
-	{
-	    xmlNodePtr root = 0;
-	    xmlDoc *ndoc;
-	    if (m->stylesheet)
-		ndoc = xsltApplyStylesheet(m->stylesheet, *doc, parms);
-	    else if (m->stylesheet2)
-		ndoc = xsltApplyStylesheet(m->stylesheet2, *doc, parms);
-	    else if (m->marcmap)
-		ndoc = marcmap_apply(m->marcmap, *doc);
-            else
-                ndoc = 0;
-	    xmlFreeDoc(*doc);
-            *doc = 0;
+        return normalize_steps(nt->steps, doc, parms);
+    return 0;
+}
+
+/** \brief whether records may be given in native syntax
+    \param nt normalization
+    \param nativesyntax pz:nativesyntax of database
+    \retval 1 first step is a MARC map that decodes nativesyntax
+    \retval 0 records must be given as XML
+*/
+int normalize_record_native(normalize_record_t nt, const char *nativesyntax)
+{
+    if (!nt || !nt->steps || !nt->steps->marcmap_table || !nativesyntax)
+        return 0;
+    return !strncmp(nativesyntax, "iso2709", 7)
+        || !strncmp(nativesyntax, "txml", 4);
+}
 
-            if (ndoc)
-                root = xmlDocGetRootElement(ndoc);
+/** \brief normalizes record in native syntax
+    \param nt normalization for which normalize_record_native holds
+    \param rec ISO2709 or TurboMARC record
+    \param len length of rec
+    \param nativesyntax pz:nativesyntax of database
+    \param doc resulting record
+    \param parms parameters for later XSLT steps
+    \retval 0 OK
+    \retval -1 failure
 
-            if (ndoc && root && root->children)
-                *doc = ndoc;
-            else
-	    {
-                if (!ndoc)
-                    yaz_log(YLOG_WARN, "XSLT produced no document");
-                else if (!root)
-                    yaz_log(YLOG_WARN, "XSLT produced XML with no root node");
-                else if (!root->children)
-                    yaz_log(YLOG_WARN, "XSLT produced XML with no root children nodes");
-		if (ndoc)
-		    xmlFreeDoc(ndoc);
-		return -1;
-	    }
-	}
+    The first step decodes the record directly, so that neither MARCXML
+    nor a tree of it is produced.
+*/
+int normalize_record_transform_native(normalize_record_t nt,
+                                      const char *rec, size_t len,
+                                      const char *nativesyntax,
+                                      xmlDoc **doc, const char **parms)
+{
+    struct normalize_step *m = nt->steps;
+    xmlDoc *ndoc;
+
+    if (!strncmp(nativesyntax, "txml", 4))
+        ndoc = marcmap_apply_turbomarc(m->marcmap_table, rec, len);
+    else
+    {
+        const char *cp = strchr(nativesyntax, ';');
+        ndoc = marcmap_apply_iso2709(m->marcmap_table, rec, len,
+                                     cp ? cp + 1 : "marc-8s");
     }
-    return 0;
+    *doc = 0;
+    if (normalize_step_result(doc, ndoc))
+        return -1;
+    return normalize_steps(m->next, doc, parms);
 }
 
 /*
@@ -28,9 +28,22 @@ normalize_record_t normalize_record_create(struct conf_service *service,
 
 void normalize_record_destroy(normalize_record_t nt);
 
+/* hash of the stylesheets and maps making up the pipeline */
+unsigned normalize_record_fingerprint(normalize_record_t nt);
+
 int normalize_record_transform(normalize_record_t nt, xmlDoc **doc,
                                const char **parms);
 
+xmlDoc *normalize_record_parse(normalize_record_t nt,
+                               const char *buf, size_t len);
+
+int normalize_record_native(normalize_record_t nt, const char *nativesyntax);
+
+int normalize_record_transform_native(normalize_record_t nt,
+                                      const char *rec, size_t len,
+                                      const char *nativesyntax,
+                                      xmlDoc **doc, const char **parms);
+
 #endif
 
 /*
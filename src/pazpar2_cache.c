@@ -0,0 +1,325 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file pazpar2_cache.c
+    \brief Offline tool to inspect and compact disk cache segments
+
+    Must not be used on a directory that a running pazpar2 writes to.
+*/
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <yaz/options.h>
+#include <yaz/log.h>
+#include <yaz/xmalloc.h>
+
+#include "ppmutex.h"
+#include "jenkins_hash.h"
+#include "disk_cache.h"
+
+#define KEY_BUCKETS 4096
+
+/* most recent entry per key */
+struct latest {
+    char *key;
+    unsigned hash;
+    unsigned segment;
+    size_t offset;
+    struct latest *next;
+};
+
+struct scan_state {
+    struct latest **buckets;
+    unsigned segment;
+    int ttl;
+    time_t now;
+    int list;           /* print entries */
+    int out_fd;         /* compaction output; -1 for none */
+    unsigned out_no;
+    size_t out_size;
+    size_t segment_max;
+    const char *dir;
+    int kept;
+    int dropped;
+    int errors;
+};
+
+static struct latest *latest_find(struct scan_state *st, const char *key)
+{
+    unsigned h = jenkins_hash((const unsigned char *) key);
+    struct latest *l = st->buckets[h % KEY_BUCKETS];
+
+    for (; l; l = l->next)
+        if (l->hash == h && !strcmp(l->key, key))
+            return l;
+    l = xmalloc(sizeof(*l));
+    l->key = xstrdup(key);
+    l->hash = h;
+    l->segment = 0;
+    l->offset = 0;
+    l->next = st->buckets[h % KEY_BUCKETS];
+    st->buckets[h % KEY_BUCKETS] = l;
+    return l;
+}
+
+static void index_handler(void *data, const char *buf, size_t offset,
+                          size_t length, time_t created, const char *key)
+{
+    struct scan_state *st = data;
+    struct latest *l = latest_find(st, key);
+
+    l->segment = st->segment;
+    l->offset = offset;
+}
+
+static void print_key(const char *key)
+{
+    for (; *key; key++)
+        if (*key == '\n')
+            fputs(" | ", stdout);
+        else
+            putchar(*key);
+}
+
+static int out_open(struct scan_state *st)
+{
+    char fname[1024];
+
+    if (st->out_fd != -1)
+        close(st->out_fd);
+    disk_cache_segment_name(fname, sizeof(fname), st->dir, ++st->out_no);
+    st->out_fd = disk_cache_segment_create(fname);
+    st->out_size = DISK_CACHE_SEGMENT_HEADER;
+    if (st->out_fd == -1)
+    {
+        yaz_log(YLOG_FATAL|YLOG_ERRNO, "cannot create %s", fname);
+        return -1;
+    }
+    return 0;
+}
+
+static void entry_handler(void *data, const char *buf, size_t offset,
+                          size_t length, time_t created, const char *key)
+{
+    struct scan_state *st = data;
+    struct latest *l = latest_find(st, key);
+    int superseded = l->segment != st->segment || l->offset != offset;
+    int expired = created + st->ttl <= st->now;
+    search_cache_entry_t e = 0;
+    time_t t;
+
+    if (st->list || (!superseded && !expired && st->out_fd != -1))
+    {
+        e = disk_cache_decode(buf, length, &t);
+        if (!e)
+        {
+            printf("%08u.seg %lu: malformed entry\n", st->segment,
+                   (unsigned long) offset);
+            st->dropped++;
+            return;
+        }
+    }
+    if (st->list)
+    {
+        char tstr[32];
+        strftime(tstr, sizeof(tstr), "%Y-%m-%d %H:%M:%S",
+                 localtime(&created));
+        printf("%08u.seg %lu %s %s hits=" ODR_INT_PRINTF
+               " records=%d facets=%d bytes=%lu\n  ", st->segment,
+               (unsigned long) offset, tstr,
+               superseded ? "superseded" : expired ? "expired" : "live",
+               search_cache_entry_hits(e),
+               search_cache_entry_num_records(e),
+               search_cache_entry_num_facets(e), (unsigned long) length);
+        print_key(key);
+        putchar('\n');
+    }
+    if (st->out_fd != -1)
+    {
+        if (superseded || expired)
+            st->dropped++;
+        else
+        {
+            long r;
+            if (st->out_size > DISK_CACHE_SEGMENT_HEADER
+                && st->out_size + length > st->segment_max)
+                out_open(st);
+            r = disk_cache_append(st->out_fd, e, created);
+            if (r < 0)
+            {
+                yaz_log(YLOG_WARN|YLOG_ERRNO, "write of segment %08u",
+                        st->out_no);
+                st->errors++;
+            }
+            else
+            {
+                st->out_size += r;
+                st->kept++;
+            }
+        }
+    }
+    search_cache_entry_destroy(e);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: pazpar2_cache [options] dir\n"
+            "    -l                      List entries\n"
+            "    -c                      Compact segments\n"
+            "    -t ttl                  Seconds entries are valid (86400)\n"
+            "    -s kbytes               Size of compacted segments (8192)\n"
+            "    -v level                Set log level\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int ret, i, num;
+    char *arg;
+    const char *dir = 0;
+    int list = 0, compact = 0;
+    int segment_kbytes = 8192;
+    unsigned *nos;
+    char *scanned;
+    char fname[1024];
+    struct scan_state st;
+
+    pazpar2_mutex_init();
+    st.ttl = 86400;
+    while ((ret = options("lct:s:v:", argv, argc, &arg)) != -2)
+    {
+        switch (ret)
+        {
+        case 'l':
+            list = 1;
+            break;
+        case 'c':
+            compact = 1;
+            break;
+        case 't':
+            st.ttl = atoi(arg);
+            break;
+        case 's':
+            segment_kbytes = atoi(arg);
+            break;
+        case 'v':
+            yaz_log_init_level(yaz_log_mask_str(arg));
+            break;
+        case 0:
+            if (dir)
+                usage();
+            dir = arg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (!dir || (!list && !compact))
+        usage();
+    num = disk_cache_segments(dir, &nos);
+    if (num < 0)
+    {
+        yaz_log(YLOG_FATAL|YLOG_ERRNO, "cannot read %s", dir);
+        exit(1);
+    }
+    scanned = xmalloc(num + 1);
+    st.buckets = xmalloc(KEY_BUCKETS * sizeof(*st.buckets));
+    memset(st.buckets, 0, KEY_BUCKETS * sizeof(*st.buckets));
+    st.now = time(0);
+    st.list = 0;
+    st.out_fd = -1;
+    st.out_no = num > 0 ? nos[num - 1] : 0;
+    st.out_size = 0;
+    st.segment_max = (size_t) segment_kbytes * 1024;
+    st.dir = dir;
+    st.kept = st.dropped = st.errors = 0;
+
+    /* first pass finds the most recent entry of each key */
+    for (i = 0; i < num; i++)
+    {
+        disk_cache_segment_name(fname, sizeof(fname), dir, nos[i]);
+        st.segment = nos[i];
+        if (disk_cache_scan(fname, index_handler, &st) < 0)
+            yaz_log(YLOG_WARN, "%s is not a segment", fname);
+    }
+    st.list = list;
+    if (compact && out_open(&st))
+        exit(1);
+    for (i = 0; i < num; i++)
+    {
+        long size;
+
+        disk_cache_segment_name(fname, sizeof(fname), dir, nos[i]);
+        st.segment = nos[i];
+        size = disk_cache_scan(fname, entry_handler, &st);
+        scanned[i] = size >= 0;
+        if (list && size >= 0)
+            printf("%08u.seg: %ld bytes\n", nos[i], size);
+    }
+    if (compact)
+    {
+        close(st.out_fd);
+        if (st.errors)
+        {
+            yaz_log(YLOG_FATAL, "compaction failed; old segments kept");
+            exit(1);
+        }
+        for (i = 0; i < num; i++)
+        {
+            if (!scanned[i])
+                continue; /* not ours; entries were not carried over */
+            disk_cache_segment_name(fname, sizeof(fname), dir, nos[i]);
+            if (unlink(fname))
+                yaz_log(YLOG_WARN|YLOG_ERRNO, "cannot remove %s", fname);
+        }
+        printf("%d entries kept, %d dropped\n", st.kept, st.dropped);
+    }
+    for (i = 0; i < KEY_BUCKETS; i++)
+        while (st.buckets[i])
+        {
+            struct latest *l = st.buckets[i];
+            st.buckets[i] = l->next;
+            xfree(l->key);
+            xfree(l);
+        }
+    xfree(st.buckets);
+    xfree(scanned);
+    xfree(nos);
+    return 0;
+}
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -41,6 +41,11 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "ppmutex.h"
 #include "incref.h"
 #include "pazpar2_config.h"
+#include "charset_cache.h"
+#include "search_cache.h"
+#include "disk_cache.h"
+#include "raw_cache.h"
+#include "query_cache.h"
 #include "service_xslt.h"
 #include "settings.h"
 #include "eventl.h"
@@ -52,6 +57,15 @@ struct conf_config
     struct conf_server *servers;
 
     int no_threads;
+    int charset_cache_entries;
+    int search_cache_size;  /* kilobytes */
+    int search_cache_ttl;   /* seconds */
+    int raw_cache_size;     /* kilobytes */
+    int raw_cache_ttl;      /* seconds */
+    int query_cache_entries;
+    char *disk_cache_dir;
+    int disk_cache_size;    /* kilobytes */
+    int disk_cache_ttl;     /* seconds */
     WRBUF confdir;
     iochan_man_t iochan_man;
     database_hosts_t database_hosts;
@@ -80,10 +94,13 @@ struct conf_service *service_init(struct conf_server *server,
     service->databases = 0;
     service->xslt_list = 0;
     service->ccl_bibset = 0;
+    service->ccl_directives = 0;
     service->server = server;
     service->session_timeout = 60; /* default session timeout */
     service->z3950_session_timeout = 180;
     service->z3950_operation_timeout = 30;
+    service->block_records = 0;
+    service->block_window = 0;
     service->rank_cluster = 1;
     service->rank_debug = 0;
     service->rank_follow = 0.0;
@@ -163,6 +180,7 @@ static struct conf_metadata* conf_service_add_metadata(
         md->merge = merge;
 
     md->setting = setting;
+    md->setting_offset = -1;
     md->brief = brief;
     md->termlist = termlist;
     md->rank = nmem_strdup_null(nmem, rank);
@@ -385,6 +403,8 @@ static int parse_metadata(struct conf_service *service, xmlNode *n,
             merge = Metadata_merge_range;
         else if (!strcmp((const char *) xml_merge, "all"))
             merge = Metadata_merge_all;
+        else if (!strcmp((const char *) xml_merge, "unique-normalized"))
+            merge = Metadata_merge_unique_normalized;
         else
         {
             yaz_log(YLOG_FATAL,
@@ -535,6 +555,31 @@ static struct conf_service *service_create_static(struct conf_server *server,
                 }
             }
         }
+        else if (!strcmp((const char *) n->name, "block"))
+        {
+            xmlChar *src = xmlGetProp(n, (xmlChar *) "records");
+            if (src)
+            {
+                service->block_records = atoi((const char *) src);
+                xmlFree(src);
+                if (service->block_records < 0)
+                {
+                    yaz_log(YLOG_FATAL, "block records out of range");
+                    return 0;
+                }
+            }
+            src = xmlGetProp(n, (xmlChar *) "window");
+            if (src)
+            {
+                service->block_window = atoi((const char *) src);
+                xmlFree(src);
+                if (service->block_window < 0)
+                {
+                    yaz_log(YLOG_FATAL, "block window out of range");
+                    return 0;
+                }
+            }
+        }
         else if (!strcmp((const char *) n->name, "ccldirective"))
         {
             char *name;
@@ -555,6 +600,15 @@ static struct conf_service *service_create_static(struct conf_server *server,
                 return 0;
             }
             ccl_qual_add_special(service->ccl_bibset, name, value);
+            {
+                WRBUF w = wrbuf_alloc();
+                if (service->ccl_directives)
+                    wrbuf_puts(w, service->ccl_directives);
+                wrbuf_printf(w, "%s=%s\n", name, value);
+                service->ccl_directives =
+                    nmem_strdup(service->nmem, wrbuf_cstr(w));
+                wrbuf_destroy(w);
+            }
             xmlFree(value);
             xmlFree(name);
         }
@@ -779,6 +833,7 @@ static struct conf_server *server_create(struct conf_config *config,
     xmlNode *n;
     struct conf_server *server = nmem_malloc(nmem, sizeof(struct conf_server));
     xmlChar *server_id = xmlGetProp(node, (xmlChar *) "id");
+    xmlChar *node_id = xmlGetProp(node, (xmlChar *) "node");
 
     server->host = 0;
     server->port = 0;
@@ -801,6 +856,17 @@ static struct conf_server *server_create(struct conf_config *config,
     }
     else
         server->server_id = 0;
+    server->node_id = 0;
+    if (node_id)
+    {
+        server->node_id = atoi((const char *) node_id);
+        xmlFree(node_id);
+        if (server->node_id < 0 || server->node_id > 127)
+        {
+            yaz_log(YLOG_FATAL, "server node must be in range 0..127");
+            return 0;
+        }
+    }
     for (n = node->children; n; n = n->next)
     {
         if (n->type != XML_ELEMENT_NODE)
@@ -992,6 +1058,80 @@ static int parse_config(struct conf_config *config, xmlNode *root)
                 xmlFree(number);
             }
         }
+        else if (!strcmp((const char *) n->name, "normalization-cache"))
+        {
+            xmlChar *entries = xmlGetProp(n, (xmlChar *) "entries");
+            if (entries)
+            {
+                config->charset_cache_entries = atoi((const char *) entries);
+                xmlFree(entries);
+            }
+        }
+        else if (!strcmp((const char *) n->name, "search-cache"))
+        {
+            xmlChar *size = xmlGetProp(n, (xmlChar *) "size");
+            xmlChar *ttl = xmlGetProp(n, (xmlChar *) "ttl");
+            if (size)
+            {
+                config->search_cache_size = atoi((const char *) size) * 1024;
+                xmlFree(size);
+            }
+            if (ttl)
+            {
+                config->search_cache_ttl = atoi((const char *) ttl);
+                xmlFree(ttl);
+            }
+        }
+        else if (!strcmp((const char *) n->name, "raw-cache"))
+        {
+            xmlChar *size = xmlGetProp(n, (xmlChar *) "size");
+            xmlChar *ttl = xmlGetProp(n, (xmlChar *) "ttl");
+            if (size)
+            {
+                config->raw_cache_size = atoi((const char *) size) * 1024;
+                xmlFree(size);
+            }
+            if (ttl)
+            {
+                config->raw_cache_ttl = atoi((const char *) ttl);
+                xmlFree(ttl);
+            }
+        }
+        else if (!strcmp((const char *) n->name, "query-cache"))
+        {
+            xmlChar *entries = xmlGetProp(n, (xmlChar *) "entries");
+            if (entries)
+            {
+                config->query_cache_entries = atoi((const char *) entries);
+                xmlFree(entries);
+            }
+        }
+        else if (!strcmp((const char *) n->name, "disk-cache"))
+        {
+            xmlChar *dir = xmlGetProp(n, (xmlChar *) "directory");
+            xmlChar *size = xmlGetProp(n, (xmlChar *) "size");
+            xmlChar *ttl = xmlGetProp(n, (xmlChar *) "ttl");
+            if (!dir)
+            {
+                yaz_log(YLOG_FATAL, "disk-cache: missing directory");
+                xmlFree(size);
+                xmlFree(ttl);
+                return -1;
+            }
+            config->disk_cache_dir =
+                nmem_strdup(config->nmem, (const char *) dir);
+            xmlFree(dir);
+            if (size)
+            {
+                config->disk_cache_size = atoi((const char *) size) * 1024;
+                xmlFree(size);
+            }
+            if (ttl)
+            {
+                config->disk_cache_ttl = atoi((const char *) ttl);
+                xmlFree(ttl);
+            }
+        }
         else if (!strcmp((const char *) n->name, "targetprofiles"))
         {
             yaz_log(YLOG_FATAL, "targetprofiles unsupported here. Must be part of service");
@@ -1028,6 +1168,15 @@ struct conf_config *config_create(const char *fname, int verbose)
     config->nmem = nmem;
     config->servers = 0;
     config->no_threads = 0;
+    config->charset_cache_entries = 20000;
+    config->search_cache_size = 0;
+    config->search_cache_ttl = 300;
+    config->raw_cache_size = 0;
+    config->raw_cache_ttl = 300;
+    config->query_cache_entries = 10000;
+    config->disk_cache_dir = 0;
+    config->disk_cache_size = 100 * 1024;
+    config->disk_cache_ttl = 86400;
     config->iochan_man = 0;
     config->database_hosts = database_hosts_create();
 
@@ -1098,6 +1247,11 @@ void config_destroy(struct conf_config *config)
             server = s_next;
             database_hosts_destroy(&config->database_hosts);
         }
+        charset_cache_destroy();
+        search_cache_destroy();
+        disk_cache_destroy();
+        raw_cache_destroy();
+        query_cache_destroy();
         wrbuf_destroy(config->confdir);
         nmem_destroy(config->nmem);
     }
@@ -1135,6 +1289,13 @@ int config_start_listeners(struct conf_config *conf,
     struct conf_server *ser;
 
     conf->iochan_man = iochan_man_create(conf->no_threads);
+    charset_cache_init(conf->charset_cache_entries);
+    search_cache_init(conf->search_cache_size, conf->search_cache_ttl);
+    raw_cache_init(conf->raw_cache_size, conf->raw_cache_ttl);
+    query_cache_init(conf->query_cache_entries);
+    if (disk_cache_init(conf->disk_cache_dir, conf->disk_cache_size,
+                        conf->disk_cache_ttl))
+        return -1;
     for (ser = conf->servers; ser; ser = ser->next)
     {
         WRBUF w = wrbuf_alloc();
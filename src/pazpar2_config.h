@@ -41,7 +41,8 @@ enum conf_metadata_merge {
     Metadata_merge_unique,    // Include unique elements in merged block
     Metadata_merge_longest,   // Include the longest (strlen) value
     Metadata_merge_range,     // Store value as a range of lowest-highest
-    Metadata_merge_all        // Just include all elements found
+    Metadata_merge_all,       // Just include all elements found
+    Metadata_merge_unique_normalized // unique after facetrule normalization
 };
 
 enum conf_sortkey_type {
@@ -80,6 +81,7 @@ struct conf_metadata
     enum conf_metadata_type type;
     enum conf_metadata_merge merge;
     enum conf_setting_type setting; // Value is to be taken from session/db settings?
+    int setting_offset; // dictionary offset of setting; -1 if none
     enum conf_metadata_mergekey mergekey;
     char *facetrule;
 
@@ -117,6 +119,8 @@ struct conf_service
     int session_timeout;
     int z3950_session_timeout;
     int z3950_operation_timeout;
+    int block_records;  /* new records before blocked command returns */
+    int block_window;   /* or milliseconds since it blocked */
     int rank_cluster;
     int rank_debug;
     double rank_follow;
@@ -131,6 +135,7 @@ struct conf_service
     struct service_xslt *xslt_list;
 
     CCL_bibset ccl_bibset;
+    char *ccl_directives; /* name=value lines ccl_bibset was built from */
     struct database *databases;
     struct conf_server *server;
 };
@@ -148,6 +153,7 @@ struct conf_server
     char *myurl;
     char *settings_fname;
     char *server_id;
+    int node_id;
 
     pp2_charset_fact_t charsets;
 
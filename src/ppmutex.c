@@ -26,14 +26,31 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #endif
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#include <windows.h>
+#endif
+#if YAZ_POSIX_THREADS
+#include <pthread.h>
+#endif
 #include <yaz/log.h>
 #include "ppmutex.h"
 
 static int ppmutex_level = 0;
 
+#if !defined(__GNUC__) && !defined(WIN32)
+static YAZ_MUTEX atomic_mutex = 0;
+#endif
+
 void pazpar2_mutex_init(void)
 {
     ppmutex_level = yaz_log_module_level("mutex");
+#if !defined(__GNUC__) && !defined(WIN32)
+    /* created here, before any threads, rather than on first use */
+    if (!atomic_mutex)
+        yaz_mutex_create(&atomic_mutex);
+#endif
 }
 
 void pazpar2_mutex_create(YAZ_MUTEX *p, const char *name)
@@ -43,6 +60,98 @@ void pazpar2_mutex_create(YAZ_MUTEX *p, const char *name)
     yaz_mutex_set_name(*p, ppmutex_level, name);
 }
 
+/** \brief adds to integer atomically
+    \param p pointer to integer
+    pazpar2_mutex_init must have been called before
+    \param delta value to add (0 to just read)
+    \returns new value
+*/
+int pazpar2_atomic_add(volatile int *p, int delta)
+{
+#if defined(__GNUC__)
+    return __sync_add_and_fetch(p, delta);
+#elif defined(WIN32)
+    return InterlockedExchangeAdd((volatile LONG *) p, delta) + delta;
+#else
+    int v;
+    assert(atomic_mutex);
+    yaz_mutex_enter(atomic_mutex);
+    v = (*p += delta);
+    yaz_mutex_leave(atomic_mutex);
+    return v;
+#endif
+}
+
+struct pazpar2_rwlock {
+#if YAZ_POSIX_THREADS
+    pthread_rwlock_t handle;
+#else
+    YAZ_MUTEX mutex;   /* no shared mode: readers are exclusive too */
+#endif
+    char *name;
+};
+
+void pazpar2_rwlock_create(PAZPAR2_RWLOCK *p, const char *name)
+{
+    assert(p);
+    *p = malloc(sizeof(**p));
+    (*p)->name = strdup(name);
+#if YAZ_POSIX_THREADS
+    pthread_rwlock_init(&(*p)->handle, 0);
+#else
+    (*p)->mutex = 0;
+    pazpar2_mutex_create(&(*p)->mutex, name);
+#endif
+}
+
+void pazpar2_rwlock_destroy(PAZPAR2_RWLOCK *p)
+{
+    if (*p)
+    {
+#if YAZ_POSIX_THREADS
+        pthread_rwlock_destroy(&(*p)->handle);
+#else
+        yaz_mutex_destroy(&(*p)->mutex);
+#endif
+        free((*p)->name);
+        free(*p);
+        *p = 0;
+    }
+}
+
+void pazpar2_rwlock_rdlock(PAZPAR2_RWLOCK p)
+{
+#if YAZ_POSIX_THREADS
+    pthread_rwlock_rdlock(&p->handle);
+#else
+    yaz_mutex_enter(p->mutex);
+#endif
+    if (ppmutex_level)
+        yaz_log(ppmutex_level, "rwlock %s rdlock", p->name);
+}
+
+void pazpar2_rwlock_wrlock(PAZPAR2_RWLOCK p)
+{
+#if YAZ_POSIX_THREADS
+    pthread_rwlock_wrlock(&p->handle);
+#else
+    yaz_mutex_enter(p->mutex);
+#endif
+    if (ppmutex_level)
+        yaz_log(ppmutex_level, "rwlock %s wrlock", p->name);
+}
+
+void pazpar2_rwlock_unlock(PAZPAR2_RWLOCK p)
+{
+    if (ppmutex_level)
+        yaz_log(ppmutex_level, "rwlock %s unlock", p->name);
+#if YAZ_POSIX_THREADS
+    pthread_rwlock_unlock(&p->handle);
+#else
+    yaz_mutex_leave(p->mutex);
+#endif
+}
+
 /*
  * Local variables:
  * c-basic-offset: 4
@@ -30,6 +30,17 @@ void pazpar2_mutex_init(void);
 
 void pazpar2_mutex_create(YAZ_MUTEX *p, const char *name);
 
+int pazpar2_atomic_add(volatile int *p, int delta);
+
+/** \brief reader/writer lock. Without POSIX threads it is a plain mutex */
+typedef struct pazpar2_rwlock *PAZPAR2_RWLOCK;
+
+void pazpar2_rwlock_create(PAZPAR2_RWLOCK *p, const char *name);
+void pazpar2_rwlock_destroy(PAZPAR2_RWLOCK *p);
+void pazpar2_rwlock_rdlock(PAZPAR2_RWLOCK p);
+void pazpar2_rwlock_wrlock(PAZPAR2_RWLOCK p);
+void pazpar2_rwlock_unlock(PAZPAR2_RWLOCK p);
+
 #endif
 
 /*
@@ -0,0 +1,326 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file query_cache.c
+    \brief Server-wide cache of CCL maps and translated queries
+
+    Each client of a search builds a CCL bibset from the pz:cclmap
+    settings of its database, parses the CCL query with it and
+    translates the result to PQF and maybe CQL or Solr. Most databases
+    share identical maps and all clients of a search share the query, so
+    compiled bibsets are shared by a key made of the settings they are
+    built from and translations are cached by map and query.
+
+    Maps are reference counted; a map evicted while in use is freed when
+    released. Both tables are bounded by the same number of entries and
+    evict the least recently used entry.
+*/
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <yaz/xmalloc.h>
+#include <yaz/mutex.h>
+
+#include "ppmutex.h"
+#include "incref.h"
+#include "jenkins_hash.h"
+#include "lru_table.h"
+#include "query_cache.h"
+
+struct query_cache_map {
+    struct lru_node node;
+    CCL_bibset bibset;
+    unsigned id;
+    int cached;
+    volatile int ref_count;
+};
+
+struct query_entry {
+    struct lru_node node;
+    char *value;            /* 0 if translation failed */
+};
+
+struct query_table {
+    lru_table_t lru;
+    unsigned long hits;
+    unsigned long misses;
+};
+
+static YAZ_MUTEX cache_mutex = 0;
+static struct query_table *maps = 0;
+static struct query_table *queries = 0;
+static int max_entries = 0;
+static unsigned next_id = 0;
+
+static struct query_table *table_create(void)
+{
+    struct query_table *t = xmalloc(sizeof(*t));
+    t->lru = lru_table_create();
+    t->hits = t->misses = 0;
+    return t;
+}
+
+static void table_destroy(struct query_table *t)
+{
+    lru_table_destroy(t->lru);
+    xfree(t);
+}
+
+/* finds node and makes it most recent */
+static struct lru_node *table_find(struct query_table *t, const char *key)
+{
+    struct lru_node *n =
+        lru_table_find(t->lru, jenkins_hash((const unsigned char *) key), key);
+    if (n)
+        lru_table_touch(t->lru, n);
+    return n;
+}
+
+/* inserts node with copy of key; returns node evicted or NULL */
+static struct lru_node *table_insert(struct query_table *t,
+                                     struct lru_node *n, const char *key)
+{
+    struct lru_node *victim = 0;
+
+    n->key = xstrdup(key);
+    n->hash = jenkins_hash((const unsigned char *) key);
+    lru_table_insert(t->lru, n);
+    if (lru_table_num(t->lru) > max_entries)
+    {
+        victim = lru_table_tail(t->lru);
+        lru_table_remove(t->lru, victim);
+    }
+    return victim;
+}
+
+static void map_free(struct query_cache_map *m)
+{
+    ccl_qual_rm(&m->bibset);
+    xfree((char *) m->node.key);
+    xfree(m);
+}
+
+static void query_free(struct query_entry *q)
+{
+    xfree(q->value);
+    xfree((char *) q->node.key);
+    xfree(q);
+}
+
+/** \brief enables the cache
+    \param entries maximum number of maps and of queries; 0 disables
+*/
+void query_cache_init(int entries)
+{
+    if (maps || entries <= 0)
+        return;
+    maps = table_create();
+    queries = table_create();
+    max_entries = entries;
+    pazpar2_mutex_create(&cache_mutex, "query_cache");
+}
+
+void query_cache_destroy(void)
+{
+    struct lru_node *n;
+
+    if (!maps)
+        return;
+    while ((n = lru_table_head(maps->lru)))
+    {
+        lru_table_remove(maps->lru, n);
+        query_cache_map_release((struct query_cache_map *) n);
+    }
+    while ((n = lru_table_head(queries->lru)))
+    {
+        lru_table_remove(queries->lru, n);
+        query_free((struct query_entry *) n);
+    }
+    table_destroy(maps);
+    table_destroy(queries);
+    maps = queries = 0;
+    max_entries = 0;
+    yaz_mutex_destroy(&cache_mutex);
+}
+
+/** \brief looks up compiled CCL map
+    \param key settings the map is built from
+    \returns map (to be released with query_cache_map_release) or NULL
+*/
+query_cache_map_t query_cache_map_lookup(const char *key)
+{
+    struct query_cache_map *m;
+
+    if (!maps)
+        return 0;
+    yaz_mutex_enter(cache_mutex);
+    m = (struct query_cache_map *) table_find(maps, key);
+    if (m)
+    {
+        maps->hits++;
+        pazpar2_atomic_add(&m->ref_count, 1);
+    }
+    else
+        maps->misses++;
+    yaz_mutex_leave(cache_mutex);
+    return m;
+}
+
+/** \brief adds compiled CCL map
+    \param key settings the map is built from
+    \param bibset map; owned by the cache from now on
+    \returns map (to be released with query_cache_map_release)
+
+    The map is returned even if the cache is disabled.
+*/
+query_cache_map_t query_cache_map_add(const char *key, CCL_bibset bibset)
+{
+    struct query_cache_map *m = xmalloc(sizeof(*m));
+    struct query_cache_map *victim = 0;
+
+    memset(&m->node, 0, sizeof(m->node));
+    m->bibset = bibset;
+    m->ref_count = 1;
+    m->cached = 0;
+    if (!maps)
+    {
+        m->id = 0;
+        return m;
+    }
+    yaz_mutex_enter(cache_mutex);
+    m->id = ++next_id;
+    if (!table_find(maps, key))
+    {
+        m->cached = 1;
+        m->ref_count++;
+        victim = (struct query_cache_map *)
+            table_insert(maps, &m->node, key);
+    }
+    yaz_mutex_leave(cache_mutex);
+    if (victim)
+        query_cache_map_release(victim);
+    return m;
+}
+
+CCL_bibset query_cache_map_bibset(query_cache_map_t m)
+{
+    return m->bibset;
+}
+
+/** \brief unique id of map; keys translations made with the map.
+    0 for a map that is not cached */
+unsigned query_cache_map_id(query_cache_map_t m)
+{
+    return m->cached ? m->id : 0;
+}
+
+void query_cache_map_release(query_cache_map_t m)
+{
+    if (m && pazpar2_atomic_add(&m->ref_count, -1) == 0)
+        map_free(m);
+}
+
+/** \brief looks up translated query
+    \param key map and query
+    \param w buffer that gets the translation (appended)
+    \retval 1 found; translation in w
+    \retval 0 not in cache
+    \retval -1 found; translation failed
+*/
+int query_cache_lookup(const char *key, WRBUF w)
+{
+    struct query_entry *q;
+    int ret = 0;
+
+    if (!queries)
+        return 0;
+    yaz_mutex_enter(cache_mutex);
+    q = (struct query_entry *) table_find(queries, key);
+    if (q)
+        queries->hits++;
+    else
+        queries->misses++;
+    if (q && q->value)
+    {
+        wrbuf_puts(w, q->value);
+        ret = 1;
+    }
+    else if (q)
+        ret = -1;
+    yaz_mutex_leave(cache_mutex);
+    return ret;
+}
+
+/** \brief adds translated query
+    \param key map and query
+    \param value translation; NULL if translation failed
+*/
+void query_cache_add(const char *key, const char *value)
+{
+    struct query_entry *q, *dup = 0, *victim = 0;
+
+    if (!queries)
+        return;
+    q = xmalloc(sizeof(*q));
+    q->value = value ? xstrdup(value) : 0;
+    yaz_mutex_enter(cache_mutex);
+    if (table_find(queries, key))
+        dup = q; /* added by another thread meanwhile */
+    else
+        victim = (struct query_entry *)
+            table_insert(queries, &q->node, key);
+    yaz_mutex_leave(cache_mutex);
+    if (dup)
+    {
+        xfree(dup->value);
+        xfree(dup);
+    }
+    if (victim)
+        query_free(victim);
+}
+
+void query_cache_get_stat(struct query_cache_stat *stat)
+{
+    memset(stat, 0, sizeof(*stat));
+    if (!maps)
+        return;
+    yaz_mutex_enter(cache_mutex);
+    stat->maps = lru_table_num(maps->lru);
+    stat->queries = lru_table_num(queries->lru);
+    stat->max_entries = max_entries;
+    stat->map_hits = maps->hits;
+    stat->map_misses = maps->misses;
+    stat->query_hits = queries->hits;
+    stat->query_misses = queries->misses;
+    yaz_mutex_leave(cache_mutex);
+}
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -0,0 +1,66 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file query_cache.h
+    \brief Server-wide cache of CCL maps and translated queries
+*/
+
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include <yaz/ccl.h>
+#include <yaz/wrbuf.h>
+
+struct query_cache_stat {
+    int maps;
+    int queries;
+    int max_entries;
+    unsigned long map_hits;
+    unsigned long map_misses;
+    unsigned long query_hits;
+    unsigned long query_misses;
+};
+
+typedef struct query_cache_map *query_cache_map_t;
+
+void query_cache_init(int max_entries);
+void query_cache_destroy(void);
+
+query_cache_map_t query_cache_map_lookup(const char *key);
+query_cache_map_t query_cache_map_add(const char *key, CCL_bibset bibset);
+CCL_bibset query_cache_map_bibset(query_cache_map_t m);
+unsigned query_cache_map_id(query_cache_map_t m);
+void query_cache_map_release(query_cache_map_t m);
+
+int query_cache_lookup(const char *key, WRBUF w);
+void query_cache_add(const char *key, const char *value);
+
+void query_cache_get_stat(struct query_cache_stat *stat);
+
+#endif
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -0,0 +1,221 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file raw_cache.c
+    \brief Server-wide cache of raw records fetched by the record command
+
+    The record command with syntax or esn makes a present request to the
+    target for each call. Records are kept in a bounded LRU cache keyed
+    by target, result set (query, sort and settings), position, syntax,
+    element set and conversion, so the same record shown again, in any
+    session, is answered without contacting the target.
+*/
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <time.h>
+
+#include <yaz/xmalloc.h>
+#include <yaz/mutex.h>
+
+#include "ppmutex.h"
+#include "jenkins_hash.h"
+#include "lru_table.h"
+#include "raw_cache.h"
+
+struct raw_cache_entry {
+    struct lru_node node;  /* key is the key member */
+    char *key;
+    char *buf;
+    size_t len;
+    time_t expires;
+};
+
+static YAZ_MUTEX cache_mutex = 0;
+static lru_table_t table = 0;
+static size_t cache_bytes = 0;
+static size_t max_bytes = 0;
+static int cache_ttl = 0;
+static unsigned long cache_hits = 0;
+static unsigned long cache_misses = 0;
+static unsigned long cache_evictions = 0;
+
+static size_t entry_size(struct raw_cache_entry *e)
+{
+    return sizeof(*e) + strlen(e->key) + 1 + e->len;
+}
+
+/** \brief enables the cache
+    \param max_kbytes memory budget in kilobytes; 0 disables the cache
+    \param ttl seconds a record may be used; 0 disables the cache
+*/
+void raw_cache_init(int max_kbytes, int ttl)
+{
+    if (table || max_kbytes <= 0 || ttl <= 0)
+        return;
+    table = lru_table_create();
+    pazpar2_mutex_create(&cache_mutex, "raw_cache");
+    max_bytes = (size_t) max_kbytes * 1024;
+    cache_ttl = ttl;
+}
+
+static void entry_free(struct raw_cache_entry *e)
+{
+    xfree(e->key);
+    xfree(e->buf);
+    xfree(e);
+}
+
+void raw_cache_destroy(void)
+{
+    struct lru_node *n;
+
+    if (!table)
+        return;
+    while ((n = lru_table_head(table)))
+    {
+        lru_table_remove(table, n);
+        entry_free((struct raw_cache_entry *) n);
+    }
+    lru_table_destroy(table);
+    table = 0;
+    yaz_mutex_destroy(&cache_mutex);
+    cache_bytes = max_bytes = 0;
+    cache_ttl = 0;
+    cache_hits = cache_misses = cache_evictions = 0;
+}
+
+int raw_cache_enabled(void)
+{
+    return table != 0;
+}
+
+/* removes entry; caller holds cache_mutex */
+static void cache_unlink(struct raw_cache_entry *e)
+{
+    lru_table_remove(table, &e->node);
+    cache_bytes -= entry_size(e);
+}
+
+/** \brief looks up record
+    \param key record key
+    \param w buffer that gets the record (appended)
+    \retval 1 found
+    \retval 0 not found
+*/
+int raw_cache_lookup(const char *key, WRBUF w)
+{
+    struct raw_cache_entry *e;
+
+    if (!table)
+        return 0;
+    yaz_mutex_enter(cache_mutex);
+    e = (struct raw_cache_entry *)
+        lru_table_find(table, jenkins_hash((const unsigned char *) key), key);
+    if (e && e->expires <= time(0))
+    {
+        cache_unlink(e);
+        entry_free(e);
+        e = 0;
+    }
+    if (e)
+    {
+        cache_hits++;
+        lru_table_touch(table, &e->node);
+        wrbuf_write(w, e->buf, e->len);
+    }
+    else
+        cache_misses++;
+    yaz_mutex_leave(cache_mutex);
+    return e ? 1 : 0;
+}
+
+/** \brief adds record; an existing record with the same key is replaced
+    \param key record key
+    \param buf record
+    \param len length of record
+*/
+void raw_cache_add(const char *key, const char *buf, size_t len)
+{
+    struct raw_cache_entry *e, *old;
+
+    if (!table || !buf)
+        return;
+    e = xmalloc(sizeof(*e));
+    e->key = xstrdup(key);
+    e->node.key = e->key;
+    e->node.hash = jenkins_hash((const unsigned char *) key);
+    e->buf = xmalloc(len + 1);
+    memcpy(e->buf, buf, len);
+    e->buf[len] = '\0';
+    e->len = len;
+    e->expires = time(0) + cache_ttl;
+    if (entry_size(e) > max_bytes / 4)
+    {
+        entry_free(e);
+        return;
+    }
+    yaz_mutex_enter(cache_mutex);
+    if ((old = (struct raw_cache_entry *)
+         lru_table_find(table, e->node.hash, key)))
+    {
+        cache_unlink(old);
+        entry_free(old);
+    }
+    lru_table_insert(table, &e->node);
+    cache_bytes += entry_size(e);
+    while (cache_bytes > max_bytes)
+    {
+        struct raw_cache_entry *victim =
+            (struct raw_cache_entry *) lru_table_tail(table);
+        cache_unlink(victim);
+        entry_free(victim);
+        cache_evictions++;
+    }
+    yaz_mutex_leave(cache_mutex);
+}
+
+void raw_cache_get_stat(struct raw_cache_stat *stat)
+{
+    memset(stat, 0, sizeof(*stat));
+    if (!table)
+        return;
+    yaz_mutex_enter(cache_mutex);
+    stat->entries = lru_table_num(table);
+    stat->bytes = cache_bytes;
+    stat->max_bytes = max_bytes;
+    stat->ttl = cache_ttl;
+    stat->hits = cache_hits;
+    stat->misses = cache_misses;
+    stat->evictions = cache_evictions;
+    yaz_mutex_leave(cache_mutex);
+}
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -0,0 +1,58 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file raw_cache.h
+    \brief Server-wide cache of raw records fetched by the record command
+*/
+
+#ifndef RAW_CACHE_H
+#define RAW_CACHE_H
+
+#include <stddef.h>
+#include <yaz/wrbuf.h>
+
+struct raw_cache_stat {
+    int entries;
+    size_t bytes;
+    size_t max_bytes;
+    int ttl;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+};
+
+void raw_cache_init(int max_kbytes, int ttl);
+void raw_cache_destroy(void);
+int raw_cache_enabled(void);
+
+int raw_cache_lookup(const char *key, WRBUF w);
+void raw_cache_add(const char *key, const char *buf, size_t len);
+void raw_cache_get_stat(struct raw_cache_stat *stat);
+
+#endif
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -406,16 +406,19 @@ struct record_cluster *reclist_insert(struct reclist *l,
         if (!strcmp(merge_key, (*p)->record->merge_key))
         {
             struct record_cluster *existing = (*p)->record;
-            struct record *re = existing->records;
 
-            for (; re; re = re->next)
+            /* duplicate check: probe by content hash; full comparison
+               only when hashes are equal */
+            if (!existing->record_set)
             {
-                if (re->client == record->client &&
-                    record_compare(record, re, service))
-                {
-                    yaz_mutex_leave(l->mutex);
-                    return 0;
-                }
+                existing->record_set = record_set_create(l->nmem);
+                record_set_insert(existing->record_set, existing->records,
+                                  service);
+            }
+            if (!record_set_insert(existing->record_set, record, service))
+            {
+                yaz_mutex_leave(l->mutex);
+                return 0;
             }
             record->next = existing->records;
             existing->records = record;
@@ -434,6 +437,7 @@ struct record_cluster *reclist_insert(struct reclist *l,
         new->record = cluster;
         new->hash_next = 0;
         cluster->records = record;
+        cluster->record_set = 0;
         cluster->merge_key = nmem_strdup(l->nmem, merge_key);
         cluster->relevance_score = 0;
         cluster->term_frequency_vec = 0;
@@ -444,6 +448,12 @@ struct record_cluster *reclist_insert(struct reclist *l,
                         sizeof(struct record_metadata*) * service->num_metadata);
         memset(cluster->metadata, 0,
                sizeof(struct record_metadata*) * service->num_metadata);
+        cluster->metadata_last =
+            nmem_malloc(l->nmem,
+                        sizeof(struct record_metadata*) * service->num_metadata);
+        memset(cluster->metadata_last, 0,
+               sizeof(struct record_metadata*) * service->num_metadata);
+        cluster->value_sets = 0;
         cluster->sortkeys =
             nmem_malloc(l->nmem, sizeof(struct record_metadata*) * service->num_sortkeys);
         memset(cluster->sortkeys, 0,
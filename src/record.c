@@ -18,6 +18,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
 #include <string.h>
+#include <limits.h>
 
 #include <yaz/yaz-util.h>
 #include <yaz/nmem.h>
@@ -29,6 +30,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "pazpar2_config.h"
 #include "client.h"
 #include "record.h"
+#include "jenkins_hash.h"
 
 union data_types * data_types_assign(NMEM nmem,
                                      union data_types ** data1,
@@ -64,39 +66,144 @@ struct record * record_copy(NMEM nmem, struct record *record)
 }
 
 
-struct record * record_create(NMEM nmem, int num_metadata, int num_sortkeys,
+/* FNV-1a, 64 bit */
+#define CONTENT_HASH_INIT 14695981039346656037ULL
+#define CONTENT_HASH_PRIME 1099511628211ULL
+
+static unsigned long long content_hash_add(unsigned long long h,
+                                           const void *buf, size_t len)
+{
+    const unsigned char *cp = buf;
+    size_t i;
+    for (i = 0; i < len; i++)
+    {
+        h ^= cp[i];
+        h *= CONTENT_HASH_PRIME;
+    }
+    return h;
+}
+
+static unsigned long long record_content_hash(struct record *record,
+                                              struct conf_service *service)
+{
+    unsigned long long h = CONTENT_HASH_INIT;
+    int i;
+
+    for (i = 0; i < service->num_metadata; i++)
+    {
+        int j;
+        /* number of values of each field is part of the hash */
+        int num = record->field_start[i + 1] - record->field_start[i];
+
+        h = content_hash_add(h, &num, sizeof(num));
+        for (j = record->field_start[i]; j < record->field_start[i + 1]; j++)
+        {
+            const union data_types *d = &record->values[j].data;
+            switch (service->metadata[i].type)
+            {
+            case Metadata_type_generic:
+                h = content_hash_add(h, d->text.disp,
+                                     strlen(d->text.disp));
+                break;
+            case Metadata_type_date:
+            case Metadata_type_year:
+                h = content_hash_add(h, &d->number.min,
+                                     sizeof(d->number.min));
+                h = content_hash_add(h, &d->number.max,
+                                     sizeof(d->number.max));
+                break;
+            }
+        }
+    }
+    return h;
+}
+
+/**
+ * Create record in packed form: one block holding the record, its values
+ * and attributes and the offset table by field.
+ *
+ * @param nmem: memory allocator for record
+ * @param service: service with metadata field definitions
+ * @param metadata: value lists, one per field (may be in temporary memory)
+ * @param client: client that record came from
+ * @param position: position in result set (1, 2, ..)
+ */
+struct record * record_create(NMEM nmem, struct conf_service *service,
+                              struct record_metadata **metadata,
                               struct client *client, int position)
 {
+    int num_metadata = service->num_metadata;
     struct record * record = 0;
+    struct record_metadata_attr *attr_p;
     int i = 0;
+    int num_values = 0, num_attrs = 0, num_dropped = 0;
     const char *name = client_get_id(client);
     unsigned h = position;
+    char *blob;
 
-    // assert(nmem);
+    for (i = 0; i < num_metadata; i++)
+    {
+        struct record_metadata *md;
+        for (md = metadata[i]; md; md = md->next)
+        {
+            struct record_metadata_attr *attr;
+            if (num_values == USHRT_MAX)
+            {
+                num_dropped++;
+                continue;
+            }
+            num_values++;
+            for (attr = md->attributes; attr; attr = attr->next)
+                num_attrs++;
+        }
+    }
+    /* offsets are unsigned short; values beyond that are not kept */
+    if (num_dropped)
+        yaz_log(YLOG_WARN, "Record %s #%d: %d metadata values beyond %d "
+                "dropped", name, position, num_dropped, USHRT_MAX);
+    blob = nmem_malloc(nmem, sizeof(*record)
+                       + num_values * sizeof(struct record_value)
+                       + num_attrs * sizeof(struct record_metadata_attr)
+                       + (num_metadata + 1) * sizeof(unsigned short));
+    record = (struct record *) blob;
+    record->values = (struct record_value *) (record + 1);
+    attr_p = (struct record_metadata_attr *) (record->values + num_values);
+    record->field_start = (unsigned short *) (attr_p + num_attrs);
 
-    record = nmem_malloc(nmem, sizeof(struct record));
+    num_values = 0;
+    for (i = 0; i < num_metadata; i++)
+    {
+        struct record_metadata *md;
+        record->field_start[i] = num_values;
+        for (md = metadata[i]; md; md = md->next)
+        {
+            struct record_value *v = record->values + num_values;
+            struct record_metadata_attr *attr, **attrp = &v->attributes;
+            if (num_values == USHRT_MAX)
+                break;
+            v->data = md->data;
+            for (attr = md->attributes; attr; attr = attr->next)
+            {
+                *attr_p = *attr;
+                *attrp = attr_p;
+                attrp = &attr_p->next;
+                attr_p++;
+            }
+            *attrp = 0;
+            num_values++;
+        }
+    }
+    record->field_start[num_metadata] = num_values;
 
     record->next = 0;
     record->client = client;
-
-    record->metadata
-        = nmem_malloc(nmem,
-                      sizeof(struct record_metadata*) * num_metadata);
-    for (i = 0; i < num_metadata; i++)
-        record->metadata[i] = 0;
-
-    record->sortkeys
-        = nmem_malloc(nmem,
-                      sizeof(union data_types*) * num_sortkeys);
-    for (i = 0; i < num_sortkeys; i++)
-        record->sortkeys[i] = 0;
-
     record->position = position;
 
     for (i = 0; name[i]; i++)
         h = h * 65509 + ((unsigned char *) name)[i];
 
     record->checksum = h;
+    record->content_hash = record_content_hash(record, service);
 
     return record;
 }
@@ -115,34 +222,171 @@ int record_compare(struct record *r1, struct record *r2,
                    struct conf_service *service)
 {
     int i;
+    if (r1->content_hash != r2->content_hash)
+        return 0;
     for (i = 0; i < service->num_metadata; i++)
     {
         struct conf_metadata *ser_md = &service->metadata[i];
         enum conf_metadata_type type = ser_md->type;
+        int j1 = r1->field_start[i];
+        int j2 = r2->field_start[i];
 
-        struct record_metadata *m1 = r1->metadata[i];
-        struct record_metadata *m2 = r2->metadata[i];
-        while (m1 && m2)
+        if (r1->field_start[i + 1] - j1 != r2->field_start[i + 1] - j2)
+            return 0;
+        for (; j1 < r1->field_start[i + 1]; j1++, j2++)
         {
+            const union data_types *d1 = &r1->values[j1].data;
+            const union data_types *d2 = &r2->values[j2].data;
             switch (type)
             {
             case Metadata_type_generic:
-                if (strcmp(m1->data.text.disp, m2->data.text.disp))
+                if (d1->text.disp != d2->text.disp &&
+                    strcmp(d1->text.disp, d2->text.disp))
                     return 0;
                 break;
             case Metadata_type_date:
             case Metadata_type_year:
-                if (m1->data.number.min != m2->data.number.min ||
-                    m1->data.number.max != m2->data.number.max)
+                if (d1->number.min != d2->number.min ||
+                    d1->number.max != d2->number.max)
                     return 0;
                 break;
             }
-            m1 = m1->next;
-            m2 = m2->next;
         }
-        if (m1 || m2)
+    }
+    return 1;
+}
+
+/* open addressing hash set of strings, used for unique merging */
+struct record_value_set {
+    NMEM nmem;
+    const char **keys;
+    unsigned *hashes;
+    unsigned size;  /* power of 2 */
+    unsigned num;
+};
+
+struct record_value_set *record_value_set_create(NMEM nmem)
+{
+    struct record_value_set *set = nmem_malloc(nmem, sizeof(*set));
+    set->nmem = nmem;
+    set->size = 16;
+    set->num = 0;
+    set->keys = nmem_malloc(nmem, set->size * sizeof(*set->keys));
+    memset(set->keys, 0, set->size * sizeof(*set->keys));
+    set->hashes = nmem_malloc(nmem, set->size * sizeof(*set->hashes));
+    return set;
+}
+
+static void record_value_set_put(struct record_value_set *set,
+                                 const char *key, unsigned h)
+{
+    unsigned i = h & (set->size - 1);
+    while (set->keys[i])
+        i = (i + 1) & (set->size - 1);
+    set->keys[i] = key;
+    set->hashes[i] = h;
+    set->num++;
+}
+
+/**
+ * Add key to set.
+ *
+ * @param set: value set
+ * @param key: key; must live as long as the set
+ * @returns 1 if key was added; 0 if it was already in set
+ */
+int record_value_set_insert(struct record_value_set *set, const char *key)
+{
+    unsigned h = jenkins_hash((const unsigned char *) key);
+    unsigned i = h & (set->size - 1);
+
+    for (; set->keys[i]; i = (i + 1) & (set->size - 1))
+        if (set->hashes[i] == h &&
+            (set->keys[i] == key || !strcmp(set->keys[i], key)))
             return 0;
+    if (2 * (set->num + 1) > set->size)
+    {   /* grow; old arrays are released with NMEM */
+        const char **old_keys = set->keys;
+        unsigned *old_hashes = set->hashes;
+        unsigned j, old_size = set->size;
+
+        set->size *= 2;
+        set->num = 0;
+        set->keys = nmem_malloc(set->nmem, set->size * sizeof(*set->keys));
+        memset(set->keys, 0, set->size * sizeof(*set->keys));
+        set->hashes = nmem_malloc(set->nmem,
+                                  set->size * sizeof(*set->hashes));
+        for (j = 0; j < old_size; j++)
+            if (old_keys[j])
+                record_value_set_put(set, old_keys[j], old_hashes[j]);
+    }
+    record_value_set_put(set, key, h);
+    return 1;
+}
+
+/* open addressing hash set of records by content hash, used for
+   detecting duplicates within a cluster */
+struct record_set {
+    NMEM nmem;
+    struct record **recs;
+    unsigned size;  /* power of 2 */
+    unsigned num;
+};
+
+struct record_set *record_set_create(NMEM nmem)
+{
+    struct record_set *set = nmem_malloc(nmem, sizeof(*set));
+    set->nmem = nmem;
+    set->size = 8;
+    set->num = 0;
+    set->recs = nmem_malloc(nmem, set->size * sizeof(*set->recs));
+    memset(set->recs, 0, set->size * sizeof(*set->recs));
+    return set;
+}
+
+static void record_set_put(struct record_set *set, struct record *r)
+{
+    unsigned i = (unsigned) r->content_hash & (set->size - 1);
+    while (set->recs[i])
+        i = (i + 1) & (set->size - 1);
+    set->recs[i] = r;
+    set->num++;
+}
+
+/**
+ * Add record to set unless an equal record from same client is there.
+ *
+ * @param set: record set
+ * @param r: record; must live as long as the set
+ * @param service: service with metadata field definitions
+ * @returns 1 if record was added; 0 if it is a duplicate
+ */
+int record_set_insert(struct record_set *set, struct record *r,
+                      struct conf_service *service)
+{
+    unsigned i = (unsigned) r->content_hash & (set->size - 1);
+
+    for (; set->recs[i]; i = (i + 1) & (set->size - 1))
+    {
+        struct record *re = set->recs[i];
+        if (re->content_hash == r->content_hash && re->client == r->client
+            && record_compare(r, re, service))
+            return 0;
+    }
+    if (2 * (set->num + 1) > set->size)
+    {   /* grow; old array is released with NMEM */
+        struct record **old_recs = set->recs;
+        unsigned j, old_size = set->size;
+
+        set->size *= 2;
+        set->num = 0;
+        set->recs = nmem_malloc(set->nmem, set->size * sizeof(*set->recs));
+        memset(set->recs, 0, set->size * sizeof(*set->recs));
+        for (j = 0; j < old_size; j++)
+            if (old_recs[j])
+                record_set_put(set, old_recs[j]);
     }
+    record_set_put(set, r);
     return 1;
 }
 
@@ -37,8 +37,8 @@ union data_types {
 
 
 struct record_metadata_attr {
-    char *name;
-    char *value;
+    const char *name;
+    const char *value;
     struct record_metadata_attr *next;
 };
 
@@ -54,22 +54,31 @@ union data_types * data_types_assign(NMEM nmem,
                                      union data_types data2);
 
 
+/** \brief one metadata value of a packed record */
+struct record_value {
+    union data_types data;
+    struct record_metadata_attr *attributes;
+};
+
 struct record {
     struct client *client;
-    // Array mirrors list of metadata fields in config
-    struct record_metadata **metadata;
-    // Array mirrors list of sortkey fields in config
-    union data_types **sortkeys;
+    // Packed metadata. Values of field i (as listed in config) are
+    // values[field_start[i]] .. values[field_start[i + 1] - 1]
+    struct record_value *values;
+    unsigned short *field_start;
     // Next in cluster of merged records
     struct record *next;
     // client result set position;
     int position;
     // checksum
     unsigned checksum;
+    // hash of metadata values; equal records have equal hashes
+    unsigned long long content_hash;
 };
 
 
-struct record * record_create(NMEM nmem, int num_metadata, int num_sortkeys,
+struct record * record_create(NMEM nmem, struct conf_service *service,
+                              struct record_metadata **metadata,
                               struct client *client, int position);
 
 struct record_metadata * record_metadata_create(NMEM nmem);
@@ -78,10 +87,25 @@ struct record * record_copy(NMEM nmem, struct record *record);
 
 int record_compare(struct record *r1, struct record *r2, struct conf_service *service);
 
+struct record_value_set;
+
+struct record_value_set *record_value_set_create(NMEM nmem);
+int record_value_set_insert(struct record_value_set *set, const char *key);
+
+struct record_set;
+
+struct record_set *record_set_create(NMEM nmem);
+int record_set_insert(struct record_set *set, struct record *r,
+                      struct conf_service *service);
+
 struct record_cluster
 {
     // Array mirrors list of metadata fields in config
     struct record_metadata **metadata;
+    // Last value of each field list, for appending (merge=unique/all)
+    struct record_metadata **metadata_last;
+    // Per field sets of values seen for merge=unique (0 until needed)
+    struct record_value_set **value_sets;
     union data_types **sortkeys;
     char *merge_key;
     int relevance_score;
@@ -92,6 +116,8 @@ struct record_cluster
     WRBUF relevance_explain1;
     WRBUF relevance_explain2;
     struct record *records;
+    // Records by content hash; 0 while cluster has one record
+    struct record_set *record_set;
 };
 
 #endif // RECORD_H
@@ -0,0 +1,410 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file search_cache.c
+    \brief Server-wide cache of search results per target
+
+    Users often repeat a search that another session ran minutes ago
+    (reading lists, popular topics). The cache maps a key made of target,
+    query, sort, range and settings of the target to the hit count,
+    facets, suggestions and normalized records of the target. A client
+    with a matching key ingests from the cache and does not contact the
+    target. Entries expire after a number of seconds and least recently
+    used entries are evicted when the memory budget is exceeded.
+
+    Entries are immutable once added and reference counted, so a client
+    may keep using an entry after it has been evicted.
+
+    If the disk cache is enabled, added entries are also written to disk
+    and a miss in memory is looked up on disk (see disk_cache.c).
+*/
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#include <yaz/xmalloc.h>
+#include <yaz/nmem.h>
+#include <yaz/mutex.h>
+
+#include "ppmutex.h"
+#include "jenkins_hash.h"
+#include "lru_table.h"
+#include "search_cache.h"
+#include "disk_cache.h"
+
+struct search_cache_facet {
+    const char *name;
+    const char *term;
+    int freq;
+};
+
+struct search_cache_entry {
+    struct lru_node node;  /* key is the key member */
+    NMEM nmem;
+    char *key;
+    volatile int ref_count;
+    time_t expires;
+    size_t bytes;
+    Odr_int hits;
+    char *suggestions;
+    int startrecs;
+    int maxrecs;
+    int num_records;
+    char **records;       /* maxrecs slots, by position - startrecs - 1 */
+    int num_facets;
+    int max_facets;
+    struct search_cache_facet *facets;
+    struct search_cache_entry *victim_next;  /* list of removed entries */
+};
+
+static YAZ_MUTEX cache_mutex = 0;
+static lru_table_t table = 0;
+static size_t cache_bytes = 0;
+static size_t max_bytes = 0;
+static int cache_ttl = 0;
+static unsigned long cache_hits = 0;
+static unsigned long cache_misses = 0;
+static unsigned long cache_evictions = 0;
+
+/** \brief enables the cache
+    \param max_kbytes memory budget in kilobytes; 0 disables the cache
+    \param ttl seconds an entry may be used; 0 disables the cache
+*/
+void search_cache_init(int max_kbytes, int ttl)
+{
+    if (table || max_kbytes <= 0 || ttl <= 0)
+        return;
+    table = lru_table_create();
+    pazpar2_mutex_create(&cache_mutex, "search_cache");
+    max_bytes = (size_t) max_kbytes * 1024;
+    cache_ttl = ttl;
+}
+
+void search_cache_destroy(void)
+{
+    struct lru_node *n;
+
+    if (!table)
+        return;
+    while ((n = lru_table_head(table)))
+    {
+        lru_table_remove(table, n);
+        search_cache_entry_destroy((struct search_cache_entry *) n);
+    }
+    lru_table_destroy(table);
+    table = 0;
+    yaz_mutex_destroy(&cache_mutex);
+    cache_bytes = max_bytes = 0;
+    cache_ttl = 0;
+    cache_hits = cache_misses = cache_evictions = 0;
+}
+
+/* removes entry; caller holds cache_mutex and must release the
+   reference of the cache */
+static void cache_unlink(struct search_cache_entry *e)
+{
+    lru_table_remove(table, &e->node);
+    cache_bytes -= e->bytes;
+}
+
+/** \brief looks up result
+    \param key search key
+    \returns entry (to be released with search_cache_entry_destroy)
+    or NULL if there is no valid entry for key
+*/
+static void memory_add(search_cache_entry_t e);
+
+search_cache_entry_t search_cache_lookup(const char *key)
+{
+    struct search_cache_entry *e, *expired = 0;
+
+    if (!table)
+        return disk_cache_lookup(key);
+    yaz_mutex_enter(cache_mutex);
+    e = (struct search_cache_entry *)
+        lru_table_find(table, jenkins_hash((const unsigned char *) key), key);
+    if (e && e->expires <= time(0))
+    {
+        cache_unlink(e);
+        expired = e;
+        e = 0;
+    }
+    if (e)
+    {
+        cache_hits++;
+        lru_table_touch(table, &e->node);
+        pazpar2_atomic_add(&e->ref_count, 1);
+    }
+    else
+        cache_misses++;
+    yaz_mutex_leave(cache_mutex);
+    if (expired)
+        search_cache_entry_destroy(expired);
+    if (!e && (e = disk_cache_lookup(key)))
+        memory_add(e);
+    return e;
+}
+
+/** \brief adds complete result to cache
+    \param e entry; the caller keeps its reference
+
+    An existing entry with the same key is replaced.
+*/
+void search_cache_add(search_cache_entry_t e)
+{
+    memory_add(e);
+    disk_cache_store(e);
+}
+
+static void memory_add(search_cache_entry_t e)
+{
+    struct search_cache_entry *old, *victims = 0;
+
+    if (!table || !e)
+        return;
+    e->bytes = nmem_total(e->nmem);
+    if (e->bytes > max_bytes)
+        return;
+    e->expires = time(0) + cache_ttl;
+
+    yaz_mutex_enter(cache_mutex);
+    if ((old = (struct search_cache_entry *)
+         lru_table_find(table, e->node.hash, e->key)))
+    {
+        if (old == e)
+        {
+            yaz_mutex_leave(cache_mutex);
+            return;
+        }
+        cache_unlink(old);
+        old->victim_next = victims;
+        victims = old;
+    }
+    pazpar2_atomic_add(&e->ref_count, 1);
+    lru_table_insert(table, &e->node);
+    cache_bytes += e->bytes;
+    while (cache_bytes > max_bytes)
+    {
+        struct search_cache_entry *victim =
+            (struct search_cache_entry *) lru_table_tail(table);
+        cache_unlink(victim);
+        cache_evictions++;
+        victim->victim_next = victims;
+        victims = victim;
+    }
+    yaz_mutex_leave(cache_mutex);
+
+    /* entries are freed outside the lock */
+    while (victims)
+    {
+        struct search_cache_entry *v = victims;
+        victims = v->victim_next;
+        search_cache_entry_destroy(v);
+    }
+}
+
+void search_cache_get_stat(struct search_cache_stat *stat)
+{
+    memset(stat, 0, sizeof(*stat));
+    if (!table)
+        return;
+    yaz_mutex_enter(cache_mutex);
+    stat->entries = lru_table_num(table);
+    stat->bytes = cache_bytes;
+    stat->max_bytes = max_bytes;
+    stat->ttl = cache_ttl;
+    stat->hits = cache_hits;
+    stat->misses = cache_misses;
+    stat->evictions = cache_evictions;
+    yaz_mutex_leave(cache_mutex);
+}
+
+/** \brief creates entry to be filled while a target is searched
+    \param key search key
+    \param startrecs offset of first record
+    \param maxrecs maximum number of records
+    \returns entry or NULL if the cache is disabled
+*/
+search_cache_entry_t search_cache_entry_create(const char *key,
+                                               int startrecs, int maxrecs)
+{
+    if (!table && !disk_cache_enabled())
+        return 0;
+    return search_cache_entry_new(key, startrecs, maxrecs);
+}
+
+/** \brief creates entry whether or not the cache is enabled */
+search_cache_entry_t search_cache_entry_new(const char *key,
+                                            int startrecs, int maxrecs)
+{
+    NMEM nmem;
+    struct search_cache_entry *e;
+
+    if (maxrecs < 0)
+        return 0;
+    nmem = nmem_create();
+    e = nmem_malloc(nmem, sizeof(*e));
+    e->nmem = nmem;
+    e->key = nmem_strdup(nmem, key);
+    memset(&e->node, 0, sizeof(e->node));
+    e->node.key = e->key;
+    e->node.hash = jenkins_hash((const unsigned char *) key);
+    e->ref_count = 1;
+    e->expires = 0;
+    e->bytes = 0;
+    e->hits = 0;
+    e->suggestions = 0;
+    e->startrecs = startrecs;
+    e->maxrecs = maxrecs;
+    e->num_records = 0;
+    e->records = nmem_malloc(nmem, sizeof(*e->records) * (maxrecs + 1));
+    memset(e->records, 0, sizeof(*e->records) * (maxrecs + 1));
+    e->num_facets = e->max_facets = 0;
+    e->facets = 0;
+    e->victim_next = 0;
+    return e;
+}
+
+/** \brief releases reference to entry */
+void search_cache_entry_destroy(search_cache_entry_t e)
+{
+    if (e && pazpar2_atomic_add(&e->ref_count, -1) == 0)
+        nmem_destroy(e->nmem);
+}
+
+void search_cache_entry_set_hits(search_cache_entry_t e, Odr_int hits)
+{
+    e->hits = hits;
+}
+
+void search_cache_entry_set_suggestions(search_cache_entry_t e,
+                                        const char *suggestions)
+{
+    e->suggestions = suggestions ? nmem_strdup(e->nmem, suggestions) : 0;
+}
+
+/** \brief stores record
+    \param e entry
+    \param position position of record in result set (first is 1)
+    \param rec normalized record (XML)
+
+    Storing the same position again has no effect.
+*/
+void search_cache_entry_add_record(search_cache_entry_t e, int position,
+                                   const char *rec)
+{
+    int i = position - e->startrecs - 1;
+
+    if (i >= 0 && i < e->maxrecs && !e->records[i])
+    {
+        e->records[i] = nmem_strdup(e->nmem, rec);
+        e->num_records++;
+    }
+}
+
+void search_cache_entry_add_facet(search_cache_entry_t e, const char *name,
+                                  const char *term, int freq)
+{
+    if (e->num_facets == e->max_facets)
+    {
+        struct search_cache_facet *n;
+
+        e->max_facets = e->max_facets ? 2 * e->max_facets : 16;
+        n = nmem_malloc(e->nmem, sizeof(*n) * e->max_facets);
+        if (e->num_facets)
+            memcpy(n, e->facets, sizeof(*n) * e->num_facets);
+        e->facets = n;
+    }
+    e->facets[e->num_facets].name = nmem_strdup(e->nmem, name);
+    e->facets[e->num_facets].term = nmem_strdup(e->nmem, term);
+    e->facets[e->num_facets].freq = freq;
+    e->num_facets++;
+}
+
+const char *search_cache_entry_key(search_cache_entry_t e)
+{
+    return e->key;
+}
+
+int search_cache_entry_startrecs(search_cache_entry_t e)
+{
+    return e->startrecs;
+}
+
+int search_cache_entry_maxrecs(search_cache_entry_t e)
+{
+    return e->maxrecs;
+}
+
+Odr_int search_cache_entry_hits(search_cache_entry_t e)
+{
+    return e->hits;
+}
+
+const char *search_cache_entry_suggestions(search_cache_entry_t e)
+{
+    return e->suggestions;
+}
+
+/** \brief number of records stored. Records of an entry that was added
+    to the cache occupy positions startrecs+1 .. startrecs+num */
+int search_cache_entry_num_records(search_cache_entry_t e)
+{
+    return e->num_records;
+}
+
+/** \brief returns i'th record (0 based) and its position */
+const char *search_cache_entry_record(search_cache_entry_t e, int i,
+                                      int *position)
+{
+    if (i < 0 || i >= e->maxrecs)
+        return 0;
+    *position = e->startrecs + i + 1;
+    return e->records[i];
+}
+
+int search_cache_entry_num_facets(search_cache_entry_t e)
+{
+    return e->num_facets;
+}
+
+/** \brief returns name of i'th facet term; term and frequency in args */
+const char *search_cache_entry_facet(search_cache_entry_t e, int i,
+                                     const char **term, int *freq)
+{
+    *term = e->facets[i].term;
+    *freq = e->facets[i].freq;
+    return e->facets[i].name;
+}
+
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -0,0 +1,85 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file search_cache.h
+    \brief Server-wide cache of search results per target
+*/
+
+#ifndef SEARCH_CACHE_H
+#define SEARCH_CACHE_H
+
+#include <stddef.h>
+#include <yaz/odr.h>
+
+struct search_cache_stat {
+    int entries;
+    size_t bytes;
+    size_t max_bytes;
+    int ttl;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+};
+
+typedef struct search_cache_entry *search_cache_entry_t;
+
+void search_cache_init(int max_kbytes, int ttl);
+void search_cache_destroy(void);
+
+search_cache_entry_t search_cache_lookup(const char *key);
+void search_cache_add(search_cache_entry_t e);
+void search_cache_get_stat(struct search_cache_stat *stat);
+
+search_cache_entry_t search_cache_entry_create(const char *key,
+                                               int startrecs, int maxrecs);
+search_cache_entry_t search_cache_entry_new(const char *key,
+                                            int startrecs, int maxrecs);
+void search_cache_entry_destroy(search_cache_entry_t e);
+void search_cache_entry_set_hits(search_cache_entry_t e, Odr_int hits);
+void search_cache_entry_set_suggestions(search_cache_entry_t e,
+                                        const char *suggestions);
+void search_cache_entry_add_record(search_cache_entry_t e, int position,
+                                   const char *rec);
+void search_cache_entry_add_facet(search_cache_entry_t e, const char *name,
+                                  const char *term, int freq);
+
+const char *search_cache_entry_key(search_cache_entry_t e);
+int search_cache_entry_startrecs(search_cache_entry_t e);
+int search_cache_entry_maxrecs(search_cache_entry_t e);
+Odr_int search_cache_entry_hits(search_cache_entry_t e);
+const char *search_cache_entry_suggestions(search_cache_entry_t e);
+int search_cache_entry_num_records(search_cache_entry_t e);
+const char *search_cache_entry_record(search_cache_entry_t e, int i,
+                                      int *position);
+int search_cache_entry_num_facets(search_cache_entry_t e);
+const char *search_cache_entry_facet(search_cache_entry_t e, int i,
+                                     const char **term, int *freq);
+
+#endif
+
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -149,16 +149,26 @@ static void log_xml_doc(xmlDoc *doc)
     xmlFree(result);
 }
 
+/* exclusive lock for commands and ingest that change the session */
 static void session_enter(struct session *s, const char *caller)
 {
     if (caller)
         session_log(s, YLOG_DEBUG, "Session lock by %s", caller);
-    yaz_mutex_enter(s->session_mutex);
+    pazpar2_rwlock_wrlock(s->session_lock);
+    s->generation++;
+}
+
+/* shared lock for commands that only read the session */
+static void session_enter_ro(struct session *s, const char *caller)
+{
+    if (caller)
+        session_log(s, YLOG_DEBUG, "Session read lock by %s", caller);
+    pazpar2_rwlock_rdlock(s->session_lock);
 }
 
 static void session_leave(struct session *s, const char *caller)
 {
-    yaz_mutex_leave(s->session_mutex);
+    pazpar2_rwlock_unlock(s->session_lock);
     if (caller)
         session_log(s, YLOG_DEBUG, "Session unlock by %s", caller);
 }
@@ -169,8 +179,6 @@ static void session_normalize_facet(struct session *s, const char *type,
                                     WRBUF facet_wrbuf)
 {
     struct conf_service *service = s->service;
-    pp2_charset_token_t prt;
-    const char *facet_component;
     int i;
     const char *icu_chain_id = 0;
 
@@ -179,44 +187,18 @@ static void session_normalize_facet(struct session *s, const char *type,
             icu_chain_id = (service->metadata + i)->facetrule;
     if (!icu_chain_id)
         icu_chain_id = "facet";
-    prt = pp2_charset_token_create(service->charsets, icu_chain_id);
-    if (!prt)
-    {
+    if (pp2_charset_fact_normalize(service->charsets, icu_chain_id, value,
+                                   facet_wrbuf, display_wrbuf))
         yaz_log(YLOG_FATAL, "Unknown ICU chain '%s' for facet of type '%s'",
                 icu_chain_id, type);
-        wrbuf_destroy(facet_wrbuf);
-        wrbuf_destroy(display_wrbuf);
-        return;
-    }
-    pp2_charset_token_first(prt, value, 0);
-    while ((facet_component = pp2_charset_token_next(prt)))
-    {
-        const char *display_component;
-        if (*facet_component)
-        {
-            if (wrbuf_len(facet_wrbuf))
-                wrbuf_puts(facet_wrbuf, " ");
-            wrbuf_puts(facet_wrbuf, facet_component);
-        }
-        display_component = pp2_get_display(prt);
-        if (display_component)
-        {
-            if (wrbuf_len(display_wrbuf))
-                wrbuf_puts(display_wrbuf, " ");
-            wrbuf_puts(display_wrbuf, display_component);
-        }
-    }
-    pp2_charset_token_destroy(prt);
 }
 
-void add_facet(struct session *s, const char *type, const char *value, int count)
+/* adds normalized facet term. Session must be locked */
+static void add_facet_normalized(struct session *s, const char *type,
+                                 const char *display_term,
+                                 const char *norm_term, int count)
 {
-    WRBUF facet_wrbuf = wrbuf_alloc();
-    WRBUF display_wrbuf = wrbuf_alloc();
-
-    session_normalize_facet(s, type, value, display_wrbuf, facet_wrbuf);
-
-    if (wrbuf_len(facet_wrbuf))
+    if (*norm_term)
     {
         int i;
         for (i = 0; i < s->num_termlists; i++)
@@ -227,22 +209,31 @@ void add_facet(struct session *s, const char *type, const char *value, int count
             if (i == SESSION_MAX_TERMLISTS)
             {
                 session_log(s, YLOG_FATAL, "Too many termlists");
-                wrbuf_destroy(facet_wrbuf);
-                wrbuf_destroy(display_wrbuf);
                 return;
             }
 
             s->termlists[i].name = nmem_strdup(s->nmem, type);
-            s->termlists[i].termlist = termlist_create(s->nmem);
+            s->termlists[i].termlist = termlist_create(s->nmem, s->strings);
             s->num_termlists = i + 1;
         }
 
 #if 0
-        session_log(s, YLOG_LOG, "Facets for %s: %s norm:%s (%d)", type, value, wrbuf_cstr(facet_wrbuf), count);
+        session_log(s, YLOG_LOG, "Facets for %s: %s norm:%s (%d)", type, display_term, norm_term, count);
 #endif
-        termlist_insert(s->termlists[i].termlist, wrbuf_cstr(display_wrbuf),
-                        wrbuf_cstr(facet_wrbuf), count);
+        termlist_insert(s->termlists[i].termlist, display_term,
+                        norm_term, count);
     }
+}
+
+void add_facet(struct session *s, const char *type, const char *value, int count)
+{
+    WRBUF facet_wrbuf = wrbuf_alloc();
+    WRBUF display_wrbuf = wrbuf_alloc();
+
+    session_normalize_facet(s, type, value, display_wrbuf, facet_wrbuf);
+    add_facet_normalized(s, type, wrbuf_cstr(display_wrbuf),
+                         wrbuf_cstr(facet_wrbuf), count);
+    session_changed(s, SESSION_GEN_TERMLIST);
     wrbuf_destroy(facet_wrbuf);
     wrbuf_destroy(display_wrbuf);
 }
@@ -253,7 +244,7 @@ static xmlDoc *record_to_xml(struct session *se,
     struct database *db = sdb->database;
     xmlDoc *rdoc = 0;
 
-    rdoc = xmlParseMemory(rec, strlen(rec));
+    rdoc = normalize_record_parse(sdb->map, rec, strlen(rec));
 
     if (!rdoc)
     {
@@ -275,7 +266,7 @@ static xmlDoc *record_to_xml(struct session *se,
 // Add static values from session database settings if applicable
 static void insert_settings_parameters(struct session_database *sdb,
                                        struct conf_service *service,
-                                       char **parms,
+                                       const char **parms,
                                        NMEM nmem)
 {
     int i;
@@ -285,12 +276,11 @@ static void insert_settings_parameters(struct session_database *sdb,
     for (i = 0; i < service->num_metadata; i++)
     {
         struct conf_metadata *md = &service->metadata[i];
-        int setting;
 
         if (md->setting == Metadata_setting_parameter &&
-            (setting = settings_lookup_offset(service, md->name)) >= 0)
+            md->setting_offset >= 0)
         {
-            const char *val = session_setting_oneval(sdb, setting);
+            const char *val = session_setting_oneval(sdb, md->setting_offset);
             if (val && nparms < MAX_XSLT_ARGS)
             {
                 char *buf;
@@ -309,30 +299,46 @@ static void insert_settings_parameters(struct session_database *sdb,
     parms[offset] = 0;
 }
 
-// Add static values from session database settings if applicable
-static void insert_settings_values(struct session_database *sdb, xmlDoc *doc,
-    struct conf_service *service)
+// Static values from session database settings to add to records
+static struct session_postproc *settings_postproc(
+    struct session_database *sdb, struct conf_service *service, NMEM nmem)
 {
+    struct session_postproc *list = 0, **lp = &list;
     int i;
 
     for (i = 0; i < service->num_metadata; i++)
     {
         struct conf_metadata *md = &service->metadata[i];
-        int offset;
 
         if (md->setting == Metadata_setting_postproc &&
-            (offset = settings_lookup_offset(service, md->name)) >= 0)
+            md->setting_offset >= 0)
         {
-            const char *val = session_setting_oneval(sdb, offset);
+            const char *val = session_setting_oneval(sdb, md->setting_offset);
             if (val)
             {
-                xmlNode *r = xmlDocGetRootElement(doc);
-                xmlNode *n = xmlNewTextChild(r, 0, (xmlChar *) "metadata",
-                                             (xmlChar *) val);
-                xmlSetProp(n, (xmlChar *) "type", (xmlChar *) md->name);
+                *lp = nmem_malloc(nmem, sizeof(**lp));
+                (*lp)->type = md->name;
+                (*lp)->value = val;
+                lp = &(*lp)->next;
             }
         }
     }
+    *lp = 0;
+    return list;
+}
+
+// Add static values from session database settings if applicable
+static void insert_settings_values(struct session_postproc *postproc,
+                                   xmlDoc *doc)
+{
+    xmlNode *r = xmlDocGetRootElement(doc);
+
+    for (; postproc; postproc = postproc->next)
+    {
+        xmlNode *n = xmlNewTextChild(r, 0, (xmlChar *) "metadata",
+                                     (xmlChar *) postproc->value);
+        xmlSetProp(n, (xmlChar *) "type", (xmlChar *) postproc->type);
+    }
 }
 
 static xmlDoc *normalize_record(struct session *se,
@@ -340,28 +346,45 @@ static xmlDoc *normalize_record(struct session *se,
                                 struct conf_service *service,
                                 const char *rec, NMEM nmem)
 {
-    xmlDoc *rdoc = record_to_xml(se, sdb, rec);
+    const char *nativesyntax = session_setting_oneval(sdb, PZ_NATIVESYNTAX);
+    const char *parms_buf[MAX_XSLT_ARGS*2+1];
+    const char **parms = sdb->xslt_params;
+    struct session_postproc *postproc = sdb->postproc;
+    xmlDoc *rdoc = 0;
+    int r;
 
-    if (rdoc)
+    if (!parms)
     {
-        char *parms[MAX_XSLT_ARGS*2+1];
-
+        /* settings changed since prepare_map */
+        parms = parms_buf;
         insert_settings_parameters(sdb, service, parms, nmem);
+        postproc = settings_postproc(sdb, service, nmem);
+    }
 
-        if (normalize_record_transform(sdb->map, &rdoc, (const char **)parms))
-        {
-            session_log(se, YLOG_WARN, "Normalize failed");
-        }
-        else
-        {
-            insert_settings_values(sdb, rdoc, service);
+    /* MARC decoded by first step (see client_record_ingest) */
+    if (normalize_record_native(sdb->map, nativesyntax))
+        r = normalize_record_transform_native(sdb->map, rec, strlen(rec),
+                                              nativesyntax, &rdoc, parms);
+    else
+    {
+        rdoc = record_to_xml(se, sdb, rec);
+        if (!rdoc)
+            return 0;
+        r = normalize_record_transform(sdb->map, &rdoc, parms);
+    }
+    if (r)
+    {
+        session_log(se, YLOG_WARN, "Normalize failed");
+    }
+    else
+    {
+        insert_settings_values(postproc, rdoc);
 
-            if (global_parameters.dump_records)
-            {
-                session_log(se, YLOG_LOG, "Normalized record from %s",
-                            sdb->database->id);
-                log_xml_doc(rdoc);
-            }
+        if (global_parameters.dump_records)
+        {
+            session_log(se, YLOG_LOG, "Normalized record from %s",
+                        sdb->database->id);
+            log_xml_doc(rdoc);
         }
     }
     return rdoc;
@@ -407,6 +430,16 @@ const char *session_setting_oneval(struct session_database *db, int offset)
 // setting. However, this is not a realistic use scenario.
 static int prepare_map(struct session *se, struct session_database *sdb)
 {
+    if (sdb->settings && !sdb->xslt_params)
+    {
+        /* values from settings, built once rather than per record */
+        const char **parms = nmem_malloc(se->session_nmem,
+                                         sizeof(*parms) * (MAX_XSLT_ARGS*2+1));
+        insert_settings_parameters(sdb, se->service, parms,
+                                   se->session_nmem);
+        sdb->postproc = settings_postproc(sdb, se->service, se->session_nmem);
+        sdb->xslt_params = parms;
+    }
     if (sdb->settings && !sdb->map)
     {
         const char *s;
@@ -448,66 +481,212 @@ static int prepare_map(struct session *se, struct session_database *sdb)
     return 0;
 }
 
-// called if watch should be removed because http_channel is to be destroyed
+/* HTTP channel of waiter is gone. The entry is looked up by id, since
+   session_alert_watch may have taken it already; whoever unlinks the
+   entry under watch_mutex frees it */
 static void session_watch_cancel(void *data, struct http_channel *c,
                                  void *data2)
 {
-    struct session_watchentry *ent = data;
+    struct session *s = data;
+    unsigned id = (unsigned) (size_t) data2;
+    struct session_watchentry *ent = 0;
+    int i;
 
-    ent->fun = 0;
-    ent->data = 0;
-    ent->obs = 0;
+    yaz_mutex_enter(s->watch_mutex);
+    for (i = 0; !ent && i <= SESSION_WATCH_MAX; i++)
+    {
+        struct session_watchentry **ep;
+        for (ep = &s->watchlist[i]; *ep; ep = &(*ep)->next)
+            if ((*ep)->id == id)
+            {
+                ent = *ep;
+                *ep = ent->next;
+                break;
+            }
+    }
+    yaz_mutex_leave(s->watch_mutex);
+    xfree(ent);
 }
 
-// set watch. Returns 0=OK, -1 if watch is already set
-int session_set_watch(struct session *s, int what,
-                      session_watchfun fun, void *data,
-                      struct http_channel *chan)
+/* milliseconds from arbitrary origin; for watch windows only */
+static long watch_clock_ms(void)
 {
-    int ret;
-    session_enter(s, "session_set_watch");
-    if (s->watchlist[what].fun)
-        ret = -1;
-    else
+#ifdef WIN32
+    return (long) GetTickCount();
+#else
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return (long) (tv.tv_sec % 1000000) * 1000 + tv.tv_usec / 1000;
+#endif
+}
+
+/* arms timer for the watch window that ends first.
+   Must be called with watch_mutex held */
+static void session_watch_rearm(struct session *s)
+{
+    long now = watch_clock_ms();
+    long first = -1;
+    int i;
+
+    if (!s->watch_timer)
+        return;
+    for (i = 0; i <= SESSION_WATCH_MAX; i++)
     {
+        struct session_watchentry *ent;
+        for (ent = s->watchlist[i]; ent; ent = ent->next)
+            if (ent->window_ms)
+            {
+                long left = ent->start_ms + ent->window_ms - now;
+                if (left < 0)
+                    left = 0;
+                if (first == -1 || left < first)
+                    first = left;
+            }
+    }
+    /* one extra millisecond, so the window has surely passed */
+    iochan_setdeadline(s->watch_timer, first == -1 ? -1 : (int) first + 1);
+}
+
+/* watch window ended; release watches that are due */
+static void session_watch_timeout(IOCHAN i, int event)
+{
+    struct session *s = iochan_getdata(i);
+    int what;
 
-        s->watchlist[what].fun = fun;
-        s->watchlist[what].data = data;
-        s->watchlist[what].obs = http_add_observer(chan, &s->watchlist[what],
-                                                   session_watch_cancel);
-        ret = 0;
+    if (!s || !(event & EVENT_TIMEOUT))
+        return;
+    for (what = 0; what <= SESSION_WATCH_MAX; what++)
+        session_alert_watch(s, what);
+    yaz_mutex_enter(s->watch_mutex);
+    session_watch_rearm(s);
+    yaz_mutex_leave(s->watch_mutex);
+}
+
+/* whether watch with thresholds may be released now. no_active and
+   total_records are read by the caller with the session locked */
+static int watch_ready(struct session_watchentry *ent,
+                       int no_active, int total_records)
+{
+    long elapsed;
+
+    if (ent->min_records == 0 && ent->window_ms == 0)
+        return 1;
+    if (no_active == 0)
+        return 1; /* nothing more will come */
+    if (ent->min_records &&
+        total_records - ent->start_records >= ent->min_records)
+        return 1;
+    if (ent->window_ms)
+    {
+        elapsed = watch_clock_ms() - ent->start_ms;
+        if (elapsed < 0 || elapsed >= ent->window_ms)
+            return 1;
     }
+    return 0;
+}
+
+/** \brief set watch
+    \param s session
+    \param what watch type (SESSION_WATCH_..)
+    \param fun function to call when released
+    \param data user data for fun
+    \param chan HTTP channel that waits
+    \param min_records release when this number of records is added
+    \param window_ms release when this number of milliseconds has passed
+    \retval 0 OK
+
+    Any number of waiters may be set for each type.
+    With min_records and window_ms 0, the first alert releases the watch.
+    Otherwise alerts are coalesced until either threshold is reached or
+    no clients are active. Thresholds are checked when alerted, and a
+    timer releases the watch when its window ends.
+*/
+void session_set_watch(struct session *s, int what,
+                      session_watchfun fun, void *data,
+                      struct http_channel *chan,
+                      int min_records, int window_ms)
+{
+    struct session_watchentry *ent = xmalloc(sizeof(*ent));
+    struct session_watchentry **ep;
+
+    ent->fun = fun;
+    ent->data = data;
+    ent->min_records = min_records;
+    ent->window_ms = window_ms;
+    session_enter_ro(s, "session_set_watch");
+    ent->start_records = s->total_records;
     session_leave(s, "session_set_watch");
-    return ret;
+    ent->start_ms = watch_clock_ms();
+    ent->session = s;
+    ent->what = what;
+    ent->next = 0;
+
+    yaz_mutex_enter(s->watch_mutex);
+    ent->id = ++s->watch_id;
+    ent->obs = http_add_observer(chan, s, session_watch_cancel);
+    http_observer_set_data2(ent->obs, (void *) (size_t) ent->id);
+    /* append: waiters are released in the order they came */
+    for (ep = &s->watchlist[what]; *ep; ep = &(*ep)->next)
+        ;
+    *ep = ent;
+    if (window_ms)
+    {
+        if (!s->watch_timer)
+        {
+            s->watch_timer = iochan_create(-1, session_watch_timeout, 0,
+                                           "session_watch_timer");
+            iochan_setdata(s->watch_timer, s);
+            iochan_add(s->service->server->iochan_man, s->watch_timer);
+        }
+        session_watch_rearm(s);
+    }
+    yaz_mutex_leave(s->watch_mutex);
 }
 
 void session_alert_watch(struct session *s, int what)
 {
+    struct session_watchentry *ready = 0, **rp = &ready;
+    struct session_watchentry **ep;
+    int no_active, total_records;
+
     assert(s);
-    session_enter(s, "session_alert_watch");
-    if (s->watchlist[what].fun)
+    /* active client list is swapped and freed with the session locked;
+       take what thresholds need before watch_mutex */
+    session_enter_ro(s, "session_alert_watch");
+    no_active = session_active_clients(s);
+    total_records = s->total_records;
+    session_leave(s, "session_alert_watch");
+
+    yaz_mutex_enter(s->watch_mutex);
+    ep = &s->watchlist[what];
+    while (*ep)
     {
-        /* our watch is no longer associated with http_channel */
-        void *data;
-        session_watchfun fun;
-
-        http_remove_observer(s->watchlist[what].obs);
-        fun  = s->watchlist[what].fun;
-        data = s->watchlist[what].data;
-
-        /* reset watch before fun is invoked - in case fun wants to set
-           it again */
-        s->watchlist[what].fun = 0;
-        s->watchlist[what].data = 0;
-        s->watchlist[what].obs = 0;
+        struct session_watchentry *ent = *ep;
+        if (watch_ready(ent, no_active, total_records))
+        {
+            /* our watch is no longer associated with http_channel */
+            http_remove_observer(ent->obs);
+            *ep = ent->next;
+            ent->next = 0;
+            *rp = ent;
+            rp = &ent->next;
+        }
+        else
+            ep = &ent->next;
+    }
+    yaz_mutex_leave(s->watch_mutex);
 
-        session_leave(s, "session_alert_watch");
+    /* entries are detached before fun is invoked - in case fun wants
+       to set a watch again */
+    while (ready)
+    {
+        struct session_watchentry *ent = ready;
+        ready = ent->next;
         session_log(s, YLOG_DEBUG,
-                    "Alert Watch: %d calling function: %p", what, fun);
-        fun(data);
+                    "Alert Watch: %d calling function: %p", what, ent->fun);
+        ent->fun(ent->data);
+        xfree(ent);
     }
-    else
-        session_leave(s,"session_alert_watch");
 }
 
 //callback for grep_databases
@@ -621,14 +800,40 @@ int session_is_preferred_clients_ready(struct session *s)
     return res == 0;
 }
 
+/** \brief marks part of session as changed
+    \param s session
+    \param what SESSION_GEN_RECLIST, SESSION_GEN_TERMLIST or
+    SESSION_GEN_CLIENTS
+*/
+void session_changed(struct session *s, int what)
+{
+    pazpar2_atomic_add(&s->changes[what], 1);
+}
+
+/** \brief returns generation counter of part of session
+    \param s session
+    \param what SESSION_GEN_RECLIST, SESSION_GEN_TERMLIST or
+    SESSION_GEN_CLIENTS
+    \returns counter; increases on each change, never reset
+*/
+unsigned session_get_changes(struct session *s, int what)
+{
+    return (unsigned) pazpar2_atomic_add(&s->changes[what], 0);
+}
+
 static void session_clear_set(struct session *se, struct reclist_sortparms *sp)
 {
+    int i;
+
+    for (i = 0; i <= SESSION_GEN_MAX; i++)
+        session_changed(se, i);
     reclist_destroy(se->reclist);
     se->reclist = 0;
     if (nmem_total(se->nmem))
         session_log(se, YLOG_DEBUG, "NMEN operation usage %zd",
                     nmem_total(se->nmem));
     nmem_reset(se->nmem);
+    se->strings = string_pool_create(se->nmem);
     se->total_records = se->total_merged = 0;
     se->num_termlists = 0;
 
@@ -712,6 +917,7 @@ static void session_sort_unlocked(struct session *se, struct reclist_sortparms *
         }
 
     }
+    session_publish(se);
 }
 
 void session_sort(struct session *se, struct reclist_sortparms *sp) {
@@ -801,6 +1007,7 @@ enum pazpar2_error_code session_search(struct session *se,
         }
     }
     session_reset_active_clients(se, l0);
+    session_publish(se);
 
     if (no_working == 0)
     {
@@ -831,6 +1038,8 @@ static void session_init_databases_fun(void *context, struct database *db)
     new->database = db;
 
     new->map = 0;
+    new->xslt_params = 0;
+    new->postproc = 0;
     assert(db->settings);
     new->settings = nmem_malloc(se->session_nmem,
                                 sizeof(struct settings *) * db->num_settings);
@@ -848,6 +1057,8 @@ static void session_init_databases_fun(void *context, struct database *db)
 static void session_database_destroy(struct session_database *sdb)
 {
     sdb->map = 0;
+    sdb->xslt_params = 0;
+    sdb->postproc = 0;
 }
 
 // Initialize session_database list -- this represents this session's view
@@ -901,6 +1112,8 @@ void session_apply_setting(struct session *se, char *dbname, char *setting,
     sdb->settings[offset] = new;
 
     se->settings_modified = 1;
+    session_changed(se, SESSION_GEN_CLIENTS);
+    sdb->xslt_params = 0;
 
     // Force later recompute of settings-driven data structures
     // (happens when a search starts and client connections are prepared)
@@ -915,13 +1128,32 @@ void session_apply_setting(struct session *se, char *dbname, char *setting,
     }
 }
 
+static void snapshot_release(struct session_snapshot *snap);
+
 void session_destroy(struct session *se)
 {
     struct session_database *sdb;
+    int i;
     session_log(se, YLOG_DEBUG, "Destroying");
     session_use(-1);
     session_remove_cached_clients(se);
 
+    /* waiters still blocked are dropped; their channels no longer
+       refer to this session */
+    for (i = 0; i <= SESSION_WATCH_MAX; i++)
+        while (se->watchlist[i])
+        {
+            struct session_watchentry *ent = se->watchlist[i];
+            se->watchlist[i] = ent->next;
+            http_remove_observer(ent->obs);
+            xfree(ent);
+        }
+    if (se->watch_timer)
+    {
+        iochan_setdata(se->watch_timer, 0);
+        iochan_destroy(se->watch_timer);
+    }
+
     for (sdb = se->databases; sdb; sdb = sdb->next)
         session_database_destroy(sdb);
     normalize_cache_destroy(se->normalize_cache);
@@ -934,14 +1166,30 @@ void session_destroy(struct session *se)
     facet_limits_destroy(se->facet_limits);
     nmem_destroy(se->nmem);
     service_destroy(se->service);
-    yaz_mutex_destroy(&se->session_mutex);
+    snapshot_release(se->snapshot);
+    yaz_mutex_destroy(&se->snapshot_mutex);
+    yaz_mutex_destroy(&se->publish_mutex);
+    yaz_mutex_destroy(&se->watch_mutex);
+    yaz_mutex_destroy(&se->view_mutex);
+    pazpar2_rwlock_destroy(&se->session_lock);
+}
+
+void session_get_string_pool_status(struct session *session,
+                                    size_t *unique_bytes, size_t *saved_bytes)
+{
+    *unique_bytes = *saved_bytes = 0;
+    if (session == 0)
+        return;
+    session_enter_ro(session, "session_get_string_pool_status");
+    string_pool_stat(session->strings, unique_bytes, saved_bytes);
+    session_leave(session, "session_get_string_pool_status");
 }
 
 size_t session_get_memory_status(struct session *session) {
     size_t session_nmem;
     if (session == 0)
         return 0;
-    session_enter(session, "session_get_memory_status");
+    session_enter_ro(session, "session_get_memory_status");
     session_nmem = nmem_total(session->nmem);
     session_leave(session, "session_get_memory_status");
     return session_nmem;
@@ -972,18 +1220,32 @@ struct session *new_session(NMEM nmem, struct conf_service *service,
     session->settings_modified = 0;
     session->session_nmem = nmem;
     session->nmem = nmem_create();
+    session->strings = string_pool_create(session->nmem);
     session->databases = 0;
     session->sorted_results = 0;
     session->facet_limits = 0;
 
     for (i = 0; i <= SESSION_WATCH_MAX; i++)
     {
-        session->watchlist[i].data = 0;
-        session->watchlist[i].fun = 0;
+        session->watchlist[i] = 0;
     }
     session->normalize_cache = normalize_cache_create();
-    session->session_mutex = 0;
-    pazpar2_mutex_create(&session->session_mutex, tmp_str);
+    pazpar2_rwlock_create(&session->session_lock, tmp_str);
+    session->view_mutex = 0;
+    pazpar2_mutex_create(&session->view_mutex, "session_view");
+    session->watch_mutex = 0;
+    pazpar2_mutex_create(&session->watch_mutex, "session_watch");
+    session->watch_timer = 0;
+    session->watch_id = 0;
+    session->generation = 1;
+    session->relevance_generation = 0;
+    for (i = 0; i <= SESSION_GEN_MAX; i++)
+        session->changes[i] = 0;
+    session->snapshot = 0;
+    session->snapshot_mutex = 0;
+    pazpar2_mutex_create(&session->snapshot_mutex, "session_snapshot");
+    session->publish_mutex = 0;
+    pazpar2_mutex_create(&session->publish_mutex, "session_publish");
     session_use(1);
     return session;
 }
@@ -991,7 +1253,8 @@ struct session *new_session(NMEM nmem, struct conf_service *service,
 const char * client_get_suggestions_xml(struct client *cl, WRBUF wrbuf);
 
 static struct hitsbytarget *hitsbytarget_nb(struct session *se,
-                                            int *count, NMEM nmem)
+                                            int *count, NMEM nmem,
+                                            int with_settings)
 {
     struct hitsbytarget *res = 0;
     struct client_list *l;
@@ -1020,9 +1283,13 @@ static struct hitsbytarget *hitsbytarget_nb(struct session *se,
                                   &res[*count].addinfo);
         res[*count].state = client_get_state_str(cl);
         res[*count].connected  = client_get_connection(cl) ? 1 : 0;
-        session_settings_dump(se, client_get_database(cl), w);
-        res[*count].settings_xml = nmem_strdup(nmem, wrbuf_cstr(w));
-        wrbuf_rewind(w);
+        res[*count].settings_xml = 0;
+        if (with_settings)
+        {
+            session_settings_dump(se, client_get_database(cl), w);
+            res[*count].settings_xml = nmem_strdup(nmem, wrbuf_cstr(w));
+            wrbuf_rewind(w);
+        }
         wrbuf_puts(w, "");
         res[*count].suggestions_xml = nmem_strdup(nmem, client_get_suggestions_xml(cl, w));
         wrbuf_destroy(w);
@@ -1031,11 +1298,182 @@ static struct hitsbytarget *hitsbytarget_nb(struct session *se,
     return res;
 }
 
-struct hitsbytarget *get_hitsbytarget(struct session *se, int *count, NMEM nmem)
+static const char *snapshot_strdup(NMEM nmem, const char *s)
+{
+    return s ? nmem_strdup(nmem, s) : 0;
+}
+
+/* deep copy of hitsbytarget array (strings owned by clients included) */
+static struct hitsbytarget *hitsbytarget_dup(NMEM nmem,
+                                             const struct hitsbytarget *src,
+                                             int count)
+{
+    struct hitsbytarget *res = nmem_malloc(nmem, sizeof(*res) * count);
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        res[i] = src[i];
+        res[i].id = snapshot_strdup(nmem, src[i].id);
+        res[i].name = snapshot_strdup(nmem, src[i].name);
+        res[i].message = snapshot_strdup(nmem, src[i].message);
+        res[i].addinfo = snapshot_strdup(nmem, src[i].addinfo);
+        res[i].state = snapshot_strdup(nmem, src[i].state);
+        res[i].settings_xml = (char *) snapshot_strdup(nmem,
+                                                       src[i].settings_xml);
+        res[i].suggestions_xml = (char *) snapshot_strdup(nmem,
+                                                          src[i].suggestions_xml);
+    }
+    return res;
+}
+
+static void statistics_nb(struct session *se, struct statistics *stat);
+
+/* published state of a session. Never modified once published; freed
+   when the last reference is released */
+struct session_snapshot {
+    NMEM nmem;
+    volatile int refcount;
+    unsigned changes[SESSION_GEN_MAX + 1]; /* counters it reflects */
+    struct statistics stat;
+    int num_targets;
+    struct hitsbytarget *targets;
+    int num_termlists;
+    struct {
+        const char *name;
+        int len;  /* number of terms in termlist */
+        int num;  /* number of terms kept (highest frequency first) */
+        struct termlist_score *terms;
+    } termlists[SESSION_MAX_TERMLISTS];
+};
+
+static void snapshot_release(struct session_snapshot *snap)
+{
+    if (snap && pazpar2_atomic_add(&snap->refcount, -1) == 0)
+        nmem_destroy(snap->nmem);
+}
+
+static struct session_snapshot *snapshot_latest(struct session *se)
+{
+    struct session_snapshot *snap;
+    yaz_mutex_enter(se->snapshot_mutex);
+    snap = se->snapshot;
+    if (snap)
+        pazpar2_atomic_add(&snap->refcount, 1);
+    yaz_mutex_leave(se->snapshot_mutex);
+    return snap;
+}
+
+/* whether session changed since snapshot was made.
+   gens is bit mask of SESSION_GEN_.. to compare */
+static int snapshot_lags(struct session *se, struct session_snapshot *snap,
+                         int gens)
+{
+    int i;
+    for (i = 0; i <= SESSION_GEN_MAX; i++)
+        if ((gens & (1 << i)) && snap->changes[i] != session_get_changes(se, i))
+            return 1;
+    return 0;
+}
+
+/* returns snapshot (0 if none was published yet) with a reference held.
+   Snapshots are published by the writers, so while clients are active
+   a snapshot may be slightly behind. Once the session is idle, a
+   snapshot that lags in the counters of gens (bit mask of
+   SESSION_GEN_..) is made again, so the final state is never hidden.
+   Must be called without session lock held */
+static struct session_snapshot *snapshot_get(struct session *se, int gens)
+{
+    struct session_snapshot *snap = snapshot_latest(se);
+
+    if (snap && snapshot_lags(se, snap, gens))
+    {
+        int no_active;
+
+        session_enter_ro(se, "snapshot_get");
+        no_active = session_active_clients(se);
+        session_leave(se, "snapshot_get");
+        if (no_active == 0)
+        {
+            snapshot_release(snap);
+            session_publish(se);
+            snap = snapshot_latest(se);
+        }
+    }
+    return snap;
+}
+
+/* make a snapshot of statistics, targets and facets for readers that
+   must not wait for ingest. Must be called without session lock held */
+void session_publish(struct session *se)
+{
+    NMEM nmem = nmem_create();
+    NMEM nmem_tmp = nmem_create();
+    struct session_snapshot *snap = nmem_malloc(nmem, sizeof(*snap));
+    struct session_snapshot *old;
+    struct hitsbytarget *ht;
+    int i;
+
+    snap->nmem = nmem;
+    snap->refcount = 1; /* reference held by session */
+
+    yaz_mutex_enter(se->publish_mutex);
+    session_enter_ro(se, "session_publish");
+    /* counters are read before the state they cover, so a change made
+       while publishing makes the snapshot lag rather than hiding it */
+    for (i = 0; i <= SESSION_GEN_MAX; i++)
+        snap->changes[i] = session_get_changes(se, i);
+    statistics_nb(se, &snap->stat);
+    ht = hitsbytarget_nb(se, &snap->num_targets, nmem_tmp, 0);
+    snap->targets = hitsbytarget_dup(nmem, ht, snap->num_targets);
+    snap->num_termlists = se->num_termlists;
+    for (i = 0; i < se->num_termlists; i++)
+    {
+        int j, len;
+        struct termlist_score **p =
+            termlist_highscore(se->termlists[i].termlist, &len, nmem_tmp);
+        snap->termlists[i].name = nmem_strdup(nmem, se->termlists[i].name);
+        snap->termlists[i].len = len;
+        if (len > SESSION_SNAPSHOT_TERMS)
+            len = SESSION_SNAPSHOT_TERMS;
+        snap->termlists[i].num = len;
+        snap->termlists[i].terms =
+            nmem_malloc(nmem, sizeof(struct termlist_score) * (len + 1));
+        for (j = 0; j < len; j++)
+        {
+            snap->termlists[i].terms[j].norm_term = 0;
+            snap->termlists[i].terms[j].display_term =
+                snapshot_strdup(nmem, p[j]->display_term);
+            snap->termlists[i].terms[j].frequency = p[j]->frequency;
+        }
+    }
+    session_leave(se, "session_publish");
+
+    yaz_mutex_enter(se->snapshot_mutex);
+    old = se->snapshot;
+    se->snapshot = snap;
+    yaz_mutex_leave(se->snapshot_mutex);
+    yaz_mutex_leave(se->publish_mutex);
+
+    snapshot_release(old);
+    nmem_destroy(nmem_tmp);
+}
+
+struct hitsbytarget *get_hitsbytarget(struct session *se, int with_settings,
+                                      int *count, NMEM nmem)
 {
     struct hitsbytarget *p;
-    session_enter(se, "get_hitsbytarget");
-    p = hitsbytarget_nb(se, count, nmem);
+    struct session_snapshot *snap;
+
+    if (!with_settings &&
+        (snap = snapshot_get(se, 1 << SESSION_GEN_CLIENTS)))
+    {
+        *count = snap->num_targets;
+        p = hitsbytarget_dup(nmem, snap->targets, snap->num_targets);
+        snapshot_release(snap);
+        return p;
+    }
+    session_enter_ro(se, "get_hitsbytarget");
+    p = hitsbytarget_nb(se, count, nmem, with_settings);
     session_leave(se, "get_hitsbytarget");
     return p;
 }
@@ -1056,13 +1494,11 @@ static int cmp_ht_approx(const void *p1, const void *p2)
     return h2->approximation - h1->approximation;
 }
 
-static int targets_termlist_nb(WRBUF wrbuf, struct session *se, int num,
-                               NMEM nmem, int version)
+static int targets_termlist_nb(WRBUF wrbuf, struct hitsbytarget *ht,
+                               int count, int num, int version)
 {
-    struct hitsbytarget *ht;
-    int count, i;
+    int i;
 
-    ht = hitsbytarget_nb(se, &count, nmem);
     if (version >= 2)
         qsort(ht, count, sizeof(struct hitsbytarget), cmp_ht_approx);
     else
@@ -1106,6 +1542,88 @@ static int targets_termlist_nb(WRBUF wrbuf, struct session *se, int num,
     return count;
 }
 
+static void termlist_write_terms(WRBUF wrbuf, struct termlist_score **p,
+                                 int len, int num)
+{
+    int i;
+    for (i = 0; i < len && i < num; i++)
+    {
+        // prevent sending empty term elements
+        if (!p[i]->display_term || !p[i]->display_term[0])
+            continue;
+
+        wrbuf_puts(wrbuf, "<term>");
+        wrbuf_puts(wrbuf, "<name>");
+        wrbuf_xmlputs(wrbuf, p[i]->display_term);
+        wrbuf_puts(wrbuf, "</name>");
+
+        wrbuf_printf(wrbuf, "<frequency>%d</frequency>", p[i]->frequency);
+        wrbuf_puts(wrbuf, "</term>\n");
+    }
+}
+
+static void list_open(WRBUF wrbuf, const char *tname)
+{
+    wrbuf_puts(wrbuf, "<list name=\"");
+    wrbuf_xmlputs(wrbuf, tname);
+    wrbuf_puts(wrbuf, "\">\n");
+}
+
+/* termlist from snapshot. Returns 0 if OK; -1 if snapshot can't be used */
+static int perform_termlist_snapshot(struct http_channel *c,
+                                     struct session_snapshot *snap,
+                                     char **names, int num_names,
+                                     int num, int version, NMEM nmem_tmp)
+{
+    int i, j;
+
+    for (i = 0; i < snap->num_termlists; i++)
+        if (num > snap->termlists[i].num &&
+            snap->termlists[i].len > snap->termlists[i].num)
+            return -1; /* more terms requested than kept */
+    for (j = 0; j < num_names; j++)
+    {
+        const char *tname;
+        int must_generate_empty = 1; /* bug 5350 */
+
+        for (i = 0; i < snap->num_termlists; i++)
+        {
+            tname = snap->termlists[i].name;
+            if (!strcmp(names[j], tname) || !strcmp(names[j], "*"))
+            {
+                int k, len = snap->termlists[i].num;
+                struct termlist_score **p =
+                    nmem_malloc(nmem_tmp, sizeof(*p) * (len + 1));
+                for (k = 0; k < len; k++)
+                    p[k] = snap->termlists[i].terms + k;
+                list_open(c->wrbuf, tname);
+                must_generate_empty = 0;
+                termlist_write_terms(c->wrbuf, p, len, num);
+                wrbuf_puts(c->wrbuf, "</list>\n");
+            }
+        }
+        tname = "xtargets";
+        if (!strcmp(names[j], tname) || !strcmp(names[j], "*"))
+        {
+            /* sorted in place, so work on a copy */
+            struct hitsbytarget *ht =
+                hitsbytarget_dup(nmem_tmp, snap->targets, snap->num_targets);
+            list_open(c->wrbuf, tname);
+            targets_termlist_nb(c->wrbuf, ht, snap->num_targets, num,
+                                version);
+            wrbuf_puts(c->wrbuf, "</list>\n");
+            must_generate_empty = 0;
+        }
+        if (must_generate_empty)
+        {
+            wrbuf_puts(c->wrbuf, "<list name=\"");
+            wrbuf_xmlputs(c->wrbuf, names[j]);
+            wrbuf_puts(c->wrbuf, "\"/>\n");
+        }
+    }
+    return 0;
+}
+
 void perform_termlist(struct http_channel *c, struct session *se,
                       const char *name, int num, int version)
 {
@@ -1113,13 +1631,27 @@ void perform_termlist(struct http_channel *c, struct session *se,
     NMEM nmem_tmp = nmem_create();
     char **names;
     int num_names = 0;
+    struct session_snapshot *snap;
 
     if (!name)
         name = "*";
 
     nmem_strsplit(nmem_tmp, ",", name, &names, &num_names);
 
-    session_enter(se, "perform_termlist");
+    if ((snap = snapshot_get(se, (1 << SESSION_GEN_TERMLIST) |
+                             (1 << SESSION_GEN_CLIENTS))))
+    {
+        int r = perform_termlist_snapshot(c, snap, names, num_names,
+                                          num, version, nmem_tmp);
+        snapshot_release(snap);
+        if (r == 0)
+        {
+            nmem_destroy(nmem_tmp);
+            return;
+        }
+    }
+
+    session_enter_ro(se, "perform_termlist");
 
     for (j = 0; j < num_names; j++)
     {
@@ -1134,44 +1666,24 @@ void perform_termlist(struct http_channel *c, struct session *se,
                 struct termlist_score **p = 0;
                 int len;
 
-                wrbuf_puts(c->wrbuf, "<list name=\"");
-                wrbuf_xmlputs(c->wrbuf, tname);
-                wrbuf_puts(c->wrbuf, "\">\n");
+                list_open(c->wrbuf, tname);
                 must_generate_empty = 0;
 
                 p = termlist_highscore(se->termlists[i].termlist, &len,
                                        nmem_tmp);
                 if (p)
-                {
-                    int i;
-                    for (i = 0; i < len && i < num; i++)
-                    {
-                        // prevent sending empty term elements
-                        if (!p[i]->display_term || !p[i]->display_term[0])
-                            continue;
-
-                        wrbuf_puts(c->wrbuf, "<term>");
-                        wrbuf_puts(c->wrbuf, "<name>");
-                        wrbuf_xmlputs(c->wrbuf, p[i]->display_term);
-                        wrbuf_puts(c->wrbuf, "</name>");
-
-                        wrbuf_printf(c->wrbuf,
-                                     "<frequency>%d</frequency>",
-                                     p[i]->frequency);
-                        wrbuf_puts(c->wrbuf, "</term>\n");
-                    }
-                }
+                    termlist_write_terms(c->wrbuf, p, len, num);
                 wrbuf_puts(c->wrbuf, "</list>\n");
             }
         }
         tname = "xtargets";
         if (!strcmp(names[j], tname) || !strcmp(names[j], "*"))
         {
-            wrbuf_puts(c->wrbuf, "<list name=\"");
-            wrbuf_xmlputs(c->wrbuf, tname);
-            wrbuf_puts(c->wrbuf, "\">\n");
+            int count;
+            struct hitsbytarget *ht = hitsbytarget_nb(se, &count, c->nmem, 0);
 
-            targets_termlist_nb(c->wrbuf, se, num, c->nmem, version);
+            list_open(c->wrbuf, tname);
+            targets_termlist_nb(c->wrbuf, ht, count, num, version);
             wrbuf_puts(c->wrbuf, "</list>\n");
             must_generate_empty = 0;
         }
@@ -1205,11 +1717,12 @@ struct record_cluster *show_single_start(struct session *se, const char *id,
 {
     struct record_cluster *r = 0;
 
-    session_enter(se, "show_single_start");
+    session_enter_ro(se, "show_single_start");
     *prev_r = 0;
     *next_r = 0;
     if (se->reclist)
     {
+        yaz_mutex_enter(se->view_mutex);
         reclist_limit(se->reclist, se);
 
         reclist_enter(se->reclist);
@@ -1223,6 +1736,7 @@ struct record_cluster *show_single_start(struct session *se, const char *id,
             *prev_r = r;
         }
         reclist_leave(se->reclist);
+        yaz_mutex_leave(se->view_mutex);
     }
     if (!r)
         session_leave(se, "show_single_start");
@@ -1235,7 +1749,7 @@ void show_single_stop(struct session *se, struct record_cluster *rec)
 }
 
 
-struct record_cluster **show_range_start(struct session *se,
+struct record_cluster **show_range_start(struct session *se, NMEM nmem,
                                          struct reclist_sortparms *sp,
                                          int start, int *num, int *total, Odr_int *sumhits, Odr_int *approx_hits)
 {
@@ -1245,8 +1759,8 @@ struct record_cluster **show_range_start(struct session *se,
 #if USE_TIMING
     yaz_timing_t t = yaz_timing_create();
 #endif
-    session_enter(se, "show_range_start");
-    recs = nmem_malloc(se->nmem, *num * sizeof(struct record_cluster *));
+    session_enter_ro(se, "show_range_start");
+    recs = nmem_malloc(nmem, *num * sizeof(struct record_cluster *));
     if (!se->relevance)
     {
         *num = 0;
@@ -1259,12 +1773,21 @@ struct record_cluster **show_range_start(struct session *se,
     {
         struct client_list *l;
 
+        /* other readers may run concurrently; the sorted list of reclist
+           is shared, so limit, sort and read it in one go */
+        yaz_mutex_enter(se->view_mutex);
         reclist_limit(se->reclist, se);
 
         for (spp = sp; spp; spp = spp->next)
             if (spp->type == Metadata_sortkey_relevance)
             {
-                relevance_prepare_read(se->relevance, se->reclist);
+                /* scores (and explain buffers) only change with ingest;
+                   don't rewrite them while another reader prints them */
+                if (se->relevance_generation != se->generation)
+                {
+                    relevance_prepare_read(se->relevance, se->reclist);
+                    se->relevance_generation = se->generation;
+                }
                 break;
             }
         reclist_sort(se->reclist, sp);
@@ -1297,6 +1820,7 @@ struct record_cluster **show_range_start(struct session *se,
             recs[i] = r;
         }
         reclist_leave(se->reclist);
+        yaz_mutex_leave(se->view_mutex);
     }
 #if USE_TIMING
     yaz_timing_stop(t);
@@ -1314,6 +1838,22 @@ void show_range_stop(struct session *se, struct record_cluster **recs)
 }
 
 void statistics(struct session *se, struct statistics *stat)
+{
+    struct session_snapshot *snap =
+        snapshot_get(se, (1 << SESSION_GEN_RECLIST) |
+                     (1 << SESSION_GEN_CLIENTS));
+    if (snap)
+    {
+        *stat = snap->stat;
+        snapshot_release(snap);
+        return;
+    }
+    session_enter_ro(se, "statistics");
+    statistics_nb(se, stat);
+    session_leave(se, "statistics");
+}
+
+static void statistics_nb(struct session *se, struct statistics *stat)
 {
     struct client_list *l;
     int count = 0;
@@ -1342,6 +1882,7 @@ void statistics(struct session *se, struct statistics *stat)
     stat->num_clients = count;
 }
 
+/* strings are allocated in nmem; see record_metadata_intern */
 static struct record_metadata *record_metadata_init(
     NMEM nmem, const char *value, enum conf_metadata_type type,
     struct _xmlAttr *attr)
@@ -1370,12 +1911,12 @@ static struct record_metadata *record_metadata_init(
 
     if (type == Metadata_type_generic)
     {
-        char *p = nmem_strdup(nmem, value);
-
-        p = normalize7bit_generic(p, " ,/.:([");
+        char *tmp = xstrdup(value);
+        char *p = normalize7bit_generic(tmp, " ,/.:([");
 
-        rec_md->data.text.disp = p;
+        rec_md->data.text.disp = nmem_strdup(nmem, p);
         rec_md->data.text.sort = 0;
+        xfree(tmp);
     }
     else if (type == Metadata_type_year || type == Metadata_type_date)
     {
@@ -1395,13 +1936,37 @@ static struct record_metadata *record_metadata_init(
     return rec_md;
 }
 
-static int get_mergekey_from_doc(xmlDoc *doc, xmlNode *root, const char *name,
-                                 struct conf_service *service, WRBUF norm_wr)
+/* copy of metadata with strings interned, owned by session. The
+   original is left intact so that a prepared record may be merged again */
+static struct record_metadata *record_metadata_intern(
+    string_pool_t strings, NMEM nmem, const struct record_metadata *md,
+    enum conf_metadata_type type)
 {
-    xmlNode *n;
-    int no_found = 0;
-    for (n = root->children; n; n = n->next)
-    {
+    struct record_metadata *rec_md = record_metadata_create(nmem);
+    struct record_metadata_attr *attr, **attrp = &rec_md->attributes;
+
+    rec_md->data = md->data;
+    for (attr = md->attributes; attr; attr = attr->next)
+    {
+        *attrp = nmem_malloc(nmem, sizeof(**attrp));
+        (*attrp)->name = string_pool_intern(strings, attr->name);
+        (*attrp)->value = string_pool_intern(strings, attr->value);
+        attrp = &(*attrp)->next;
+    }
+    *attrp = 0;
+    if (type == Metadata_type_generic)
+        rec_md->data.text.disp = string_pool_intern(strings,
+                                                    md->data.text.disp);
+    return rec_md;
+}
+
+static int get_mergekey_from_doc(xmlDoc *doc, xmlNode *root, const char *name,
+                                 struct conf_service *service, WRBUF norm_wr)
+{
+    xmlNode *n;
+    int no_found = 0;
+    for (n = root->children; n; n = n->next)
+    {
         if (n->type != XML_ELEMENT_NODE)
             continue;
         if (!strcmp((const char *) n->name, "metadata"))
@@ -1415,25 +1980,21 @@ static int get_mergekey_from_doc(xmlDoc *doc, xmlNode *root, const char *name,
                 xmlChar *value = xmlNodeListGetString(doc, n->children, 1);
                 if (value)
                 {
-                    const char *norm_str;
-                    pp2_charset_token_t prt =
-                        pp2_charset_token_create(service->charsets, "mergekey");
+                    WRBUF value_wr = wrbuf_alloc();
 
-                    pp2_charset_token_first(prt, (const char *) value, 0);
+                    pp2_charset_fact_normalize(service->charsets, "mergekey",
+                                               (const char *) value,
+                                               value_wr, 0);
                     if (wrbuf_len(norm_wr) > 0)
                         wrbuf_puts(norm_wr, " ");
                     wrbuf_puts(norm_wr, name);
-                    while ((norm_str =
-                            pp2_charset_token_next(prt)))
+                    if (wrbuf_len(value_wr))
                     {
-                        if (*norm_str)
-                        {
-                            wrbuf_puts(norm_wr, " ");
-                            wrbuf_puts(norm_wr, norm_str);
-                        }
+                        wrbuf_puts(norm_wr, " ");
+                        wrbuf_puts(norm_wr, wrbuf_cstr(value_wr));
                     }
+                    wrbuf_destroy(value_wr);
                     xmlFree(value);
-                    pp2_charset_token_destroy(prt);
                     no_found++;
                 }
             }
@@ -1454,21 +2015,8 @@ static const char *get_mergekey(xmlDoc *doc, struct client *cl, int record_no,
     xmlChar *mergekey = xmlGetProp(root, (xmlChar *) "mergekey");
     if (mergekey)
     {
-        const char *norm_str;
-        pp2_charset_token_t prt =
-            pp2_charset_token_create(service->charsets, "mergekey");
-
-        pp2_charset_token_first(prt, (const char *) mergekey, 0);
-        while ((norm_str = pp2_charset_token_next(prt)))
-        {
-            if (*norm_str)
-            {
-                if (wrbuf_len(norm_wr))
-                    wrbuf_puts(norm_wr, " ");
-                wrbuf_puts(norm_wr, norm_str);
-            }
-        }
-        pp2_charset_token_destroy(prt);
+        pp2_charset_fact_normalize(service->charsets, "mergekey",
+                                   (const char *) mergekey, norm_wr, 0);
         xmlFree(mergekey);
     }
     else
@@ -1572,33 +2120,247 @@ static int check_record_filter(xmlNode *root, struct session_database *sdb)
 }
 
 
-static int ingest_to_cluster(struct client *cl,
-                             xmlDoc *xdoc,
-                             xmlNode *root,
-                             int record_no,
-                             const char *mergekey_norm);
+static int check_limit_local(struct client *cl,
+                             struct record_metadata **metadata,
+                             int record_no);
+
+/* metadata element of a record prepared outside the session lock */
+struct ingest_field {
+    int md_field_id;
+    const char *value;        /* value as given in record */
+    const char *rank;         /* 0 if field is not ranked */
+    struct record_metadata *rec_md;
+    const char *sort_str;     /* sort key (merge=longest) */
+    const char *unique_key;   /* key (merge=unique-normalized) */
+    int num_facets;
+    const char *facet_display[2];
+    const char *facet_norm[2];
+    struct ingest_field *next;
+};
 
-/** \brief ingest XML record
+struct ingest_prep {
+    int status;                        /* result of ingest_prepare */
+    int record_no;
+    const char *mergekey_norm;
+    struct record_metadata **metadata; /* per field, non-merged */
+    struct ingest_field *fields;       /* in record order */
+    int unknown_metadata;
+    const char *unknown_metadata_name;
+    int unknown_elements;
+    const char *unknown_element_name;
+};
+
+static void ingest_prep_facet(struct session *se, struct ingest_field *f,
+                              const char *type, const char *value,
+                              NMEM nmem, WRBUF display_wr, WRBUF norm_wr)
+{
+    wrbuf_rewind(display_wr);
+    wrbuf_rewind(norm_wr);
+    session_normalize_facet(se, type, value, display_wr, norm_wr);
+    f->facet_display[f->num_facets] = nmem_strdup(nmem,
+                                                  wrbuf_cstr(display_wr));
+    f->facet_norm[f->num_facets] = nmem_strdup(nmem, wrbuf_cstr(norm_wr));
+    f->num_facets++;
+}
+
+/* extract metadata, sort keys and facets from normalized record. Does
+   not need session lock; all is allocated in nmem */
+static struct ingest_prep *ingest_prep_fields(struct client *cl,
+                                              xmlDoc *xdoc, xmlNode *root,
+                                              int record_no,
+                                              const char *mergekey_norm,
+                                              NMEM nmem)
+{
+    xmlNode *n;
+    struct session *se = client_get_session(cl);
+    struct conf_service *service = se->service;
+    struct ingest_prep *prep = nmem_malloc(nmem, sizeof(*prep));
+    struct ingest_field **fp = &prep->fields;
+    WRBUF display_wr = wrbuf_alloc();
+    WRBUF norm_wr = wrbuf_alloc();
+
+    prep->status = 0;
+    prep->record_no = record_no;
+    prep->mergekey_norm = mergekey_norm;
+    prep->metadata =
+        nmem_malloc(nmem, sizeof(*prep->metadata) * service->num_metadata);
+    memset(prep->metadata, 0, sizeof(*prep->metadata) * service->num_metadata);
+    prep->unknown_metadata = 0;
+    prep->unknown_metadata_name = 0;
+    prep->unknown_elements = 0;
+    prep->unknown_element_name = 0;
+
+    for (n = root->children; n; n = n->next)
+    {
+        if (n->type != XML_ELEMENT_NODE)
+            continue;
+        if (!strcmp((const char *) n->name, "metadata"))
+        {
+            struct conf_metadata *ser_md = 0;
+            struct record_metadata **wheretoput = 0;
+            struct record_metadata *rec_md = 0;
+            struct ingest_field *f;
+            int md_field_id = -1;
+            xmlChar *xml_rank;
+            xmlChar *type = xmlGetProp(n, (xmlChar *) "type");
+            xmlChar *value = xmlNodeListGetString(xdoc, n->children, 1);
+
+            if (!type || !value || !*value)
+            {
+                xmlFree(type);
+                xmlFree(value);
+                continue;
+            }
+            md_field_id
+                = conf_service_metadata_field_id(service, (const char *) type);
+            if (md_field_id < 0)
+            {
+                if (!prep->unknown_metadata_name)
+                    prep->unknown_metadata_name =
+                        nmem_strdup(nmem, (const char *) type);
+                prep->unknown_metadata++;
+                xmlFree(type);
+                xmlFree(value);
+                continue;
+            }
+            ser_md = &service->metadata[md_field_id];
+
+            rec_md = record_metadata_init(nmem, (const char *) value,
+                                          ser_md->type, n->properties);
+            if (!rec_md)
+            {
+                session_log(se, YLOG_WARN, "bad metadata data '%s' "
+                            "for element '%s'", value, type);
+                xmlFree(type);
+                xmlFree(value);
+                continue;
+            }
+            wheretoput = &prep->metadata[md_field_id];
+            while (*wheretoput)
+                wheretoput = &(*wheretoput)->next;
+            *wheretoput = rec_md;
+
+            f = nmem_malloc(nmem, sizeof(*f));
+            f->md_field_id = md_field_id;
+            f->value = nmem_strdup(nmem, (const char *) value);
+            f->rec_md = rec_md;
+            f->sort_str = 0;
+            f->unique_key = 0;
+            f->num_facets = 0;
+            xml_rank = xmlGetProp(n, (xmlChar *) "rank");
+            if (xml_rank)
+            {
+                f->rank = nmem_strdup(nmem, (const char *) xml_rank);
+                xmlFree(xml_rank);
+            }
+            else
+                f->rank = ser_md->rank;
+
+            if (ser_md->merge == Metadata_merge_longest &&
+                ser_md->sortkey_offset >= 0)
+            {
+                struct conf_sortkey *ser_sk =
+                    &service->sortkeys[ser_md->sortkey_offset];
+                int skip_article =
+                    ser_sk->type == Metadata_sortkey_skiparticle;
+                if (!pp2_charset_fact_sortkey(service->charsets, "sort",
+                                              rec_md->data.text.disp,
+                                              skip_article, norm_wr))
+                    f->sort_str = nmem_strdup(nmem, wrbuf_cstr(norm_wr));
+            }
+            else if (ser_md->merge == Metadata_merge_unique_normalized)
+            {
+                const char *icu_chain_id = ser_md->facetrule ?
+                    ser_md->facetrule : "facet";
+                if (!pp2_charset_fact_normalize(service->charsets,
+                                                icu_chain_id,
+                                                rec_md->data.text.disp,
+                                                norm_wr, 0))
+                    f->unique_key = nmem_strdup(nmem, wrbuf_cstr(norm_wr));
+            }
+
+            // construct facets ... unless the client already has reported them
+            if (ser_md->termlist && !client_has_facet(cl, (char *) type))
+            {
+                if (ser_md->type == Metadata_type_year)
+                {
+                    char year[64];
+                    sprintf(year, "%d", rec_md->data.number.max);
+                    ingest_prep_facet(se, f, (const char *) type, year,
+                                      nmem, display_wr, norm_wr);
+                    if (rec_md->data.number.max != rec_md->data.number.min)
+                    {
+                        sprintf(year, "%d", rec_md->data.number.min);
+                        ingest_prep_facet(se, f, (const char *) type, year,
+                                          nmem, display_wr, norm_wr);
+                    }
+                }
+                else
+                    ingest_prep_facet(se, f, (const char *) type,
+                                      (const char *) value,
+                                      nmem, display_wr, norm_wr);
+            }
+            *fp = f;
+            fp = &f->next;
+            xmlFree(type);
+            xmlFree(value);
+        }
+        else
+        {
+            if (!prep->unknown_element_name)
+                prep->unknown_element_name =
+                    nmem_strdup(nmem, (const char *) n->name);
+            prep->unknown_elements++;
+        }
+    }
+    *fp = 0;
+    wrbuf_destroy(display_wr);
+    wrbuf_destroy(norm_wr);
+    return prep;
+}
+
+/** \brief prepare record for ingest
     \param cl client holds the result set for record
     \param rec record buffer (0 terminated)
+    \param normalized whether rec is normalized already (search cache)
     \param record_no record position (1, 2, ..)
-    \param nmem working NMEM
+    \param nmem working NMEM; holds the prepared record
+    \param prep prepared record (result)
     \retval 0 OK
     \retval -1 failure
     \retval -2 Filtered
-    \retval -3 only ingested (hardcore ingest mode)
+
+    This is the CPU heavy part of ingest: XSLT normalization, metadata
+    extraction and charset normalization of keys and facets. It does not
+    lock the session, so it runs concurrently for different targets.
 */
-int ingest_record(struct client *cl, const char *rec,
-                  int record_no, NMEM nmem)
+static int ingest_prepare(struct client *cl, const char *rec,
+                          int normalized, int record_no, NMEM nmem,
+                          struct ingest_prep **prep)
 {
     struct session *se = client_get_session(cl);
-    int ret = 0;
     struct session_database *sdb = client_get_database(cl);
     struct conf_service *service = se->service;
-    xmlDoc *xdoc = normalize_record(se, sdb, service, rec, nmem);
+    xmlDoc *xdoc;
     xmlNode *root;
     const char *mergekey_norm;
+    int ret = 0;
 
+    if (normalized)
+        xdoc = normalize_record_parse(sdb->map, rec, strlen(rec));
+    else
+    {
+        xdoc = normalize_record(se, sdb, service, rec, nmem);
+        if (xdoc && client_search_cache_filling(cl))
+        {
+            xmlChar *buf_out;
+            int len_out;
+            xmlDocDumpMemory(xdoc, &buf_out, &len_out);
+            client_search_cache_record(cl, record_no,
+                                       (const char *) buf_out);
+            xmlFree(buf_out);
+        }
+    }
     if (!xdoc)
         return -1;
 
@@ -1618,17 +2380,280 @@ int ingest_record(struct client *cl, const char *rec,
         xmlFreeDoc(xdoc);
         return -1;
     }
-    session_enter(se, "ingest_record");
-    if (client_get_session(cl) == se)
-        ret = ingest_to_cluster(cl, xdoc, root, record_no, mergekey_norm);
-    session_leave(se, "ingest_record");
-
+    *prep = ingest_prep_fields(cl, xdoc, root, record_no, mergekey_norm,
+                               nmem);
+    if (check_limit_local(cl, (*prep)->metadata, record_no))
+    {
+        session_log(se, YLOG_LOG, "Facet filtered out record no %d from %s",
+                    record_no, sdb->database->id);
+        ret = -2;
+    }
     xmlFreeDoc(xdoc);
     return ret;
 }
 
+static int ingest_to_cluster(struct client *cl, struct ingest_prep *prep,
+                             NMEM nmem);
+
+/* prepared records of the result set of a client, so that a reingest
+   needs neither the raw records nor normalization */
+struct ingest_cache {
+    NMEM nmem;
+    unsigned settings_hash;  /* settings the records were prepared with */
+    int num;
+    int size;
+    struct ingest_prep **preps; /* in order of ingest */
+};
+
+struct ingest_cache *ingest_cache_create(void)
+{
+    struct ingest_cache *ic = xmalloc(sizeof(*ic));
+    ic->nmem = nmem_create();
+    ic->settings_hash = 0;
+    ic->num = 0;
+    ic->size = 0;
+    ic->preps = 0;
+    return ic;
+}
+
+void ingest_cache_destroy(struct ingest_cache *ic)
+{
+    if (ic)
+    {
+        nmem_destroy(ic->nmem);
+        xfree(ic->preps);
+        xfree(ic);
+    }
+}
+
+void ingest_cache_reset(struct ingest_cache *ic, unsigned settings_hash)
+{
+    nmem_reset(ic->nmem);
+    ic->settings_hash = settings_hash;
+    ic->num = 0;
+}
+
+int ingest_cache_match(struct ingest_cache *ic, unsigned settings_hash)
+{
+    return ic->num > 0 && ic->settings_hash == settings_hash;
+}
+
+/* copy of prepared record in nmem; scratch memory of prepare is not
+   kept */
+static struct ingest_prep *ingest_prep_copy(NMEM nmem,
+                                            struct conf_service *service,
+                                            const struct ingest_prep *src)
+{
+    struct ingest_prep *prep = nmem_malloc(nmem, sizeof(*prep));
+    const struct ingest_field *sf;
+    struct ingest_field **fp = &prep->fields;
+    struct record_metadata **last;
+
+    *prep = *src;
+    prep->mergekey_norm = nmem_strdup_null(nmem, src->mergekey_norm);
+    prep->unknown_metadata_name =
+        nmem_strdup_null(nmem, src->unknown_metadata_name);
+    prep->unknown_element_name =
+        nmem_strdup_null(nmem, src->unknown_element_name);
+    prep->metadata = 0;
+    if (!src->metadata)
+    {   /* failed or filtered */
+        *fp = 0;
+        return prep;
+    }
+    prep->metadata =
+        nmem_malloc(nmem, sizeof(*prep->metadata) * service->num_metadata);
+    memset(prep->metadata, 0, sizeof(*prep->metadata) * service->num_metadata);
+    last = nmem_malloc(nmem, sizeof(*last) * service->num_metadata);
+    memset(last, 0, sizeof(*last) * service->num_metadata);
+    /* fields hold the values of metadata lists in the same order */
+    for (sf = src->fields; sf; sf = sf->next)
+    {
+        struct ingest_field *f = nmem_malloc(nmem, sizeof(*f));
+        struct record_metadata *rec_md = record_metadata_create(nmem);
+        struct record_metadata_attr *attr, **attrp = &rec_md->attributes;
+        int i;
+
+        *f = *sf;
+        f->value = nmem_strdup(nmem, sf->value);
+        f->rank = nmem_strdup_null(nmem, sf->rank);
+        f->sort_str = nmem_strdup_null(nmem, sf->sort_str);
+        f->unique_key = nmem_strdup_null(nmem, sf->unique_key);
+        for (i = 0; i < sf->num_facets; i++)
+        {
+            f->facet_display[i] = nmem_strdup(nmem, sf->facet_display[i]);
+            f->facet_norm[i] = nmem_strdup(nmem, sf->facet_norm[i]);
+        }
+        rec_md->data = sf->rec_md->data;
+        if (service->metadata[sf->md_field_id].type == Metadata_type_generic)
+        {
+            rec_md->data.text.disp =
+                nmem_strdup(nmem, sf->rec_md->data.text.disp);
+            rec_md->data.text.sort =
+                nmem_strdup_null(nmem, sf->rec_md->data.text.sort);
+        }
+        for (attr = sf->rec_md->attributes; attr; attr = attr->next)
+        {
+            *attrp = nmem_malloc(nmem, sizeof(**attrp));
+            (*attrp)->name = nmem_strdup(nmem, attr->name);
+            (*attrp)->value = nmem_strdup(nmem, attr->value);
+            attrp = &(*attrp)->next;
+        }
+        *attrp = 0;
+        f->rec_md = rec_md;
+        if (last[f->md_field_id])
+            last[f->md_field_id]->next = rec_md;
+        else
+            prep->metadata[f->md_field_id] = rec_md;
+        last[f->md_field_id] = rec_md;
+        *fp = f;
+        fp = &f->next;
+    }
+    *fp = 0;
+    return prep;
+}
+
+static void ingest_cache_add(struct ingest_cache *ic, struct ingest_prep *prep)
+{
+    if (ic->num == ic->size)
+    {
+        ic->size = ic->size ? 2 * ic->size : 32;
+        ic->preps = xrealloc(ic->preps, sizeof(*ic->preps) * ic->size);
+    }
+    ic->preps[ic->num++] = prep;
+}
+
+/** \brief ingest XML record
+    \param cl client holds the result set for record
+    \param rec record buffer (0 terminated)
+    \param record_no record position (1, 2, ..)
+    \param nmem working NMEM
+    \retval 0 OK
+    \retval -1 failure
+    \retval -2 Filtered
+    \retval -3 only ingested (hardcore ingest mode)
+*/
+int ingest_record(struct client *cl, const char *rec,
+                  int record_no, NMEM nmem)
+{
+    int ret;
+    ingest_record_batch(cl, 1, &rec, &record_no, 0, &ret, nmem, 0);
+    return ret;
+}
+
+/* merges prepared records with rets[i] == 0 under one session lock */
+static void ingest_merge_batch(struct client *cl, int num,
+                               struct ingest_prep **preps, int *rets,
+                               NMEM nmem)
+{
+    struct session *se = client_get_session(cl);
+    int i, no_prepared = 0;
+
+    for (i = 0; i < num; i++)
+        if (rets[i] == 0)
+            no_prepared++;
+    /* record counts of client changed, even if all were filtered */
+    if (num > 0)
+        session_changed(se, SESSION_GEN_CLIENTS);
+    if (no_prepared == 0)
+        return;
+    session_enter(se, "ingest_merge_batch");
+    if (client_get_session(cl) == se)
+    {
+        for (i = 0; i < num; i++)
+            if (rets[i] == 0)
+                rets[i] = ingest_to_cluster(cl, preps[i], nmem);
+        session_changed(se, SESSION_GEN_RECLIST);
+        session_changed(se, SESSION_GEN_TERMLIST);
+    }
+    session_leave(se, "ingest_merge_batch");
+}
+
+/** \brief ingest several XML records
+    \param cl client holds the result set for records
+    \param num number of records
+    \param recs record buffers (0 terminated)
+    \param record_nos record positions
+    \param normalized whether records are normalized already
+    \param rets result for each record (see ingest_record)
+    \param nmem working NMEM
+    \param ic cache that keeps the prepared records (0 for none)
+
+    All records are prepared first; the session is then locked once
+    to merge them.
+*/
+void ingest_record_batch(struct client *cl, int num, const char **recs,
+                         const int *record_nos, int normalized,
+                         int *rets, NMEM nmem, struct ingest_cache *ic)
+{
+    struct ingest_prep **preps = nmem_malloc(nmem, sizeof(*preps) * num);
+    int i;
+
+    for (i = 0; i < num; i++)
+    {
+        preps[i] = 0;
+        rets[i] = ingest_prepare(cl, recs[i], normalized, record_nos[i],
+                                 nmem, preps + i);
+        if (ic)
+        {
+            if (preps[i])
+                ingest_cache_add(ic, ingest_prep_copy(
+                                     ic->nmem,
+                                     client_get_session(cl)->service,
+                                     preps[i]));
+            else
+            {
+                /* remember failed and filtered too */
+                struct ingest_prep *prep =
+                    nmem_malloc(ic->nmem, sizeof(*prep));
+                memset(prep, 0, sizeof(*prep));
+                prep->record_no = record_nos[i];
+                prep->status = rets[i];
+                ingest_cache_add(ic, prep);
+            }
+        }
+    }
+    ingest_merge_batch(cl, num, preps, rets, nmem);
+}
+
+/** \brief merges prepared records of client again
+    \param cl client
+    \param ic cache with prepared records of client
+    \returns number of records filtered
+
+    Only the local facet limits are checked again; records are not
+    normalized again.
+*/
+int ingest_cache_reingest(struct client *cl, struct ingest_cache *ic)
+{
+    struct session *se = client_get_session(cl);
+    struct session_database *sdb = client_get_database(cl);
+    NMEM nmem = nmem_create();
+    int *rets = nmem_malloc(nmem, sizeof(*rets) * (ic->num + 1));
+    int i, filtered = 0;
+
+    for (i = 0; i < ic->num; i++)
+    {
+        struct ingest_prep *prep = ic->preps[i];
+        rets[i] = prep->status;
+        if (rets[i] == 0 &&
+            check_limit_local(cl, prep->metadata, prep->record_no))
+        {
+            session_log(se, YLOG_LOG, "Facet filtered out record no %d "
+                        "from %s", prep->record_no, sdb->database->id);
+            rets[i] = -2;
+        }
+    }
+    ingest_merge_batch(cl, ic->num, ic->preps, rets, nmem);
+    for (i = 0; i < ic->num; i++)
+        if (rets[i] == -2)
+            filtered++;
+    nmem_destroy(nmem);
+    return filtered;
+}
+
 //    struct conf_metadata *ser_md = &service->metadata[md_field_id];
-//    struct record_metadata *rec_md = record->metadata[md_field_id];
+//    struct record_metadata *rec_md = metadata[md_field_id];
 static int match_metadata_local(struct conf_metadata *ser_md,
                                 struct record_metadata *rec_md0,
                                 char **values, int num_v)
@@ -1715,7 +2740,7 @@ int session_check_cluster_limit(struct session *se, struct record_cluster *rec)
 
 // Skip record on non-zero
 static int check_limit_local(struct client *cl,
-                             struct record *record,
+                             struct record_metadata **metadata,
                              int record_no)
 {
     int skip_record = 0;
@@ -1742,7 +2767,7 @@ static int check_limit_local(struct client *cl,
             {
                 if (match_metadata_local(
                         &service->metadata[md_field_id],
-                        record->metadata[md_field_id],
+                        metadata[md_field_id],
                         values, num_v))
                     break;
             }
@@ -1759,7 +2784,7 @@ static int check_limit_local(struct client *cl,
             }
             if (!match_metadata_local(
                     &service->metadata[md_field_id],
-                    record->metadata[md_field_id],
+                    metadata[md_field_id],
                     values, num_v))
             {
                 skip_record = 1;
@@ -1770,89 +2795,139 @@ static int check_limit_local(struct client *cl,
     return skip_record;
 }
 
-static int ingest_to_cluster(struct client *cl,
-                             xmlDoc *xdoc,
-                             xmlNode *root,
-                             int record_no,
-                             const char *mergekey_norm)
+/* merge=unique lists longer than this get a hash set */
+#define UNIQUE_SET_THRESHOLD 8
+
+/** \brief checks whether value is new for a unique-merged cluster field
+    \param se session
+    \param cluster cluster
+    \param md_field_id metadata field
+    \param value value (interned)
+    \param norm_wr work buffer
+    \retval 1 value is new; must be added to cluster
+    \retval 0 value (or its normalized form) is already in cluster
+*/
+static int cluster_unique_check(struct session *se,
+                                struct record_cluster *cluster,
+                                int md_field_id, const char *value,
+                                const char *norm_key)
 {
-    xmlNode *n;
-    xmlChar *type = 0;
-    xmlChar *value = 0;
-    struct session *se = client_get_session(cl);
     struct conf_service *service = se->service;
-    int term_factor = 1;
-    struct record_cluster *cluster;
-    struct session_database *sdb = client_get_database(cl);
-    struct record *record = record_create(se->nmem,
-                                          service->num_metadata,
-                                          service->num_sortkeys, cl,
-                                          record_no);
+    struct conf_metadata *ser_md = &service->metadata[md_field_id];
+    struct record_value_set **set;
 
-    for (n = root->children; n; n = n->next)
+    if (!cluster->value_sets)
     {
-        if (type)
-            xmlFree(type);
-        if (value)
-            xmlFree(value);
-        type = value = 0;
-
-        if (n->type != XML_ELEMENT_NODE)
-            continue;
-        if (!strcmp((const char *) n->name, "metadata"))
-        {
-            struct conf_metadata *ser_md = 0;
-            struct record_metadata **wheretoput = 0;
-            struct record_metadata *rec_md = 0;
-            int md_field_id = -1;
-
-            type = xmlGetProp(n, (xmlChar *) "type");
-            value = xmlNodeListGetString(xdoc, n->children, 1);
+        cluster->value_sets = nmem_malloc(se->nmem, service->num_metadata *
+                                          sizeof(*cluster->value_sets));
+        memset(cluster->value_sets, 0,
+               service->num_metadata * sizeof(*cluster->value_sets));
+    }
+    set = &cluster->value_sets[md_field_id];
+    if (ser_md->merge == Metadata_merge_unique_normalized)
+    {
+        /* only the key is normalized; display value is left as is */
+        if (!norm_key)
+            return 1;
+        if (!*set)
+            *set = record_value_set_create(se->nmem);
+        return record_value_set_insert(
+            *set, string_pool_intern(se->strings, norm_key));
+    }
+    if (!*set)
+    {
+        struct record_metadata *md;
+        int no = 0;
+        for (md = cluster->metadata[md_field_id]; md; md = md->next, no++)
+            if (md->data.text.disp == value ||
+                !strcmp(md->data.text.disp, value))
+                return 0;
+        if (no < UNIQUE_SET_THRESHOLD)
+            return 1;
+        *set = record_value_set_create(se->nmem);
+        for (md = cluster->metadata[md_field_id]; md; md = md->next)
+            record_value_set_insert(*set, md->data.text.disp);
+    }
+    return record_value_set_insert(*set, value);
+}
 
-            if (!type || !value || !*value)
-                continue;
+/* appends value to list of field in cluster */
+static void cluster_metadata_append(struct record_cluster *cluster,
+                                    int md_field_id,
+                                    struct record_metadata *md)
+{
+    struct record_metadata *last = cluster->metadata_last[md_field_id];
+    if (last)
+        last->next = md;
+    else
+        cluster->metadata[md_field_id] = md;
+    cluster->metadata_last[md_field_id] = md;
+}
 
-            md_field_id
-                = conf_service_metadata_field_id(service, (const char *) type);
-            if (md_field_id < 0)
-            {
-                if (se->number_of_warnings_unknown_metadata == 0)
-                {
-                    session_log(se, YLOG_WARN,
-                            "Ignoring unknown metadata element: %s", type);
-                }
-                se->number_of_warnings_unknown_metadata++;
-                continue;
-            }
+/* copy of metadata for cluster; made only when value is retained */
+static struct record_metadata *cluster_metadata_dup(NMEM nmem,
+                                                   struct record_metadata *md)
+{
+    struct record_metadata *rec_md = record_metadata_create(nmem);
+    rec_md->data = md->data;
+    return rec_md;
+}
 
-            ser_md = &service->metadata[md_field_id];
+/* merge prepared record into session. Session must be locked.
+   prep is not modified; nmem is the working NMEM of the merge */
+static int ingest_to_cluster(struct client *cl, struct ingest_prep *prep,
+                             NMEM nmem)
+{
+    struct session *se = client_get_session(cl);
+    struct conf_service *service = se->service;
+    int term_factor = 1;
+    int md_field_id;
+    int i, num_fields;
+    struct record_cluster *cluster;
+    struct record *record;
+    struct record_metadata **metadata;
+    struct record_metadata **field_md;
+    struct ingest_field *f;
+    struct session_database *sdb = client_get_database(cl);
 
-            // non-merged metadata
-            rec_md = record_metadata_init(se->nmem, (const char *) value,
-                                          ser_md->type, n->properties);
-            if (!rec_md)
-            {
-                session_log(se, YLOG_WARN, "bad metadata data '%s' "
-                            "for element '%s'", value, type);
-                continue;
-            }
-            wheretoput = &record->metadata[md_field_id];
-            while (*wheretoput)
-                wheretoput = &(*wheretoput)->next;
-            *wheretoput = rec_md;
-        }
+    if (prep->unknown_metadata)
+    {
+        if (se->number_of_warnings_unknown_metadata == 0)
+            session_log(se, YLOG_WARN,
+                        "Ignoring unknown metadata element: %s",
+                        prep->unknown_metadata_name);
+        se->number_of_warnings_unknown_metadata += prep->unknown_metadata;
+    }
+    if (prep->unknown_elements)
+    {
+        if (se->number_of_warnings_unknown_elements == 0)
+            session_log(se, YLOG_WARN,
+                        "Unexpected element in internal record: %s",
+                        prep->unknown_element_name);
+        se->number_of_warnings_unknown_elements += prep->unknown_elements;
     }
 
-    if (check_limit_local(cl, record, record_no))
+    /* strings must survive the working NMEM of the record. Fields and
+       metadata lists are in the same order, so interned copies are made
+       per field */
+    metadata = nmem_malloc(nmem, sizeof(*metadata) * service->num_metadata);
+    for (md_field_id = 0; md_field_id < service->num_metadata; md_field_id++)
+        metadata[md_field_id] = 0;
+    for (num_fields = 0, f = prep->fields; f; f = f->next)
+        num_fields++;
+    field_md = nmem_malloc(nmem, sizeof(*field_md) * (num_fields + 1));
+    for (i = 0, f = prep->fields; f; f = f->next, i++)
     {
-        session_log(se, YLOG_LOG, "Facet filtered out record no %d from %s",
-                    record_no, sdb->database->id);
-        if (type)
-            xmlFree(type);
-        if (value)
-            xmlFree(value);
-        return -2;
+        struct record_metadata **wheretoput = &metadata[f->md_field_id];
+        while (*wheretoput)
+            wheretoput = &(*wheretoput)->next;
+        *wheretoput = field_md[i] =
+            record_metadata_intern(se->strings, nmem, f->rec_md,
+                                   service->metadata[f->md_field_id].type);
     }
+
+    record = record_create(se->nmem, service, metadata, cl,
+                           prep->record_no);
     if (global_parameters.ingest_mode > 0)
     {
         // ingest turned on -> append this new record to reclist.all_records
@@ -1870,7 +2945,7 @@ static int ingest_to_cluster(struct client *cl,
     }
 
     cluster = reclist_insert(se->reclist, service, record,
-                             mergekey_norm, &se->total_merged);
+                             prep->mergekey_norm, &se->total_merged);
     if (!cluster)
         return -1;
 
@@ -1889,191 +2964,102 @@ static int ingest_to_cluster(struct client *cl,
 
     if (global_parameters.dump_records)
         session_log(se, YLOG_LOG, "Cluster id %s from %s (#%d)", cluster->recid,
-                    sdb->database->id, record_no);
+                    sdb->database->id, prep->record_no);
 
 
     relevance_newrec(se->relevance, cluster);
 
-    // now parsing XML record and adding data to cluster or record metadata
-    for (n = root->children; n; n = n->next)
+    // now adding data to cluster
+    for (f = prep->fields, num_fields = 0; f; f = f->next, num_fields++)
     {
-        pp2_charset_token_t prt;
-        if (type)
-            xmlFree(type);
-        if (value)
-            xmlFree(value);
-        type = value = 0;
+        struct conf_metadata *ser_md = &service->metadata[f->md_field_id];
+        struct conf_sortkey *ser_sk = 0;
+        struct record_metadata **wheretoput;
+        struct record_metadata *rec_md = field_md[num_fields];
+        int sk_field_id = -1;
 
-        if (n->type != XML_ELEMENT_NODE)
-            continue;
-        if (!strcmp((const char *) n->name, "metadata"))
+        if (ser_md->sortkey_offset >= 0)
         {
-            struct conf_metadata *ser_md = 0;
-            struct conf_sortkey *ser_sk = 0;
-            struct record_metadata **wheretoput = 0;
-            struct record_metadata *rec_md = 0;
-            int md_field_id = -1;
-            int sk_field_id = -1;
-            const char *rank;
-            xmlChar *xml_rank;
-
-            type = xmlGetProp(n, (xmlChar *) "type");
-            value = xmlNodeListGetString(xdoc, n->children, 1);
-
-            if (!type || !value || !*value)
-                continue;
-
-            md_field_id
-                = conf_service_metadata_field_id(service, (const char *) type);
-            if (md_field_id < 0)
-                continue;
-
-            ser_md = &service->metadata[md_field_id];
-
-            if (ser_md->sortkey_offset >= 0)
-            {
-                sk_field_id = ser_md->sortkey_offset;
-                ser_sk = &service->sortkeys[sk_field_id];
-            }
-
-            // merged metadata
-            rec_md = record_metadata_init(se->nmem, (const char *) value,
-                                          ser_md->type, 0);
-            if (!rec_md)
-                continue;
-
-            xml_rank = xmlGetProp(n, (xmlChar *) "rank");
-            rank = xml_rank ? (const char *) xml_rank : ser_md->rank;
+            sk_field_id = ser_md->sortkey_offset;
+            ser_sk = &service->sortkeys[sk_field_id];
+        }
 
-            wheretoput = &cluster->metadata[md_field_id];
+        wheretoput = &cluster->metadata[f->md_field_id];
 
-            // and polulate with data:
-            // assign cluster or record based on merge action
-            if (ser_md->merge == Metadata_merge_unique)
-            {
-                while (*wheretoput)
-                {
-                    if (!strcmp((const char *) (*wheretoput)->data.text.disp,
-                                rec_md->data.text.disp))
-                        break;
-                    wheretoput = &(*wheretoput)->next;
-                }
-                if (!*wheretoput)
-                    *wheretoput = rec_md;
-            }
-            else if (ser_md->merge == Metadata_merge_longest)
+        // and polulate with data:
+        // assign cluster or record based on merge action
+        if (ser_md->merge == Metadata_merge_unique ||
+            ser_md->merge == Metadata_merge_unique_normalized)
+        {
+            if (cluster_unique_check(se, cluster, f->md_field_id,
+                                     rec_md->data.text.disp, f->unique_key))
+                cluster_metadata_append(
+                    cluster, f->md_field_id,
+                    cluster_metadata_dup(se->nmem, rec_md));
+        }
+        else if (ser_md->merge == Metadata_merge_longest)
+        {
+            if (!*wheretoput
+                || strlen(rec_md->data.text.disp)
+                > strlen((*wheretoput)->data.text.disp))
             {
-                if (!*wheretoput
-                    || strlen(rec_md->data.text.disp)
-                    > strlen((*wheretoput)->data.text.disp))
+                *wheretoput = cluster_metadata_dup(se->nmem, rec_md);
+                if (ser_sk)
                 {
-                    *wheretoput = rec_md;
-                    if (ser_sk)
-                    {
-                        const char *sort_str = 0;
-                        int skip_article =
-                            ser_sk->type == Metadata_sortkey_skiparticle;
-
-                        if (!cluster->sortkeys[sk_field_id])
-                            cluster->sortkeys[sk_field_id] =
-                                nmem_malloc(se->nmem,
-                                            sizeof(union data_types));
-
-                        prt =
-                            pp2_charset_token_create(service->charsets, "sort");
+                    const char *sort_str = f->sort_str;
 
-                        pp2_charset_token_first(prt, rec_md->data.text.disp,
-                                                skip_article);
+                    if (!cluster->sortkeys[sk_field_id])
+                        cluster->sortkeys[sk_field_id] =
+                            nmem_malloc(se->nmem,
+                                        sizeof(union data_types));
 
-                        pp2_charset_token_next(prt);
-
-                        sort_str = pp2_get_sort(prt);
-
-                        cluster->sortkeys[sk_field_id]->text.disp =
-                            rec_md->data.text.disp;
-                        if (!sort_str)
-                        {
-                            sort_str = rec_md->data.text.disp;
-                            session_log(se, YLOG_WARN,
+                    cluster->sortkeys[sk_field_id]->text.disp =
+                        rec_md->data.text.disp;
+                    if (!sort_str)
+                    {
+                        sort_str = rec_md->data.text.disp;
+                        session_log(se, YLOG_WARN,
                                     "Could not make sortkey. Bug #1858");
-                        }
-                        cluster->sortkeys[sk_field_id]->text.sort =
-                            nmem_strdup(se->nmem, sort_str);
-                        pp2_charset_token_destroy(prt);
                     }
+                    cluster->sortkeys[sk_field_id]->text.sort =
+                        string_pool_intern(se->strings, sort_str);
                 }
             }
-            else if (ser_md->merge == Metadata_merge_all)
-            {
-                while (*wheretoput)
-                    wheretoput = &(*wheretoput)->next;
-                *wheretoput = rec_md;
-            }
-            else if (ser_md->merge == Metadata_merge_range)
+        }
+        else if (ser_md->merge == Metadata_merge_all)
+        {
+            cluster_metadata_append(cluster, f->md_field_id,
+                                    cluster_metadata_dup(se->nmem, rec_md));
+        }
+        else if (ser_md->merge == Metadata_merge_range)
+        {
+            if (!*wheretoput)
             {
-                if (!*wheretoput)
-                {
-                    *wheretoput = rec_md;
-                    if (ser_sk)
-                        cluster->sortkeys[sk_field_id]
-                            = &rec_md->data;
-                }
-                else
-                {
-                    int this_min = rec_md->data.number.min;
-                    int this_max = rec_md->data.number.max;
-                    if (this_min < (*wheretoput)->data.number.min)
-                        (*wheretoput)->data.number.min = this_min;
-                    if (this_max > (*wheretoput)->data.number.max)
-                        (*wheretoput)->data.number.max = this_max;
-                }
+                *wheretoput = cluster_metadata_dup(se->nmem, rec_md);
+                if (ser_sk)
+                    cluster->sortkeys[sk_field_id]
+                        = &(*wheretoput)->data;
             }
-
-            // ranking of _all_ fields enabled ...
-            if (rank)
+            else
             {
-                relevance_countwords(se->relevance, cluster,
-                                     (char *) value, rank, ser_md->name);
+                int this_min = rec_md->data.number.min;
+                int this_max = rec_md->data.number.max;
+                if (this_min < (*wheretoput)->data.number.min)
+                    (*wheretoput)->data.number.min = this_min;
+                if (this_max > (*wheretoput)->data.number.max)
+                    (*wheretoput)->data.number.max = this_max;
             }
+        }
 
-            // construct facets ... unless the client already has reported them
-            if (ser_md->termlist && !client_has_facet(cl, (char *) type))
-            {
-                if (ser_md->type == Metadata_type_year)
-                {
-                    char year[64];
-                    sprintf(year, "%d", rec_md->data.number.max);
-
-                    add_facet(se, (char *) type, year, term_factor);
-                    if (rec_md->data.number.max != rec_md->data.number.min)
-                    {
-                        sprintf(year, "%d", rec_md->data.number.min);
-                        add_facet(se, (char *) type, year, term_factor);
-                    }
-                }
-                else
-                    add_facet(se, (char *) type, (char *) value, term_factor);
-            }
+        // ranking of _all_ fields enabled ...
+        if (f->rank)
+            relevance_countwords(se->relevance, cluster,
+                                 f->value, f->rank, ser_md->name);
 
-            // cleaning up
-            if (xml_rank)
-                xmlFree(xml_rank);
-            xmlFree(type);
-            xmlFree(value);
-            type = value = 0;
-        }
-        else
-        {
-            if (se->number_of_warnings_unknown_elements == 0)
-                session_log(se, YLOG_WARN,
-                        "Unexpected element in internal record: %s", n->name);
-            se->number_of_warnings_unknown_elements++;
-        }
+        for (i = 0; i < f->num_facets; i++)
+            add_facet_normalized(se, ser_md->name, f->facet_display[i],
+                                 f->facet_norm[i], term_factor);
     }
-    if (type)
-        xmlFree(type);
-    if (value)
-        xmlFree(value);
 
     relevance_donerecord(se->relevance, cluster);
     se->total_records++;
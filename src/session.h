@@ -26,6 +26,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <yaz/yaz-ccl.h>
 
 #include "facet_limit.h"
+#include "ppmutex.h"
 #include "termlists.h"
 #include "reclists.h"
 #include "http.h"
@@ -63,6 +64,14 @@ struct database {
 };
 
 
+/* metadata added to normalized records from settings (postproc) */
+struct session_postproc
+{
+    const char *type;
+    const char *value;
+    struct session_postproc *next;
+};
+
 // Represents a database as viewed from one session, possibly with settings overriden
 // for that session
 struct session_database
@@ -71,6 +80,8 @@ struct session_database
     int num_settings;
     struct setting **settings;
     normalize_record_t map;
+    const char **xslt_params;  /* from settings; 0 until prepare_map */
+    struct session_postproc *postproc; /* valid if xslt_params is */
     struct session_database *next;
 };
 
@@ -81,8 +92,17 @@ struct session_database
 #define SESSION_WATCH_BYTARGET  4
 #define SESSION_WATCH_MAX       4
 
+/* generation counters: what a response depends on */
+#define SESSION_GEN_RECLIST     0
+#define SESSION_GEN_TERMLIST    1
+#define SESSION_GEN_CLIENTS     2
+#define SESSION_GEN_MAX         2
+
 #define SESSION_MAX_TERMLISTS 10
 
+/* number of terms per termlist kept in published snapshots */
+#define SESSION_SNAPSHOT_TERMS 100
+
 typedef void (*session_watchfun)(void *data);
 
 struct named_termlist
@@ -95,6 +115,14 @@ struct session_watchentry {
     void *data;
     http_channel_observer_t obs;
     session_watchfun fun;
+    int min_records;   /* release after this many new records .. */
+    int window_ms;     /* .. or this many milliseconds (0=no limit) */
+    int start_records; /* total records when watch was set */
+    long start_ms;
+    struct session *session;
+    int what;
+    unsigned id;       /* handle of observer; entries may be freed first */
+    struct session_watchentry *next;
 };
 
 struct client_list;
@@ -107,17 +135,28 @@ struct session {
     struct client_list *clients_cached; // Clients in cache
     NMEM session_nmem;  // Nmem for session-permanent storage
     NMEM nmem;          // Nmem for each operation (i.e. search, result set, etc)
+    string_pool_t strings; // Interned metadata and terms, allocated in nmem
     int num_termlists;
     struct named_termlist termlists[SESSION_MAX_TERMLISTS];
     struct relevance *relevance;
     struct reclist *reclist;
-    struct session_watchentry watchlist[SESSION_WATCH_MAX + 1];
+    struct session_watchentry *watchlist[SESSION_WATCH_MAX + 1]; // waiters
     int total_records;
     int total_merged;
     int number_of_warnings_unknown_elements;
     int number_of_warnings_unknown_metadata;
     normalize_cache_t normalize_cache;
-    YAZ_MUTEX session_mutex;
+    PAZPAR2_RWLOCK session_lock; // shared for reading, exclusive for change
+    YAZ_MUTEX view_mutex;  // serializes limit/sort of reclist by readers
+    YAZ_MUTEX watch_mutex; // protects watchlist
+    IOCHAN watch_timer;    // releases watches when their window ends
+    unsigned watch_id;     // id of last watch set; protected by watch_mutex
+    unsigned generation;   // incremented whenever session_lock is exclusive
+    unsigned relevance_generation; // generation of last relevance scores
+    volatile int changes[SESSION_GEN_MAX + 1]; // bumped on each change
+    struct session_snapshot *snapshot; // latest published state
+    YAZ_MUTEX snapshot_mutex; // protects snapshot pointer
+    YAZ_MUTEX publish_mutex;  // serializes session_publish
     unsigned session_id;
     int settings_modified;
     facet_limits_t facet_limits;
@@ -152,7 +191,9 @@ struct hitsbytarget {
     char *suggestions_xml;
 };
 
-struct hitsbytarget *get_hitsbytarget(struct session *s, int *count, NMEM nmem);
+struct hitsbytarget *get_hitsbytarget(struct session *s, int with_settings,
+                                      int *count, NMEM nmem);
+void session_publish(struct session *s);
 struct session *new_session(NMEM nmem, struct conf_service *service,
                             unsigned session_id);
 void session_destroy(struct session *s);
@@ -167,7 +208,7 @@ enum pazpar2_error_code session_search(struct session *s, const char *query,
                                        const char *filter, const char *limit,
                                        const char **addinfo,
                                        struct reclist_sortparms *sort_parm);
-struct record_cluster **show_range_start(struct session *s,
+struct record_cluster **show_range_start(struct session *s, NMEM nmem,
                                          struct reclist_sortparms *sp,
                                          int start,
                                          int *num, int *total, Odr_int *sumhits, Odr_int *approximation);
@@ -177,7 +218,7 @@ struct record_cluster *show_single_start(struct session *s, const char *id,
                                          struct record_cluster **prev_r,
                                          struct record_cluster **next_r);
 void show_single_stop(struct session *s, struct record_cluster *rec);
-int session_set_watch(struct session *s, int what, session_watchfun fun, void *data, struct http_channel *c);
+void session_set_watch(struct session *s, int what, session_watchfun fun, void *data, struct http_channel *c, int min_records, int window_ms);
 int session_active_clients(struct session *s);
 int session_is_preferred_clients_ready(struct session *s);
 void session_apply_setting(struct session *se, char *dbname, char *setting, char *value);
@@ -186,11 +227,24 @@ const char *session_setting_oneval(struct session_database *db, int offset);
 int session_total_hits(struct session *se);
 struct record *session_get_ingested(struct session *s);
 int ingest_record(struct client *cl, const char *rec, int record_no, NMEM nmem);
+struct ingest_cache;
+void ingest_record_batch(struct client *cl, int num, const char **recs,
+                         const int *record_nos, int normalized,
+                         int *rets, NMEM nmem, struct ingest_cache *ic);
+struct ingest_cache *ingest_cache_create(void);
+void ingest_cache_destroy(struct ingest_cache *ic);
+void ingest_cache_reset(struct ingest_cache *ic, unsigned settings_hash);
+int ingest_cache_match(struct ingest_cache *ic, unsigned settings_hash);
+int ingest_cache_reingest(struct client *cl, struct ingest_cache *ic);
 
 void session_alert_watch(struct session *s, int what);
+void session_changed(struct session *s, int what);
+unsigned session_get_changes(struct session *s, int what);
 void add_facet(struct session *s, const char *type, const char *value, int count);
 
 int session_check_cluster_limit(struct session *se, struct record_cluster *rec);
+void session_get_string_pool_status(struct session *session,
+                                    size_t *unique_bytes, size_t *saved_bytes);
 
 void perform_termlist(struct http_channel *c, struct session *se, const char *name, int num, int version);
 void session_log(struct session *s, int level, const char *fmt, ...)
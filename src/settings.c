@@ -84,11 +84,20 @@ static char *hard_settings[] = {
     0
 };
 
+// Hash index over dictionary entries; replaced as a whole when it grows
+struct setting_index
+{
+    int num_buckets;
+    int *buckets;  // first entry of each bucket or -1
+    int *next;     // next entry in same bucket or -1; one per dict slot
+};
+
 struct setting_dictionary
 {
     char **dict;
     int size;
     int num;
+    struct setting_index *index;
 };
 
 // This establishes the precedence of wildcard expressions
@@ -102,21 +111,81 @@ int settings_num(struct conf_service *service)
     return service->dictionary->num;
 }
 
+/* Length of the part of name that identifies a dictionary entry:
+   "pz:foo:" for "pz:foo:bar" style names, the whole name otherwise */
+static size_t settings_key_len(const char *name)
+{
+    const char *p;
+
+    if (!strncmp("pz:", name, 3) && (p = strchr(name + 3, ':')))
+        return (p - name) + 1;
+    return strlen(name);
+}
+
+static int settings_key_match(const char *name, size_t len, const char *entry)
+{
+    return settings_key_len(entry) == len && !memcmp(name, entry, len);
+}
+
+static unsigned settings_key_hash(const char *name, size_t len)
+{
+    unsigned h = 0;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        h = h * 65509 + (unsigned char) name[i];
+    return h;
+}
+
+static void settings_index_add(struct setting_index *index,
+                               struct setting_dictionary *dictionary, int i)
+{
+    const char *name = dictionary->dict[i];
+    size_t len = settings_key_len(name);
+    unsigned b = settings_key_hash(name, len) % index->num_buckets;
+    int *ip = &index->buckets[b];
+
+    /* earlier entries take precedence: append at end of chain */
+    while (*ip != -1)
+    {
+        if (settings_key_match(name, len, dictionary->dict[*ip]))
+            return;
+        ip = &index->next[*ip];
+    }
+    index->next[i] = -1;
+    *ip = i;
+}
+
+// Build a new index able to hold dictionary->size entries
+static void settings_index_build(struct setting_dictionary *dictionary,
+                                 NMEM nmem)
+{
+    struct setting_index *index = nmem_malloc(nmem, sizeof(*index));
+    int i;
+
+    index->num_buckets = dictionary->size * 2 + 1;
+    index->buckets = nmem_malloc(nmem, index->num_buckets * sizeof(int));
+    for (i = 0; i < index->num_buckets; i++)
+        index->buckets[i] = -1;
+    index->next = nmem_malloc(nmem, dictionary->size * sizeof(int));
+    for (i = 0; i < dictionary->num; i++)
+        settings_index_add(index, dictionary, i);
+    dictionary->index = index;
+}
+
 /* Find and possible create a new dictionary entry. Pass valid NMEM pointer if creation is allowed, otherwise null */
 static int settings_index_lookup(struct setting_dictionary *dictionary, const char *name, NMEM nmem)
 {
-    size_t maxlen;
+    struct setting_index *index = dictionary->index;
+    size_t len;
     int i;
-    const char *p;
 
     assert(name);
 
-    if (!strncmp("pz:", name, 3) && (p = strchr(name + 3, ':')))
-        maxlen = (p - name) + 1;
-    else
-        maxlen = strlen(name) + 1;
-    for (i = 0; i < dictionary->num; i++)
-        if (!strncmp(name, dictionary->dict[i], maxlen))
+    len = settings_key_len(name);
+    for (i = index->buckets[settings_key_hash(name, len) % index->num_buckets];
+         i != -1; i = index->next[i])
+        if (settings_key_match(name, len, dictionary->dict[i]))
             return i;
     if (!nmem)
         return -1;
@@ -129,9 +198,10 @@ static int settings_index_lookup(struct setting_dictionary *dictionary, const ch
         memcpy(tmp, dictionary->dict, dictionary->size * sizeof(char*));
         dictionary->dict = tmp;
         dictionary->size *= 2;
+        settings_index_build(dictionary, nmem);
     }
-    dictionary->dict[dictionary->num] = nmem_strdup(nmem, name);
-    dictionary->dict[dictionary->num][maxlen-1] = '\0';
+    dictionary->dict[dictionary->num] = nmem_strdupn(nmem, name, len);
+    settings_index_add(dictionary->index, dictionary, dictionary->num);
     return dictionary->num++;
 }
 
@@ -519,6 +589,7 @@ static void initialize_hard_settings(struct conf_service *service)
     dict->size = (sizeof(hard_settings) - sizeof(char*)) / sizeof(char*);
     memcpy(dict->dict, hard_settings, dict->size * sizeof(char*));
     dict->num = dict->size;
+    settings_index_build(dict, service->nmem);
 }
 
 // Read any settings names introduced in service definition (config) and add to dictionary
@@ -531,7 +602,7 @@ void initialize_soft_settings(struct conf_service *service)
         struct conf_metadata *md = &service->metadata[i];
 
         if (md->setting != Metadata_setting_no)
-            settings_create_offset(service, md->name);
+            md->setting_offset = settings_create_offset(service, md->name);
 
         // Also create setting for some metadata attributes.
         if (md->limitmap) {
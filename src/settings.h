@@ -78,6 +78,7 @@ int settings_read_node(struct conf_service *service, xmlNode *n, int pass);
 int settings_num(struct conf_service *service);
 int settings_create_offset(struct conf_service *service, const char *name);
 int settings_lookup_offset(struct conf_service *service, const char *name);
+char *settings_name(struct conf_service *service, int offset);
 void init_settings(struct conf_service *service);
 int settings_read_node_x(xmlNode *n,
                          void *client_data,
@@ -0,0 +1,156 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file string_pool.c
+    \brief Interning of strings in NMEM
+
+    Metadata values such as language, medium, publisher and author
+    names recur in many records of a session. A string pool keeps one
+    copy of each distinct string. The pool and its strings are allocated
+    from an NMEM handle and so live exactly as long as that.
+*/
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "string_pool.h"
+#include "jenkins_hash.h"
+
+struct string_pool_entry {
+    const char *str;
+    unsigned hash;
+    struct string_pool_entry *next;
+};
+
+struct string_pool_s {
+    NMEM nmem;
+    struct string_pool_entry **buckets;
+    unsigned hash_size;
+    unsigned no_entries;
+    size_t unique_bytes;
+    size_t saved_bytes;    /* duplicates not stored (gross) */
+    size_t overhead_bytes; /* entries and bucket tables */
+};
+
+static struct string_pool_entry **alloc_buckets(string_pool_t sp,
+                                                unsigned size)
+{
+    struct string_pool_entry **b = nmem_malloc(sp->nmem, size * sizeof(*b));
+    memset(b, 0, size * sizeof(*b));
+    sp->overhead_bytes += size * sizeof(*b);
+    return b;
+}
+
+string_pool_t string_pool_create(NMEM nmem)
+{
+    string_pool_t sp = nmem_malloc(nmem, sizeof(*sp));
+    sp->nmem = nmem;
+    sp->hash_size = 256;
+    sp->no_entries = 0;
+    sp->unique_bytes = 0;
+    sp->saved_bytes = 0;
+    sp->overhead_bytes = sizeof(*sp);
+    sp->buckets = alloc_buckets(sp, sp->hash_size);
+    return sp;
+}
+
+/* double table size. Old table is left in NMEM; it's freed with the rest */
+static void string_pool_grow(string_pool_t sp)
+{
+    unsigned new_size = sp->hash_size * 2;
+    struct string_pool_entry **nb = alloc_buckets(sp, new_size);
+    unsigned i;
+
+    for (i = 0; i < sp->hash_size; i++)
+    {
+        struct string_pool_entry *e = sp->buckets[i];
+        while (e)
+        {
+            struct string_pool_entry *e_next = e->next;
+            e->next = nb[e->hash % new_size];
+            nb[e->hash % new_size] = e;
+            e = e_next;
+        }
+    }
+    sp->buckets = nb;
+    sp->hash_size = new_size;
+}
+
+/** \brief returns shared copy of string
+    \param sp string pool
+    \param str string to be interned
+    \returns copy of str which lives as long as the pool's NMEM
+
+    The result must not be modified.
+*/
+const char *string_pool_intern(string_pool_t sp, const char *str)
+{
+    unsigned h = jenkins_hash((const unsigned char *) str);
+    struct string_pool_entry *e;
+
+    for (e = sp->buckets[h % sp->hash_size]; e; e = e->next)
+        if (e->hash == h && !strcmp(e->str, str))
+        {
+            sp->saved_bytes += strlen(str) + 1;
+            return e->str;
+        }
+    if (sp->no_entries >= sp->hash_size)
+        string_pool_grow(sp);
+    e = nmem_malloc(sp->nmem, sizeof(*e));
+    sp->overhead_bytes += sizeof(*e);
+    e->str = nmem_strdup(sp->nmem, str);
+    e->hash = h;
+    e->next = sp->buckets[h % sp->hash_size];
+    sp->buckets[h % sp->hash_size] = e;
+    sp->no_entries++;
+    sp->unique_bytes += strlen(str) + 1;
+    return e->str;
+}
+
+/** \brief returns memory use of pool
+    \param sp string pool
+    \param unique_bytes bytes of distinct strings (result)
+    \param saved_bytes bytes saved (result)
+
+    saved_bytes is the size of duplicates that were not stored less what
+    the pool itself uses for entries and bucket tables (including tables
+    left behind when growing), so it never overstates the saving.
+*/
+void string_pool_stat(string_pool_t sp, size_t *unique_bytes,
+                      size_t *saved_bytes)
+{
+    *unique_bytes = sp ? sp->unique_bytes : 0;
+    *saved_bytes = 0;
+    if (sp && sp->saved_bytes > sp->overhead_bytes)
+        *saved_bytes = sp->saved_bytes - sp->overhead_bytes;
+}
+
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
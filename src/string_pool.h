@@ -0,0 +1,47 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+/** \file string_pool.h
+    \brief Interning of strings in NMEM
+*/
+
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <yaz/nmem.h>
+
+typedef struct string_pool_s *string_pool_t;
+
+string_pool_t string_pool_create(NMEM nmem);
+const char *string_pool_intern(string_pool_t sp, const char *str);
+void string_pool_stat(string_pool_t sp, size_t *unique_bytes,
+                      size_t *saved_bytes);
+
+#endif
+
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -47,9 +47,14 @@ struct termlist
 
     int no_entries;
     NMEM nmem;
+    string_pool_t strings;
 };
 
-struct termlist *termlist_create(NMEM nmem)
+/** \brief creates termlist
+    \param nmem memory for termlist
+    \param strings pool for terms (0 for plain NMEM copies)
+*/
+struct termlist *termlist_create(NMEM nmem, string_pool_t strings)
 {
     struct termlist *res = nmem_malloc(nmem, sizeof(struct termlist));
     res->hash_size = 399;
@@ -57,6 +62,7 @@ struct termlist *termlist_create(NMEM nmem)
         nmem_malloc(nmem, res->hash_size * sizeof(struct termlist_bucket*));
     memset(res->hashtable, 0, res->hash_size * sizeof(struct termlist_bucket*));
     res->nmem = nmem;
+    res->strings = strings;
     res->no_entries = 0;
     return res;
 }
@@ -84,9 +90,19 @@ void termlist_insert(struct termlist *tl, const char *display_term,
     {
         struct termlist_bucket *new = nmem_malloc(tl->nmem,
                 sizeof(struct termlist_bucket));
-        new->term.norm_term = nmem_strdup(tl->nmem, buf);
-        new->term.display_term = *display_term ?
-            nmem_strdup(tl->nmem, display_term) : new->term.norm_term;
+        if (tl->strings)
+        {
+            new->term.norm_term = string_pool_intern(tl->strings, buf);
+            new->term.display_term = *display_term ?
+                string_pool_intern(tl->strings, display_term) :
+                new->term.norm_term;
+        }
+        else
+        {
+            new->term.norm_term = nmem_strdup(tl->nmem, buf);
+            new->term.display_term = *display_term ?
+                nmem_strdup(tl->nmem, display_term) : new->term.norm_term;
+        }
         new->term.frequency = freq;
         new->next = 0;
         *p = new;
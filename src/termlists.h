@@ -21,17 +21,18 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define TERMLISTS_H
 
 #include <yaz/nmem.h>
+#include "string_pool.h"
 
 struct termlist_score
 {
-    char *norm_term;
-    char *display_term;
+    const char *norm_term;
+    const char *display_term;
     int frequency;
 };
 
 struct termlist;
 
-struct termlist *termlist_create(NMEM nmem);
+struct termlist *termlist_create(NMEM nmem, string_pool_t strings);
 void termlist_insert(struct termlist *tl, const char *display_term,
                      const char *norm_term, int freq);
 struct termlist_score **termlist_highscore(struct termlist *tl, int *len,
@@ -0,0 +1,116 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <yaz/test.h>
+#include <yaz/wrbuf.h>
+
+#include "charsets.h"
+#include "charset_cache.h"
+
+static int test_mergekey(pp2_charset_fact_t pft, const char *input,
+                         const char *expect_output)
+{
+    int ret = 0;
+    WRBUF norm_wr = wrbuf_alloc();
+
+    if (!pp2_charset_fact_normalize(pft, "mergekey", input, norm_wr, 0)
+        && !strcmp(expect_output, wrbuf_cstr(norm_wr)))
+        ret = 1;
+    wrbuf_destroy(norm_wr);
+    return ret;
+}
+
+static void tst(void)
+{
+    struct charset_cache_stat stat;
+    pp2_charset_fact_t pft;
+    WRBUF w = wrbuf_alloc();
+
+    charset_cache_init(32);
+    pft = pp2_charset_fact_create();
+
+    YAZ_CHECK(test_mergekey(pft, "The Art of  Computer", "the art of computer"));
+    YAZ_CHECK(test_mergekey(pft, "The Art of  Computer", "the art of computer"));
+    YAZ_CHECK(test_mergekey(pft, "", ""));
+
+    charset_cache_get_stat(&stat);
+    YAZ_CHECK_EQ(stat.hits, 1);
+    YAZ_CHECK_EQ(stat.misses, 2);
+    YAZ_CHECK_EQ(stat.entries, 2);
+
+    YAZ_CHECK_EQ(pp2_charset_fact_normalize(pft, "nosuchchain", "x", w, 0),
+                 -1);
+
+    /* same input, different mode: separate entries */
+    YAZ_CHECK_EQ(pp2_charset_fact_sortkey(pft, "sort", "The Art", 1, w), 0);
+    YAZ_CHECK(!strcmp(wrbuf_cstr(w), "art"));
+    YAZ_CHECK_EQ(pp2_charset_fact_sortkey(pft, "sort", "The Art", 0, w), 0);
+    YAZ_CHECK(!strcmp(wrbuf_cstr(w), "the art"));
+    YAZ_CHECK_EQ(pp2_charset_fact_sortkey(pft, "sort", "The Art", 1, w), 0);
+    YAZ_CHECK(!strcmp(wrbuf_cstr(w), "art"));
+
+    /* cache is bounded */
+    {
+        int i;
+        for (i = 0; i < 100; i++)
+        {
+            char tmp[20];
+            sprintf(tmp, "word %d", i);
+            pp2_charset_fact_normalize(pft, "facet", tmp, w, 0);
+        }
+    }
+    charset_cache_get_stat(&stat);
+    YAZ_CHECK(stat.entries <= stat.max_entries);
+    YAZ_CHECK(stat.evictions > 0);
+
+    /* entries go away with their chain */
+    pp2_charset_fact_destroy(pft);
+    charset_cache_get_stat(&stat);
+    YAZ_CHECK_EQ(stat.entries, 0);
+
+    charset_cache_destroy();
+    wrbuf_destroy(w);
+}
+
+int main(int argc, char **argv)
+{
+    YAZ_CHECK_INIT(argc, argv);
+    YAZ_CHECK_LOG();
+
+    tst();
+
+    YAZ_CHECK_TERM;
+}
+
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -0,0 +1,186 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <yaz/test.h>
+#include <yaz/xmalloc.h>
+
+#include "ppmutex.h"
+#include "disk_cache.h"
+
+#define DIR "test_disk_cache.d"
+
+static search_cache_entry_t make_entry(const char *key, int num, int size)
+{
+    search_cache_entry_t e = search_cache_entry_new(key, 0, num);
+    char *rec = xmalloc(size + 40);
+    int i;
+
+    search_cache_entry_set_hits(e, 42);
+    search_cache_entry_add_facet(e, "subject", "Cats", 7);
+    for (i = 0; i < num; i++)
+    {
+        int len = sprintf(rec, "<record>%d", i);
+        memset(rec + len, 'x', size);
+        strcpy(rec + len + size, "</record>");
+        search_cache_entry_add_record(e, i + 1, rec);
+    }
+    xfree(rec);
+    return e;
+}
+
+static void clean_dir(void)
+{
+    unsigned *nos;
+    int i, num = disk_cache_segments(DIR, &nos);
+
+    for (i = 0; i < num; i++)
+    {
+        char fname[256];
+        disk_cache_segment_name(fname, sizeof(fname), DIR, nos[i]);
+        unlink(fname);
+    }
+    xfree(nos);
+}
+
+static void tst(void)
+{
+    struct disk_cache_stat stat;
+    search_cache_entry_t e;
+    const char *term;
+    int freq, position, i;
+
+    mkdir(DIR, 0777);
+    clean_dir();
+
+    /* disabled */
+    YAZ_CHECK_EQ(disk_cache_init(0, 1024, 60), 0);
+    YAZ_CHECK(!disk_cache_enabled());
+    YAZ_CHECK(!disk_cache_lookup("k"));
+
+    YAZ_CHECK_EQ(disk_cache_init(DIR "/none", 1024, 60), -1);
+
+    YAZ_CHECK_EQ(disk_cache_init(DIR, 1024, 60), 0);
+    YAZ_CHECK(disk_cache_enabled());
+    YAZ_CHECK(!disk_cache_lookup("k"));
+
+    e = make_entry("k", 3, 10);
+    disk_cache_store(e);
+    search_cache_entry_destroy(e);
+    e = make_entry("k", 4, 10); /* most recent one wins */
+    disk_cache_store(e);
+    search_cache_entry_destroy(e);
+
+    /* survives restart */
+    disk_cache_destroy();
+    YAZ_CHECK_EQ(disk_cache_init(DIR, 1024, 60), 0);
+    disk_cache_get_stat(&stat);
+    YAZ_CHECK_EQ(stat.entries, 1);
+    YAZ_CHECK_EQ(stat.segments, 1);
+
+    /* search cache finds it even when memory cache is disabled */
+    e = search_cache_lookup("k");
+    YAZ_CHECK(e);
+    if (e)
+    {
+        YAZ_CHECK(search_cache_entry_hits(e) == 42);
+        YAZ_CHECK(!search_cache_entry_suggestions(e));
+        YAZ_CHECK_EQ(search_cache_entry_num_records(e), 4);
+        YAZ_CHECK(!strncmp(search_cache_entry_record(e, 3, &position),
+                           "<record>3xxx", 12));
+        YAZ_CHECK_EQ(position, 4);
+        YAZ_CHECK_EQ(search_cache_entry_num_facets(e), 1);
+        YAZ_CHECK(!strcmp(search_cache_entry_facet(e, 0, &term, &freq),
+                          "subject"));
+        YAZ_CHECK_EQ(freq, 7);
+        search_cache_entry_destroy(e);
+    }
+
+    /* an entry cut by a crash is dropped at start */
+    disk_cache_destroy();
+    {
+        char fname[256];
+        FILE *f;
+        disk_cache_segment_name(fname, sizeof(fname), DIR, 1);
+        f = fopen(fname, "ab");
+        YAZ_CHECK(f);
+        if (f)
+        {
+            fwrite("\105\062\132\120\377\377", 1, 6, f);
+            fclose(f);
+        }
+    }
+    YAZ_CHECK_EQ(disk_cache_init(DIR, 64, 60), 0);
+    e = disk_cache_lookup("k");
+    YAZ_CHECK(e);
+    search_cache_entry_destroy(e);
+
+    /* size budget: oldest segments are removed */
+    for (i = 0; i < 20; i++)
+    {
+        char key[20];
+        sprintf(key, "key %d", i);
+        e = make_entry(key, 10, 1000);
+        disk_cache_store(e);
+        search_cache_entry_destroy(e);
+    }
+    disk_cache_get_stat(&stat);
+    YAZ_CHECK(stat.bytes <= stat.max_bytes);
+    YAZ_CHECK(stat.evictions > 0);
+    YAZ_CHECK_EQ(stat.writes, 20);
+    YAZ_CHECK(!disk_cache_lookup("k"));
+    e = disk_cache_lookup("key 19");
+    YAZ_CHECK(e);
+    search_cache_entry_destroy(e);
+
+    disk_cache_destroy();
+    clean_dir();
+    rmdir(DIR);
+}
+
+int main(int argc, char **argv)
+{
+    YAZ_CHECK_INIT(argc, argv);
+    YAZ_CHECK_LOG();
+    pazpar2_mutex_init();
+
+    tst();
+
+    YAZ_CHECK_TERM;
+}
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -0,0 +1,226 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <yaz/test.h>
+#include <yaz/wrbuf.h>
+
+#include <libxml/parser.h>
+
+#include "marcmap_native.h"
+
+static const char *map_fname = "test_marcmap_native.mmap";
+
+/* fields as tag, then subfields as code and value; 0 ends each */
+static const char *fields[] = {
+    "001", "12345", 0,
+    "100", "a", "Doe, John", "d", "1950-", 0,
+    "245", "a", "Title ", "b", "remainder", "h", "[film]", 0,
+    "650", "a", "Fish", 0,
+    "650", "a", "Cats and dogs", "x", "History", 0,
+    0
+};
+
+static void make_iso2709(WRBUF w)
+{
+    WRBUF dir = wrbuf_alloc();
+    WRBUF data = wrbuf_alloc();
+    const char **f = fields;
+    int base;
+
+    while (*f)
+    {
+        const char *tag = *f++;
+        size_t start = wrbuf_len(data);
+        if (!strncmp(tag, "00", 2))
+            wrbuf_puts(data, *f++);
+        else
+        {
+            wrbuf_puts(data, "  ");
+            while (*f)
+            {
+                wrbuf_printf(data, "\x1f%s", *f++);
+                wrbuf_puts(data, *f++);
+            }
+        }
+        f++;
+        wrbuf_putc(data, 0x1e);
+        wrbuf_printf(dir, "%s%04d%05d", tag,
+                     (int) (wrbuf_len(data) - start), (int) start);
+    }
+    wrbuf_putc(dir, 0x1e);
+    wrbuf_putc(data, 0x1d);
+    base = 24 + wrbuf_len(dir);
+    wrbuf_printf(w, "%05dnam a22%05d   4500",
+                 (int) (base + wrbuf_len(data)), base);
+    wrbuf_write(w, wrbuf_buf(dir), wrbuf_len(dir));
+    wrbuf_write(w, wrbuf_buf(data), wrbuf_len(data));
+    wrbuf_destroy(dir);
+    wrbuf_destroy(data);
+}
+
+static void make_xml(WRBUF w, int turbo)
+{
+    const char **f = fields;
+
+    wrbuf_puts(w, turbo ? "<r xmlns=\"http://www.indexdata.com/turbomarc\">"
+               : "<record xmlns=\"http://www.loc.gov/MARC21/slim\">");
+    while (*f)
+    {
+        const char *tag = *f++;
+        if (!strncmp(tag, "00", 2))
+        {
+            if (turbo)
+                wrbuf_printf(w, "<c%s>", tag);
+            else
+                wrbuf_printf(w, "<controlfield tag=\"%s\">", tag);
+            wrbuf_xmlputs(w, *f++);
+            wrbuf_printf(w, turbo ? "</c%s>" : "</controlfield>", tag);
+        }
+        else
+        {
+            if (turbo)
+                wrbuf_printf(w, "<d%s i1=\" \" i2=\" \">", tag);
+            else
+                wrbuf_printf(w, "<datafield tag=\"%s\" ind1=\" \" "
+                             "ind2=\" \">", tag);
+            while (*f)
+            {
+                const char *code = *f++;
+                if (turbo)
+                    wrbuf_printf(w, "<s%s>", code);
+                else
+                    wrbuf_printf(w, "<subfield code=\"%s\">", code);
+                wrbuf_xmlputs(w, *f++);
+                wrbuf_printf(w, turbo ? "</s%s>" : "</subfield>", code);
+            }
+            wrbuf_printf(w, turbo ? "</d%s>" : "</datafield>", tag);
+        }
+        f++;
+    }
+    wrbuf_puts(w, turbo ? "</r>" : "</record>");
+}
+
+static int same_doc(xmlDoc *a, xmlDoc *b)
+{
+    xmlChar *buf_a, *buf_b;
+    int len_a, len_b, ret;
+
+    if (!a || !b)
+        return 0;
+    xmlDocDumpMemory(a, &buf_a, &len_a);
+    xmlDocDumpMemory(b, &buf_b, &len_b);
+    ret = len_a == len_b && !memcmp(buf_a, buf_b, len_a);
+    if (!ret)
+        yaz_log(YLOG_WARN, "%s\n%s", buf_a, buf_b);
+    xmlFree(buf_a);
+    xmlFree(buf_b);
+    return ret;
+}
+
+static void tst(void)
+{
+    NMEM nmem = nmem_create();
+    FILE *f = fopen(map_fname, "w");
+    struct marcmap *mm;
+    struct marcmap_table *t;
+    WRBUF w = wrbuf_alloc();
+    xmlDoc *xml_doc, *ref_doc, *doc;
+
+    YAZ_CHECK(f);
+    if (!f)
+        return;
+    fputs("001 $ id\n"
+          "100 a author\n"
+          "100 d author-date\n"
+          "245 a title\n"
+          "245 b title-remainder\n"
+          "650 a subject\n"
+          "650 * subject-long\n"
+          "999 a none\n", f);
+    fclose(f);
+    mm = marcmap_load(map_fname, nmem);
+    YAZ_CHECK(mm);
+    t = marcmap_table_create(mm, nmem);
+    YAZ_CHECK(t);
+
+    make_xml(w, 0);
+    xml_doc = xmlParseMemory(wrbuf_buf(w), wrbuf_len(w));
+    YAZ_CHECK(xml_doc);
+    ref_doc = marcmap_apply(mm, xml_doc);
+
+    wrbuf_rewind(w);
+    make_iso2709(w);
+    doc = marcmap_apply_iso2709(t, wrbuf_buf(w), wrbuf_len(w), "utf-8");
+    YAZ_CHECK(same_doc(ref_doc, doc));
+    if (doc)
+        xmlFreeDoc(doc);
+
+    /* bad record */
+    YAZ_CHECK(!marcmap_apply_iso2709(t, wrbuf_buf(w), 20, "utf-8"));
+    YAZ_CHECK(!marcmap_apply_iso2709(t, "x0000nam a2200000   4500x",
+                                     25, "utf-8"));
+
+    wrbuf_rewind(w);
+    make_xml(w, 1);
+    doc = marcmap_apply_turbomarc(t, wrbuf_buf(w), wrbuf_len(w));
+    YAZ_CHECK(same_doc(ref_doc, doc));
+    if (doc)
+        xmlFreeDoc(doc);
+    YAZ_CHECK(!marcmap_apply_turbomarc(t, "<r><c001>", 9));
+
+    xmlFreeDoc(ref_doc);
+    xmlFreeDoc(xml_doc);
+
+    /* tags that are not numeric are left to marcmap_apply */
+    f = fopen(map_fname, "w");
+    fputs("FMT $ format\n", f);
+    fclose(f);
+    mm = marcmap_load(map_fname, nmem);
+    YAZ_CHECK(!marcmap_table_create(mm, nmem));
+
+    remove(map_fname);
+    wrbuf_destroy(w);
+    nmem_destroy(nmem);
+}
+
+int main(int argc, char **argv)
+{
+    YAZ_CHECK_INIT(argc, argv);
+    YAZ_CHECK_LOG();
+
+    tst();
+
+    YAZ_CHECK_TERM;
+}
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
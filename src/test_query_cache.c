@@ -0,0 +1,137 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <yaz/test.h>
+
+#include "ppmutex.h"
+#include "query_cache.h"
+
+static void tst_maps(void)
+{
+    struct query_cache_stat stat;
+    query_cache_map_t m1, m2;
+    CCL_bibset b = ccl_qual_mk();
+
+    /* disabled: map is handed back, but not cached */
+    YAZ_CHECK(!query_cache_map_lookup("a"));
+    m1 = query_cache_map_add("a", b);
+    YAZ_CHECK(m1);
+    YAZ_CHECK(query_cache_map_bibset(m1) == b);
+    YAZ_CHECK_EQ(query_cache_map_id(m1), 0);
+    query_cache_map_release(m1);
+
+    query_cache_init(2);
+    YAZ_CHECK(!query_cache_map_lookup("a"));
+    b = ccl_qual_mk();
+    m1 = query_cache_map_add("a", b);
+    YAZ_CHECK(query_cache_map_id(m1) != 0);
+    m2 = query_cache_map_lookup("a");
+    YAZ_CHECK(m2 == m1);
+    query_cache_map_release(m2);
+
+    /* map stays valid for holder after being evicted */
+    query_cache_map_release(query_cache_map_add("b", ccl_qual_mk()));
+    query_cache_map_release(query_cache_map_add("c", ccl_qual_mk()));
+    YAZ_CHECK(!query_cache_map_lookup("a"));
+    YAZ_CHECK(query_cache_map_bibset(m1) == b);
+    query_cache_map_release(m1);
+
+    /* duplicate is returned, but not cached */
+    m1 = query_cache_map_lookup("c");
+    YAZ_CHECK(m1);
+    m2 = query_cache_map_add("c", ccl_qual_mk());
+    YAZ_CHECK(m2 != m1);
+    YAZ_CHECK_EQ(query_cache_map_id(m2), 0);
+    query_cache_map_release(m1);
+    query_cache_map_release(m2);
+
+    query_cache_get_stat(&stat);
+    YAZ_CHECK_EQ(stat.maps, 2);
+    YAZ_CHECK_EQ(stat.max_entries, 2);
+    YAZ_CHECK_EQ(stat.map_hits, 2);
+    YAZ_CHECK_EQ(stat.map_misses, 2);
+    query_cache_destroy();
+}
+
+static void tst_queries(void)
+{
+    struct query_cache_stat stat;
+    WRBUF w = wrbuf_alloc();
+
+    /* disabled */
+    query_cache_add("q", "x");
+    YAZ_CHECK_EQ(query_cache_lookup("q", w), 0);
+
+    query_cache_init(2);
+    YAZ_CHECK_EQ(query_cache_lookup("q", w), 0);
+    query_cache_add("q", "@attr 1=4 x");
+    YAZ_CHECK_EQ(query_cache_lookup("q", w), 1);
+    YAZ_CHECK(!strcmp(wrbuf_cstr(w), "@attr 1=4 x"));
+
+    /* failed translation is remembered */
+    query_cache_add("bad", 0);
+    wrbuf_rewind(w);
+    YAZ_CHECK_EQ(query_cache_lookup("bad", w), -1);
+    YAZ_CHECK_EQ(wrbuf_len(w), 0);
+
+    /* duplicate keeps first */
+    query_cache_add("q", "y");
+    YAZ_CHECK_EQ(query_cache_lookup("q", w), 1);
+    YAZ_CHECK(!strcmp(wrbuf_cstr(w), "@attr 1=4 x"));
+
+    /* least recently used goes first */
+    query_cache_add("r", "z");
+    YAZ_CHECK_EQ(query_cache_lookup("bad", w), 0);
+    YAZ_CHECK_EQ(query_cache_lookup("q", w), 1);
+
+    query_cache_get_stat(&stat);
+    YAZ_CHECK_EQ(stat.queries, 2);
+    YAZ_CHECK_EQ(stat.query_hits, 4);
+    YAZ_CHECK_EQ(stat.query_misses, 2);
+    query_cache_destroy();
+    wrbuf_destroy(w);
+}
+
+int main(int argc, char **argv)
+{
+    YAZ_CHECK_INIT(argc, argv);
+    YAZ_CHECK_LOG();
+    pazpar2_mutex_init();
+
+    tst_maps();
+    tst_queries();
+
+    YAZ_CHECK_TERM;
+}
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
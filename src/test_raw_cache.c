@@ -0,0 +1,99 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <yaz/test.h>
+
+#include "raw_cache.h"
+
+static void tst(void)
+{
+    struct raw_cache_stat stat;
+    WRBUF w = wrbuf_alloc();
+    int i;
+
+    /* disabled */
+    raw_cache_add("k", "abc", 3);
+    YAZ_CHECK(!raw_cache_lookup("k", w));
+
+    raw_cache_init(16, 60);
+    YAZ_CHECK(raw_cache_enabled());
+    YAZ_CHECK(!raw_cache_lookup("k", w));
+
+    /* binary data */
+    raw_cache_add("k", "a\0b", 3);
+    YAZ_CHECK(raw_cache_lookup("k", w));
+    YAZ_CHECK_EQ(wrbuf_len(w), 3);
+    YAZ_CHECK(!memcmp(wrbuf_buf(w), "a\0b", 3));
+
+    /* replaced */
+    raw_cache_add("k", "xyz", 3);
+    wrbuf_rewind(w);
+    YAZ_CHECK(raw_cache_lookup("k", w));
+    YAZ_CHECK(!strcmp(wrbuf_cstr(w), "xyz"));
+
+    raw_cache_get_stat(&stat);
+    YAZ_CHECK_EQ(stat.entries, 1);
+    YAZ_CHECK_EQ(stat.hits, 2);
+    YAZ_CHECK_EQ(stat.misses, 1);
+
+    /* memory budget is respected; least recently used go first */
+    for (i = 0; i < 100; i++)
+    {
+        char key[20], rec[1000];
+        sprintf(key, "key %d", i);
+        memset(rec, 'r', sizeof(rec));
+        raw_cache_add(key, rec, sizeof(rec));
+        wrbuf_rewind(w);
+        YAZ_CHECK(raw_cache_lookup("key 0", w));
+    }
+    raw_cache_get_stat(&stat);
+    YAZ_CHECK(stat.bytes <= stat.max_bytes);
+    YAZ_CHECK(stat.evictions > 0);
+    YAZ_CHECK(!raw_cache_lookup("key 1", w));
+    YAZ_CHECK(raw_cache_lookup("key 99", w));
+
+    raw_cache_destroy();
+    wrbuf_destroy(w);
+}
+
+int main(int argc, char **argv)
+{
+    YAZ_CHECK_INIT(argc, argv);
+    YAZ_CHECK_LOG();
+
+    tst();
+
+    YAZ_CHECK_TERM;
+}
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
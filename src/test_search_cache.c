@@ -0,0 +1,141 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <yaz/test.h>
+
+#include "ppmutex.h"
+#include "search_cache.h"
+
+static search_cache_entry_t make_entry(const char *key, int num)
+{
+    search_cache_entry_t e = search_cache_entry_create(key, 10, num);
+    int i;
+
+    search_cache_entry_set_hits(e, 1000);
+    search_cache_entry_set_suggestions(e, "speling=spelling");
+    search_cache_entry_add_facet(e, "author", "Knuth", 3);
+    for (i = 0; i < num; i++)
+    {
+        char rec[40];
+        sprintf(rec, "<record>%d</record>", i);
+        search_cache_entry_add_record(e, 11 + i, rec);
+    }
+    /* same position again is ignored */
+    search_cache_entry_add_record(e, 11, "<record>x</record>");
+    return e;
+}
+
+static void tst(void)
+{
+    struct search_cache_stat stat;
+    search_cache_entry_t e;
+    const char *term;
+    int freq, position;
+
+    /* disabled: nothing is created or found */
+    YAZ_CHECK(!search_cache_entry_create("k", 0, 10));
+    YAZ_CHECK(!search_cache_lookup("k"));
+
+    search_cache_init(64, 60);
+    YAZ_CHECK(!search_cache_lookup("k"));
+
+    e = make_entry("k", 5);
+    YAZ_CHECK_EQ(search_cache_entry_num_records(e), 5);
+    search_cache_add(e);
+    search_cache_entry_destroy(e);
+
+    e = search_cache_lookup("k");
+    YAZ_CHECK(e);
+    if (e)
+    {
+        YAZ_CHECK(search_cache_entry_hits(e) == 1000);
+        YAZ_CHECK(!strcmp(search_cache_entry_suggestions(e),
+                          "speling=spelling"));
+        YAZ_CHECK_EQ(search_cache_entry_num_facets(e), 1);
+        YAZ_CHECK(!strcmp(search_cache_entry_facet(e, 0, &term, &freq),
+                          "author"));
+        YAZ_CHECK(!strcmp(term, "Knuth"));
+        YAZ_CHECK_EQ(freq, 3);
+        YAZ_CHECK(!strcmp(search_cache_entry_record(e, 0, &position),
+                          "<record>0</record>"));
+        YAZ_CHECK_EQ(position, 11);
+        search_cache_entry_destroy(e);
+    }
+    YAZ_CHECK(!search_cache_lookup("other"));
+
+    search_cache_get_stat(&stat);
+    YAZ_CHECK_EQ(stat.entries, 1);
+    YAZ_CHECK_EQ(stat.hits, 1);
+    YAZ_CHECK_EQ(stat.misses, 2);
+
+    /* memory budget is respected */
+    {
+        int i;
+        for (i = 0; i < 200; i++)
+        {
+            char key[20];
+            sprintf(key, "key %d", i);
+            e = make_entry(key, 20);
+            search_cache_add(e);
+            search_cache_entry_destroy(e);
+        }
+    }
+    search_cache_get_stat(&stat);
+    YAZ_CHECK(stat.bytes <= stat.max_bytes);
+    YAZ_CHECK(stat.evictions > 0);
+
+    /* entry stays valid when it is evicted while in use */
+    e = search_cache_lookup("key 199");
+    YAZ_CHECK(e);
+    search_cache_destroy();
+    if (e)
+    {
+        YAZ_CHECK_EQ(search_cache_entry_num_records(e), 20);
+        search_cache_entry_destroy(e);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    YAZ_CHECK_INIT(argc, argv);
+    YAZ_CHECK_LOG();
+    pazpar2_mutex_init();
+
+    tst();
+
+    YAZ_CHECK_TERM;
+}
+
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
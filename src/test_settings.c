@@ -0,0 +1,118 @@
+/* This file is part of Pazpar2.
+   Copyright (C) 2006-2013 Index Data
+
+Pazpar2 is free software; you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free
+Software Foundation; either version 2, or (at your option) any later
+version.
+
+Pazpar2 is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or
+FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <yaz/test.h>
+
+#include "session.h"
+#include "settings.h"
+
+static void tst(void)
+{
+    struct conf_service service;
+    int num, foo, i;
+
+    memset(&service, 0, sizeof(service));
+    service.nmem = nmem_create();
+    init_settings(&service);
+    num = settings_num(&service);
+
+    /* exact names */
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "pz:piggyback"),
+                 PZ_PIGGYBACK);
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "pz:block_timeout"),
+                 PZ_BLOCK_TIMEOUT);
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "pz:piggybac"), -1);
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "pz:piggybackx"), -1);
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "title"), -1);
+
+    /* built-in prefix names */
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "pz:cclmap:x"), PZ_CCLMAP);
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "pz:cclmap:"), PZ_CCLMAP);
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "pz:limitmap:author"),
+                 PZ_LIMITMAP);
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "pz:cclmap"), -1);
+
+    /* earlier entries take precedence: no new entry for known names */
+    YAZ_CHECK_EQ(settings_create_offset(&service, "pz:cclmap:ti"), PZ_CCLMAP);
+    YAZ_CHECK_EQ(settings_create_offset(&service, "pz:xslt"), PZ_XSLT);
+    YAZ_CHECK_EQ(settings_num(&service), num);
+
+    /* unknown prefix names are stored as prefix */
+    foo = settings_create_offset(&service, "pz:foo:bar");
+    YAZ_CHECK_EQ(foo, num);
+    YAZ_CHECK(!strcmp(settings_name(&service, foo), "pz:foo:"));
+    YAZ_CHECK_EQ(settings_create_offset(&service, "pz:foo:baz"), foo);
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "pz:foo:"), foo);
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "pz:foo"), -1);
+    YAZ_CHECK_EQ(settings_num(&service), num + 1);
+
+    /* plain names; grows the dictionary and rebuilds the index */
+    for (i = 0; i < 200; i++)
+    {
+        char name[20];
+        sprintf(name, "user%d", i);
+        if (settings_create_offset(&service, name) != num + 1 + i)
+            break;
+    }
+    YAZ_CHECK_EQ(i, 200);
+    YAZ_CHECK_EQ(settings_num(&service), num + 201);
+    for (i = 0; i < 200; i++)
+    {
+        char name[20];
+        sprintf(name, "user%d", i);
+        if (settings_lookup_offset(&service, name) != num + 1 + i)
+            break;
+    }
+    YAZ_CHECK_EQ(i, 200);
+    YAZ_CHECK(!strcmp(settings_name(&service, num + 8), "user7"));
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "user200"), -1);
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "pz:piggyback"),
+                 PZ_PIGGYBACK);
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "pz:cclmap:au"), PZ_CCLMAP);
+    YAZ_CHECK_EQ(settings_lookup_offset(&service, "pz:foo:x"), foo);
+
+    nmem_destroy(service.nmem);
+}
+
+int main(int argc, char **argv)
+{
+    YAZ_CHECK_INIT(argc, argv);
+    YAZ_CHECK_LOG();
+
+    tst();
+
+    YAZ_CHECK_TERM;
+}
+
+/*
+ * Local variables:
+ * c-basic-offset: 4
+ * c-file-style: "Stroustrup"
+ * indent-tabs-mode: nil
+ * End:
+ * vim: shiftwidth=4 tabstop=8 expandtab
+ */
+
@@ -45,7 +45,9 @@ if test -z $curl; then
     echo "curl not found. $PREFIX can not be tested"
     exit 1
 fi
-GET='$curl --silent --output $OUT2 "$f"'
+GET='$curl --silent --dump-header $HEADERS --output $OUT2 "$f"'
+GET_ETAG='$curl --silent --header "If-None-Match: $etag" --output $OUT2 "$f"'
+GET_BG='$curl --silent --output $OUT2 "$f"'
 POST='$curl --silent --header "Content-Type: text/xml" --data-binary "@$postfile" --output $OUT2  "$f"'
 
 if [ -z "$SKIP_PAZPAR2" ] ; then
@@ -56,6 +58,7 @@ fi
 CFG=${PREFIX}.cfg
 URLS=${PREFIX}.urls
 VALGRINDLOG=${PREFIX}_valgrind.log
+HEADERS=${PREFIX}_headers.log
 
 if test -n "$PAZPAR2_USE_VALGRIND"; then
     valgrind --num-callers=30 --show-reachable=yes --leak-check=full --log-file=$VALGRINDLOG ../src/pazpar2 -X -l ${PREFIX}_pazpar2.log -f ${CFG} >${PREFIX}_extra_pazpar2.log 2>&1 &
@@ -83,41 +86,89 @@ fi
 # Set to success by default.. Will be set to non-zero in case of failure
 code=0
 
-# We can start test for real
+# Matches output of test $1 (URL $2) against its result
+check_result()
+{
+    OUT1=${srcdir}/${PREFIX}_$1.res
+    OUT2=${PREFIX}_$1.log
+    DIFF=${PREFIX}_$1.dif
+    if test ! -f $OUT2; then
+	touch $OUT2
+    fi
+    if test -f $OUT1 -a -z "$PAZPAR2_OVERRIDE_TEST"; then
+	if diff $OUT1 $OUT2 >$DIFF; then
+	    rm $DIFF
+	    rm $OUT2
+	else
+	    echo "Test $1: Failed. See $OUT1, $OUT2 and $DIFF"
+	    echo "URL: $2"
+	    code=1
+	fi
+    else
+	echo "Test $1: Making for the first time"
+	mv $OUT2 $OUT1
+	code=1
+    fi
+}
+
+# Waits for tests running in background and matches their output
+check_background()
+{
+    if test -n "$BG_PIDS"; then
+	wait $BG_PIDS
+    fi
+    for t in $BG_TESTS; do
+	check_result $t background
+    done
+    BG_PIDS=""
+    BG_TESTS=""
+}
+
+# We can start test for real. Tokens of the URL file:
+#   http..    URL to fetch; output is matched against result
+#   @http..   URL to fetch in background; matched by next wait
+#   wait      waits for URLs fetched in background
+#   etag      next URL is fetched with If-None-Match of the
+#             ETag returned for the previous one
+#   number    seconds to sleep
+#   other     file to POST to next URL
 testno=1
+etag=
+BG_PIDS=""
+BG_TESTS=""
 for f in `cat ${srcdir}/${URLS}`; do
     if echo $f | grep '^http' >/dev/null; then
-	OUT1=${srcdir}/${PREFIX}_${testno}.res
 	OUT2=${PREFIX}_${testno}.log
-	DIFF=${PREFIX}_${testno}.dif
-	rm -f $OUT2 $DIFF
+	rm -f $OUT2 ${PREFIX}_${testno}.dif
 	if [ -n "$DEBUG" ] ; then 
 	    echo "test $testno: $f" 
 	fi
 	if test -n "${postfile}"; then
 	    eval $POST
+	elif test -n "${etag}"; then
+	    eval $GET_ETAG
 	else
 	    eval $GET
 	fi
-	if test ! -f $OUT2; then
-	    touch $OUT2
-	fi
-	if test -f $OUT1 -a -z "$PAZPAR2_OVERRIDE_TEST"; then
-	    if diff $OUT1 $OUT2 >$DIFF; then
-		rm $DIFF
-		rm $OUT2
-	    else
-		echo "Test $testno: Failed. See $OUT1, $OUT2 and $DIFF"
-		echo "URL: $f"
-		code=1
-	    fi
-	else
-	    echo "Test $testno: Making for the first time"
-	    mv $OUT2 $OUT1
-	    code=1
-	fi
+	check_result $testno "$f"
 	testno=`expr $testno + 1`
 	postfile=
+	etag=
+    elif echo $f | grep '^@http' >/dev/null; then
+	f=`echo $f | sed 's/^@//'`
+	OUT2=${PREFIX}_${testno}.log
+	rm -f $OUT2 ${PREFIX}_${testno}.dif
+	if [ -n "$DEBUG" ] ; then 
+	    echo "test $testno (background): $f" 
+	fi
+	eval $GET_BG &
+	BG_PIDS="$BG_PIDS $!"
+	BG_TESTS="$BG_TESTS $testno"
+	testno=`expr $testno + 1`
+    elif test "$f" = "wait"; then
+	check_background
+    elif test "$f" = "etag"; then
+	etag=`sed -n 's/^ETag: *//p' $HEADERS | tr -d '\r'`
     elif echo $f | grep '^[0-9]' >/dev/null; then
 	if [ -n "$DEBUG" ] ; then 
 	    echo "Sleeping $f"
@@ -145,6 +196,7 @@ for f in `cat ${srcdir}/${URLS}`; do
 	fi
     fi
 done
+check_background
 
 # Kill programs
 
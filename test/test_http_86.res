@@ -0,0 +1,17 @@
+event: stat
+data: <stat>
+data:  <activeclients>0</activeclients>
+data:  <hits>0</hits>
+data:  <records>0</records>
+data:  <clients>0</clients>
+data:  <unconnected>0</unconnected>
+data:  <connecting>0</connecting>
+data:  <working>0</working>
+data:  <idle>0</idle>
+data:  <failed>0</failed>
+data:  <error>0</error>
+data:  <progress>0.00</progress>
+data: </stat>
+
+event: end
+
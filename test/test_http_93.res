@@ -0,0 +1,83 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<show><status>OK</status>
+<activeclients>0</activeclients>
+<merged>2</merged>
+<total>2</total>
+<start>0</start>
+<num>2</num>
+<hit>
+ <md-title>The religious teachers of Greece</md-title>
+ <md-date>1972</md-date>
+ <md-author>Adam, James</md-author>
+ <md-subject>Greek literature</md-subject>
+ <md-subject>Philosophy, Ancient</md-subject>
+ <md-subject>Greece</md-subject>
+ <md-description>Reprint of the 1909 ed., which was issued as the 1904-1906 Gifford lectures</md-description>
+ <location id="z3950.indexdata.com/marc"
+    name="Index Data MARC test server" checksum="2614320583">
+  <md-title>The religious teachers of Greece</md-title>
+  <md-date>1972</md-date>
+  <md-author>Adam, James</md-author>
+  <md-subject>Greek literature</md-subject>
+  <md-subject>Philosophy, Ancient</md-subject>
+  <md-subject>Greece</md-subject>
+  <md-description tag="500">Reprint of the 1909 ed., which was issued as the 1904-1906 Gifford lectures</md-description>
+  <md-description tag="504">Includes bibliographical references</md-description>
+  <md-test-usersetting>XXXXXXXXXX</md-test-usersetting>
+  <md-test-usersetting-2>test-usersetting-2 data: 
+        YYYYYYYYY</md-test-usersetting-2>
+ </location>
+ <count>1</count>
+ <relevance>48655</relevance>
+ <relevance_info>
+field=title content=The religious teachers of Greece.;
+teachers: w[1] += w(6) / (1+log2(1+lead_decay(0.000000) * length(2)));
+teachers: tf[1] += w[1](6) / length(5) (1.200000);
+relevance = 0;
+idf[1] = log(((1 + total(2))/termoccur(2));
+teachers: relevance += 100000 * tf[1](1.200000) * idf[1](0.405465) (48655);
+idf[2] = log(((1 + total(2))/termoccur(0));
+teachers: relevance += 100000 * tf[2](0.000000) * idf[2](0.000000) (0);
+score = relevance(48655);
+ </relevance_info>
+ <recid>content: title the religious teachers of greece author adam james medium book</recid>
+</hit>
+<hit>
+ <md-title>Technology programs that work</md-title>
+ <md-date>1984</md-date>
+ <md-subject>United States</md-subject>
+ <md-subject>Educational technology</md-subject>
+ <md-subject>Federal aid to education</md-subject>
+ <md-description>&quot;This directory was developed by the Technology for the National Diffusion Network Project, Teachers College, Columbia University pursuant to contract number OE-300-83-0253, U.S. Department of Education&quot;--T.p. verso</md-description>
+ <location id="z3950.indexdata.com/marc"
+    name="Index Data MARC test server" checksum="2788512872">
+  <md-title>Technology programs that work</md-title>
+  <md-date>1984</md-date>
+  <md-subject>United States</md-subject>
+  <md-subject>Educational technology</md-subject>
+  <md-subject>Federal aid to education</md-subject>
+  <md-description tag="500">&quot;Spons agency Office of Educational Research and Improvement&quot;--Doc. resume</md-description>
+  <md-description tag="500">&quot;This directory was developed by the Technology for the National Diffusion Network Project, Teachers College, Columbia University pursuant to contract number OE-300-83-0253, U.S. Department of Education&quot;--T.p. verso</md-description>
+  <md-description tag="500">Distributed to depository libraries in microfiche</md-description>
+  <md-description tag="500">&quot;December 1984.&quot;</md-description>
+  <md-description tag="500">Includes indexes</md-description>
+  <md-test-usersetting>XXXXXXXXXX</md-test-usersetting>
+  <md-test-usersetting-2>test-usersetting-2 data: 
+        YYYYYYYYY</md-test-usersetting-2>
+ </location>
+ <count>1</count>
+ <relevance>4054</relevance>
+ <relevance_info>
+field=description content=&amp;quot;This directory was developed by the Technology f ...;
+teachers: w[1] += w(3) / (1+log2(1+lead_decay(0.000000) * length(13)));
+teachers: tf[1] += w[1](3) / length(30) (0.100000);
+relevance = 0;
+idf[1] = log(((1 + total(2))/termoccur(2));
+teachers: relevance += 100000 * tf[1](0.100000) * idf[1](0.405465) (4054);
+idf[2] = log(((1 + total(2))/termoccur(0));
+teachers: relevance += 100000 * tf[2](0.000000) * idf[2](0.000000) (0);
+score = relevance(4054);
+ </relevance_info>
+ <recid>content: title technology programs that work author medium book</recid>
+</hit>
+</show>
\ No newline at end of file
@@ -0,0 +1,3 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<init><status>OK</status><session>12</session><protocol>1</protocol><keepAlive>50000</keepAlive>
+</init>
\ No newline at end of file
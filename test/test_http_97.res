@@ -0,0 +1,76 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<show><status>OK</status>
+<activeclients>0</activeclients>
+<merged>2</merged>
+<total>2</total>
+<start>0</start>
+<num>2</num>
+<hit>
+ <md-title>The religious teachers of Greece</md-title>
+ <md-date>1972</md-date>
+ <md-author>Adam, James</md-author>
+ <md-subject>Greek literature</md-subject>
+ <md-subject>Philosophy, Ancient</md-subject>
+ <md-subject>Greece</md-subject>
+ <md-description>Reprint of the 1909 ed., which was issued as the 1904-1906 Gifford lectures</md-description>
+ <location id="z3950.indexdata.com/marc"
+    name="Index Data MARC test server" checksum="2614320583">
+  <md-title>The religious teachers of Greece</md-title>
+  <md-date>1972</md-date>
+  <md-author>Adam, James</md-author>
+  <md-subject>Greek literature</md-subject>
+  <md-subject>Philosophy, Ancient</md-subject>
+  <md-subject>Greece</md-subject>
+  <md-description tag="500">Reprint of the 1909 ed., which was issued as the 1904-1906 Gifford lectures</md-description>
+  <md-description tag="504">Includes bibliographical references</md-description>
+  <md-test-usersetting>XXXXXXXXXX</md-test-usersetting>
+  <md-test-usersetting-2>test-usersetting-2 data: 
+        YYYYYYYYY</md-test-usersetting-2>
+ </location>
+ <count>1</count>
+ <relevance>60819</relevance>
+ <relevance_info>
+field=author content=Adam, James,;
+adam: w[1] += w(3) / (1+log2(1+lead_decay(0.000000) * length(0)));
+adam: tf[1] += w[1](3) / length(2) (1.500000);
+relevance = 0;
+idf[1] = log(((1 + total(2))/termoccur(2));
+adam: relevance += 100000 * tf[1](1.500000) * idf[1](0.405465) (60819);
+score = relevance(60819);
+ </relevance_info>
+ <recid>content: title the religious teachers of greece author adam james medium book</recid>
+</hit>
+<hit>
+ <md-title>Four psalms</md-title>
+ <md-title-remainder>XXIII, XXXVI, LII, CXXI</md-title-remainder>
+ <md-date>1980</md-date>
+ <md-author>Smith, George Adam</md-author>
+ <md-subject>Bible</md-subject>
+ <location id="z3950.indexdata.com/marc"
+    name="Index Data MARC test server" checksum="2788512872">
+  <md-title>Four psalms</md-title>
+  <md-title-remainder>XXIII, XXXVI, LII, CXXI</md-title-remainder>
+  <md-date>1980</md-date>
+  <md-author>Smith, George Adam</md-author>
+  <md-subject>Bible</md-subject>
+  <md-subject>Bible</md-subject>
+  <md-subject>Bible</md-subject>
+  <md-subject>Bible</md-subject>
+  <md-test-usersetting>XXXXXXXXXX</md-test-usersetting>
+  <md-test-usersetting-2>test-usersetting-2 data: 
+        YYYYYYYYY</md-test-usersetting-2>
+ </location>
+ <count>1</count>
+ <relevance>40546</relevance>
+ <relevance_info>
+field=author content=Smith, George Adam,;
+adam: w[1] += w(3) / (1+log2(1+lead_decay(0.000000) * length(2)));
+adam: tf[1] += w[1](3) / length(3) (1.000000);
+relevance = 0;
+idf[1] = log(((1 + total(2))/termoccur(2));
+adam: relevance += 100000 * tf[1](1.000000) * idf[1](0.405465) (40546);
+score = relevance(40546);
+ </relevance_info>
+ <recid>content: title four psalms author smith george adam medium book</recid>
+</hit>
+</show>
\ No newline at end of file